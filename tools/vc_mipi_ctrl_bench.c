@@ -0,0 +1,229 @@
+// Measures the round trip latency of exposure and gain updates, i.e. how fast an AE loop can drive
+// the camera.
+//
+// Usage: vc_mipi_ctrl_bench [-n updates] [-r rate_hz] [-x] [-E min:max] [-G min:max] [-v] device
+//
+// device is either a subdevice node (/dev/v4l-subdevN) or the ctrl file of the module emulator
+// (/sys/kernel/debug/vc_mipi_emu/ctrl). Each update sets exposure and gain to the next values of
+// a triangle sequence across the given ranges (default: the ranges of the controls), so that every
+// update really reaches the driver. Without -x the controls are set by two VIDIOC_S_CTRL calls,
+// with -x by one VIDIOC_S_EXT_CTRLS call. With -r the updates are paced at the given rate,
+// otherwise they are issued back to back.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#define SEQ_STEPS       16
+
+struct range {
+        int32_t min;
+        int32_t max;
+};
+
+static unsigned long num_updates = 1000;
+static double rate_hz;
+static int ext_ctrls;
+static int verbose;
+static int emulator;
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns)
+{
+        struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+static int parse_range(const char *arg, struct range *range)
+{
+        return sscanf(arg, "%d:%d", &range->min, &range->max) == 2 && range->min <= range->max ? 0 : -1;
+}
+
+static int query_range(int fd, uint32_t id, struct range *range)
+{
+        struct v4l2_queryctrl query = { .id = id };
+
+        if (ioctl(fd, VIDIOC_QUERYCTRL, &query)) {
+                perror("VIDIOC_QUERYCTRL");
+                return -1;
+        }
+        range->min = query.minimum;
+        range->max = query.maximum;
+        return 0;
+}
+
+// Triangle sequence from min to max and back in SEQ_STEPS steps
+static int32_t seq_value(struct range *range, unsigned long index)
+{
+        unsigned long step = index % (2 * SEQ_STEPS);
+
+        if (step > SEQ_STEPS)
+                step = 2 * SEQ_STEPS - step;
+        return range->min + (int32_t)(((int64_t)range->max - range->min) * step / SEQ_STEPS);
+}
+
+static int set_ctrl(int fd, uint32_t id, int32_t value)
+{
+        struct v4l2_control control = { .id = id, .value = value };
+        char buf[64];
+        int len;
+
+        if (emulator) {
+                len = snprintf(buf, sizeof(buf), "0x%08x %d\n", id, value);
+                return write(fd, buf, len) == len ? 0 : -1;
+        }
+        return ioctl(fd, VIDIOC_S_CTRL, &control);
+}
+
+static int set_ext_ctrls(int fd, int32_t exposure, int32_t gain)
+{
+        struct v4l2_ext_control controls[2] = {
+                { .id = V4L2_CID_EXPOSURE, .value = exposure },
+                { .id = V4L2_CID_GAIN, .value = gain },
+        };
+        struct v4l2_ext_controls ext = {
+                .which = V4L2_CTRL_WHICH_CUR_VAL,
+                .count = 2,
+                .controls = controls,
+        };
+
+        return ioctl(fd, VIDIOC_S_EXT_CTRLS, &ext);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+        uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+        return x < y ? -1 : x > y;
+}
+
+static double percentile_us(uint64_t *sorted, unsigned long count, unsigned int percent)
+{
+        unsigned long index = (count * percent + 99) / 100;
+
+        return sorted[index ? index - 1 : 0] / 1000.0;
+}
+
+static void usage(const char *name)
+{
+        fprintf(stderr, "Usage: %s [-n updates] [-r rate_hz] [-x] [-E min:max] [-G min:max] [-v] device\n", name);
+        exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+        struct range exposure = { 0, 0 }, gain = { 0, 0 };
+        int have_exposure = 0, have_gain = 0;
+        uint64_t *latency, start, end, first, next, sum = 0;
+        unsigned long index, errors = 0, late = 0;
+        int32_t exp_value, gain_value;
+        const char *path;
+        int fd, opt, ret;
+
+        while ((opt = getopt(argc, argv, "n:r:xE:G:v")) != -1) {
+                switch (opt) {
+                case 'n': num_updates = strtoul(optarg, NULL, 0); break;
+                case 'r': rate_hz = strtod(optarg, NULL); break;
+                case 'x': ext_ctrls = 1; break;
+                case 'E': if (parse_range(optarg, &exposure)) usage(argv[0]); have_exposure = 1; break;
+                case 'G': if (parse_range(optarg, &gain)) usage(argv[0]); have_gain = 1; break;
+                case 'v': verbose = 1; break;
+                default: usage(argv[0]);
+                }
+        }
+        if (argc - optind != 1 || num_updates == 0 || rate_hz < 0)
+                usage(argv[0]);
+
+        path = argv[optind];
+        emulator = strncmp(path, "/dev/", 5) != 0;
+        if (emulator && ext_ctrls) {
+                fprintf(stderr, "-x requires a subdevice node\n");
+                return 1;
+        }
+
+        fd = open(path, emulator ? O_WRONLY : O_RDWR);
+        if (fd < 0) {
+                perror(path);
+                return 1;
+        }
+
+        if (!have_exposure && (emulator || query_range(fd, V4L2_CID_EXPOSURE, &exposure))) {
+                fprintf(stderr, "Exposure range required (-E min:max)\n");
+                return 1;
+        }
+        if (!have_gain && (emulator || query_range(fd, V4L2_CID_GAIN, &gain))) {
+                fprintf(stderr, "Gain range required (-G min:max)\n");
+                return 1;
+        }
+
+        latency = calloc(num_updates, sizeof(*latency));
+        if (latency == NULL)
+                return 1;
+
+        first = next = now_ns();
+        for (index = 0; index < num_updates; index++) {
+                if (rate_hz > 0) {
+                        if (index && now_ns() > next)
+                                late++;
+                        else
+                                sleep_until(next);
+                        next = first + (uint64_t)((index + 1) * 1e9 / rate_hz);
+                }
+
+                exp_value = seq_value(&exposure, index);
+                gain_value = seq_value(&gain, index + SEQ_STEPS / 2);
+
+                start = now_ns();
+                if (ext_ctrls) {
+                        ret = set_ext_ctrls(fd, exp_value, gain_value);
+                } else {
+                        ret = set_ctrl(fd, V4L2_CID_EXPOSURE, exp_value);
+                        if (ret == 0)
+                                ret = set_ctrl(fd, V4L2_CID_GAIN, gain_value);
+                }
+                end = now_ns();
+
+                latency[index] = end - start;
+                sum += latency[index];
+                if (ret) {
+                        errors++;
+                        if (verbose)
+                                fprintf(stderr, "update %lu (exposure %d, gain %d): %s\n", index, exp_value,
+                                        gain_value, strerror(errno));
+                }
+        }
+        end = now_ns();
+        close(fd);
+
+        qsort(latency, num_updates, sizeof(*latency), cmp_u64);
+
+        printf("%s (%s)\n", path, emulator ? "emulator" : ext_ctrls ? "VIDIOC_S_EXT_CTRLS" : "VIDIOC_S_CTRL");
+        printf("  updates:        %lu (errors: %lu)\n", num_updates, errors);
+        printf("  exposure:       %d - %d\n", exposure.min, exposure.max);
+        printf("  gain:           %d - %d\n", gain.min, gain.max);
+        printf("  latency:        p50 %.1f us, p99 %.1f us, max %.1f us, mean %.1f us\n",
+                percentile_us(latency, num_updates, 50), percentile_us(latency, num_updates, 99),
+                latency[num_updates - 1] / 1000.0, sum / 1000.0 / num_updates);
+        printf("  update rate:    %.1f Hz", num_updates * 1e9 / (end - first));
+        if (rate_hz > 0)
+                printf(" (requested: %.1f Hz, late: %lu)", rate_hz, late);
+        printf("\n");
+
+        free(latency);
+        return errors ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Records the golden register sequence of each emulated module with vc_mipi_emu and compares it
+# with the golden file of tools/golden (vc_mipi_replay -c). With -r the golden files are written
+# instead, which is only done on a known good driver.
+#
+# Usage: vc_mipi_golden.sh [-r] [-e vc_mipi_emu.ko] [mod_id ...]
+#
+# vc-mipi-kria has to be loaded. Without a mod_id all modules with a golden file are checked.
+# Scenario: probe, format 640x480 (active code), exposure 20000 us, gain 24, stream on, stream off.
+# The values differ from the defaults, so that their writes show up in the sequence. The emulator
+# runs without bus delay and power up time (bus_hz=0 ready_ms=0), so that no status polling ends up
+# in the sequence.
+
+TOOLS=$(cd "$(dirname "$0")" && pwd)
+GOLDEN=$TOOLS/golden
+EMU=$TOOLS/../vc_mipi_emu.ko
+DEBUGFS=/sys/kernel/debug/vc_mipi_emu
+RECORD=0
+
+while getopts "re:" opt; do
+        case $opt in
+        r) RECORD=1 ;;
+        e) EMU=$OPTARG ;;
+        *) echo "Usage: $0 [-r] [-e vc_mipi_emu.ko] [mod_id ...]" >&2; exit 2 ;;
+        esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+        set -- $(ls "$GOLDEN" | sed -n 's/^golden_\(.*\)\.log$/\1/p')
+fi
+
+if [ ! -x "$TOOLS/vc_mipi_replay" ]; then
+        make -C "$TOOLS" vc_mipi_replay >/dev/null || exit 2
+fi
+
+failed=0
+for id in "$@"; do
+        log=$(mktemp)
+
+        if ! insmod "$EMU" mod_id=0x$id log_probe=1 bus_hz=0 ready_ms=0; then
+                echo "$id: loading the emulator failed" >&2
+                exit 2
+        fi
+        echo "0 640 480" > $DEBUGFS/fmt
+        echo "0x00980911 20000" > $DEBUGFS/ctrl
+        echo "0x00980913 24" > $DEBUGFS/ctrl
+        echo 1 > $DEBUGFS/stream
+        echo 0 > $DEBUGFS/stream
+        echo 0 > $DEBUGFS/log
+        cat $DEBUGFS/log > "$log"
+        rmmod vc_mipi_emu
+
+        if [ $RECORD -eq 1 ]; then
+                mv "$log" "$GOLDEN/golden_$id.log"
+                echo "$id: recorded"
+                continue
+        fi
+
+        printf "%s: " "$id"
+        "$TOOLS/vc_mipi_replay" -c "$GOLDEN/golden_$id.log" "$log" || failed=1
+        rm -f "$log"
+done
+
+exit $failed
@@ -0,0 +1,400 @@
+// Compiles a module table for the vc_mipi driver from a text description, or prints a compiled
+// table as text.
+//
+// Usage: vc_mipi_mktable input.txt table.bin
+//        vc_mipi_mktable -d table.bin
+//
+// The driver loads the table with request_firmware() from /lib/firmware/vc_mipi/mod_<mod_id>_<rev>.bin
+// (one module revision) or /lib/firmware/vc_mipi/mod_<mod_id>.bin (all revisions). The table
+// overrides the built-in settings of the module; everything which isn't given is inherited. Modes
+// replace all built-in modes, so a table which changes a mode has to list all of them.
+//
+// One setting per line, '#' starts a comment:
+//
+//   mod_id 0x0565                  module id (required)
+//   mod_rev 1                      module revision (0: all revisions)
+//   flags TRIGGER_SYNC|IO_ENABLED  FLAG_* names without prefix or a number, added to the built-in flags
+//   exposure 1 1000000 10000       min max def [us]
+//   gain 0 480 0                   min max def
+//   gain_model db 100              db <step in 0.001 dB> | linear <m0> <c0> <m1> <c1>
+//   frame 0 0 4128 3000            left top width height
+//   clk_ext_trigger 74250000       [Hz]
+//   clk_pixel 74250000             [Hz]
+//   flash 109890 4                 factor toffset
+//   sensor_mode 0x01 0x00          standby operating value of the mode register
+//   reg vmax 0x30d4 0x30d5 0x30d6  <name> l [m [h [u]]], "none" removes a register of the descriptor
+//   mode 0 2 RAW10 1328 16 0xffffff 0xc2a 1023 60 2990142
+//                                  index lanes format hmax vmax_min vmax_max vmax_def
+//                                  blacklevel_max blacklevel_def retrigger_min
+
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Binary layout, see struct vc_fw_table in vc_mipi_modules.h
+#define VC_FW_MAGIC     0x544d4356
+#define VC_FW_VERSION   1
+#define VC_FW_CSR_NONE  0xffff
+#define NUM_REGS        14
+#define NUM_MODES       8
+
+struct fw_control {
+        uint32_t min;
+        uint32_t max;
+        uint32_t def;
+} __attribute__((packed));
+
+struct fw_csr {
+        uint16_t addr[4];
+} __attribute__((packed));
+
+struct fw_mode {
+        uint8_t num_lanes;
+        uint8_t format;
+        uint16_t reserved;
+        uint32_t hmax;
+        struct fw_control vmax;
+        struct fw_control blacklevel;
+        uint32_t retrigger_min;
+} __attribute__((packed));
+
+struct fw_table {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t size;
+        uint16_t mod_id;
+        uint16_t mod_rev;
+        uint32_t flags;
+        struct fw_control exposure;
+        struct fw_control gain;
+        uint8_t gain_model_type;
+        uint8_t mode_standby;
+        uint8_t mode_operating;
+        uint8_t reserved[5];
+        uint32_t gain_model[4];
+        uint32_t frame[4];
+        uint32_t clk_ext_trigger;
+        uint32_t clk_pixel;
+        uint32_t flash_factor;
+        uint32_t flash_toffset;
+        struct fw_csr csr[NUM_REGS];
+        struct fw_mode mode[NUM_MODES];
+} __attribute__((packed));
+
+// Order of enum vc_fw_reg
+static const char *reg_names[NUM_REGS] = {
+        "mode", "vmax", "hmax", "shs", "gain", "blacklevel", "h_start", "v_start", "h_end", "v_end",
+        "o_width", "o_height", "flash_duration", "flash_offset",
+};
+
+// Bit numbers of the FLAG_* defines in vc_mipi_core.h
+static const char *flag_names[] = {
+        "RESET_ALWAYS", "EXPOSURE_SONY", "EXPOSURE_NORMAL", "EXPOSURE_OMNIVISION", "IO_ENABLED",
+        "FORMAT_GBRG", "DOUBLE_HEIGHT", "INCREASE_FRAME_RATE", "TRIGGER_DISABLE", "TRIGGER_EXTERNAL",
+        "TRIGGER_PULSEWIDTH", "TRIGGER_SELF", "TRIGGER_SELF_V2", "TRIGGER_SINGLE", "TRIGGER_SYNC",
+        "TRIGGER_STREAM_EDGE", "TRIGGER_STREAM_LEVEL", "TRIGGER_SLAVE", "PREGIUS_S",
+};
+
+#define NUM_FLAGS       (sizeof(flag_names) / sizeof(flag_names[0]))
+
+static const char *format_names[] = { "RAW08", "RAW10", "RAW12", "RAW14" };
+
+#define FORMAT_RAW08    0x2a
+
+static const char *input;
+static int line_no;
+
+static void fail(const char *msg, const char *arg)
+{
+        fprintf(stderr, "%s:%d: %s%s%s\n", input, line_no, msg, arg ? ": " : "", arg ? arg : "");
+        exit(1);
+}
+
+static uint32_t parse_num(const char *arg)
+{
+        char *end;
+        long long value;
+
+        if (arg == NULL)
+                fail("missing value", NULL);
+        errno = 0;
+        value = strtoll(arg, &end, 0);
+        if (errno || *end != '\0' || value < INT32_MIN || value > UINT32_MAX)
+                fail("invalid number", arg);
+        return (uint32_t)value;
+}
+
+static uint32_t parse_flags(char *arg)
+{
+        uint32_t flags = 0;
+        char *name;
+        unsigned int bit;
+
+        if (arg == NULL)
+                fail("missing value", NULL);
+        for (name = strtok(arg, "|"); name; name = strtok(NULL, "|")) {
+                if (strncmp(name, "FLAG_", 5) == 0)
+                        name += 5;
+                for (bit = 0; bit < NUM_FLAGS && strcmp(name, flag_names[bit]); bit++);
+                flags |= bit < NUM_FLAGS ? 1u << bit : parse_num(name);
+        }
+        return flags;
+}
+
+static uint8_t parse_format(const char *arg)
+{
+        unsigned int index;
+
+        for (index = 0; arg && index < 4; index++)
+                if (strcmp(arg, format_names[index]) == 0)
+                        return FORMAT_RAW08 + index;
+        return parse_num(arg);
+}
+
+static uint16_t parse_addr(const char *arg)
+{
+        uint32_t value;
+
+        if (arg && strcmp(arg, "none") == 0)
+                return VC_FW_CSR_NONE;
+        value = parse_num(arg);
+        if (value >= VC_FW_CSR_NONE)
+                fail("invalid register address", arg);
+        return value;
+}
+
+static void parse_control(struct fw_control *control, char **args)
+{
+        control->min = htole32(parse_num(args[0]));
+        control->max = htole32(parse_num(args[1]));
+        control->def = htole32(parse_num(args[2]));
+}
+
+#define MAX_ARGS        12
+
+static int compile(const char *path, struct fw_table *table)
+{
+        char line[256], *args[MAX_ARGS], *key, *save;
+        int num_args, index, have_mod_id = 0;
+        FILE *file;
+
+        input = path;
+        file = fopen(path, "r");
+        if (file == NULL) {
+                perror(path);
+                return -1;
+        }
+
+        memset(table, 0, sizeof(*table));
+        table->magic = htole32(VC_FW_MAGIC);
+        table->version = htole16(VC_FW_VERSION);
+        table->size = htole16(sizeof(*table));
+
+        while (fgets(line, sizeof(line), file)) {
+                line_no++;
+                if (strchr(line, '#'))
+                        *strchr(line, '#') = '\0';
+                key = strtok_r(line, " \t\r\n", &save);
+                if (key == NULL)
+                        continue;
+                memset(args, 0, sizeof(args));
+                for (num_args = 0; num_args < MAX_ARGS && (args[num_args] = strtok_r(NULL, " \t\r\n", &save));
+                        num_args++);
+
+                if (strcmp(key, "mod_id") == 0) {
+                        table->mod_id = htole16(parse_num(args[0]));
+                        have_mod_id = 1;
+                } else if (strcmp(key, "mod_rev") == 0) {
+                        table->mod_rev = htole16(parse_num(args[0]));
+                } else if (strcmp(key, "flags") == 0) {
+                        table->flags = htole32(parse_flags(args[0]));
+                } else if (strcmp(key, "exposure") == 0) {
+                        parse_control(&table->exposure, args);
+                } else if (strcmp(key, "gain") == 0) {
+                        parse_control(&table->gain, args);
+                } else if (strcmp(key, "gain_model") == 0) {
+                        if (args[0] && strcmp(args[0], "db") == 0) {
+                                table->gain_model_type = 1;
+                                table->gain_model[0] = htole32(parse_num(args[1]));
+                        } else if (args[0] && strcmp(args[0], "linear") == 0) {
+                                for (index = 0; index < 4; index++)
+                                        table->gain_model[index] = htole32(parse_num(args[index + 1]));
+                        } else {
+                                fail("gain_model must be db or linear", args[0]);
+                        }
+                } else if (strcmp(key, "frame") == 0) {
+                        for (index = 0; index < 4; index++)
+                                table->frame[index] = htole32(parse_num(args[index]));
+                } else if (strcmp(key, "clk_ext_trigger") == 0) {
+                        table->clk_ext_trigger = htole32(parse_num(args[0]));
+                } else if (strcmp(key, "clk_pixel") == 0) {
+                        table->clk_pixel = htole32(parse_num(args[0]));
+                } else if (strcmp(key, "flash") == 0) {
+                        table->flash_factor = htole32(parse_num(args[0]));
+                        table->flash_toffset = htole32(parse_num(args[1]));
+                } else if (strcmp(key, "sensor_mode") == 0) {
+                        table->mode_standby = parse_num(args[0]);
+                        table->mode_operating = parse_num(args[1]);
+                } else if (strcmp(key, "reg") == 0) {
+                        for (index = 0; index < NUM_REGS && args[0] && strcmp(args[0], reg_names[index]); index++);
+                        if (index == NUM_REGS)
+                                fail("unknown register", args[0]);
+                        table->csr[index].addr[0] = htole16(parse_addr(args[1]));
+                        for (num_args = 2; num_args < 5 && args[num_args]; num_args++)
+                                table->csr[index].addr[num_args - 1] = htole16(parse_addr(args[num_args]));
+                } else if (strcmp(key, "mode") == 0) {
+                        struct fw_mode *mode;
+
+                        index = parse_num(args[0]);
+                        if (index < 0 || index >= NUM_MODES)
+                                fail("invalid mode index", args[0]);
+                        mode = &table->mode[index];
+                        mode->num_lanes = parse_num(args[1]);
+                        mode->format = parse_format(args[2]);
+                        mode->hmax = htole32(parse_num(args[3]));
+                        parse_control(&mode->vmax, &args[4]);
+                        mode->blacklevel.max = htole32(parse_num(args[7]));
+                        mode->blacklevel.def = htole32(parse_num(args[8]));
+                        mode->retrigger_min = htole32(parse_num(args[9]));
+                        if (mode->num_lanes == 0 || mode->hmax == 0)
+                                fail("mode needs lanes and hmax", NULL);
+                        if (le32toh(mode->vmax.min) > le32toh(mode->vmax.max) ||
+                            le32toh(mode->vmax.def) < le32toh(mode->vmax.min) ||
+                            le32toh(mode->vmax.def) > le32toh(mode->vmax.max))
+                                fail("vmax needs min <= def <= max", NULL);
+                } else {
+                        fail("unknown setting", key);
+                }
+        }
+        fclose(file);
+
+        if (!have_mod_id)
+                fail("mod_id is missing", NULL);
+        return 0;
+}
+
+static void print_control(const char *name, struct fw_control *control)
+{
+        if (control->max)
+                printf("%s %u %u %u\n", name, le32toh(control->min), le32toh(control->max),
+                        le32toh(control->def));
+}
+
+static void print_addr(uint16_t addr)
+{
+        if (le16toh(addr) == VC_FW_CSR_NONE)
+                printf(" none");
+        else
+                printf(" 0x%04x", le16toh(addr));
+}
+
+static int dump(const char *path)
+{
+        struct fw_table table;
+        struct fw_mode *mode;
+        uint32_t flags;
+        unsigned int bit, index, count;
+        FILE *file;
+        int first = 1;
+
+        file = fopen(path, "rb");
+        if (file == NULL) {
+                perror(path);
+                return -1;
+        }
+        count = fread(&table, 1, sizeof(table), file);
+        fclose(file);
+        if (count != sizeof(table) || le32toh(table.magic) != VC_FW_MAGIC ||
+            le16toh(table.version) != VC_FW_VERSION || le16toh(table.size) != sizeof(table)) {
+                fprintf(stderr, "%s: no module table of version %d\n", path, VC_FW_VERSION);
+                return -1;
+        }
+
+        printf("mod_id 0x%04x\n", le16toh(table.mod_id));
+        printf("mod_rev %u\n", le16toh(table.mod_rev));
+        flags = le32toh(table.flags);
+        if (flags) {
+                printf("flags ");
+                for (bit = 0; bit < 32; bit++) {
+                        if (flags & (1u << bit)) {
+                                if (bit < NUM_FLAGS)
+                                        printf("%s%s", first ? "" : "|", flag_names[bit]);
+                                else
+                                        printf("%s0x%x", first ? "" : "|", 1u << bit);
+                                first = 0;
+                        }
+                }
+                printf("\n");
+        }
+        print_control("exposure", &table.exposure);
+        print_control("gain", &table.gain);
+        if (table.gain_model_type == 1)
+                printf("gain_model db %d\n", (int32_t)le32toh(table.gain_model[0]));
+        else if (table.gain_model[0] || table.gain_model[1] || table.gain_model[2] || table.gain_model[3])
+                printf("gain_model linear %d %d %d %d\n", (int32_t)le32toh(table.gain_model[0]),
+                        (int32_t)le32toh(table.gain_model[1]), (int32_t)le32toh(table.gain_model[2]),
+                        (int32_t)le32toh(table.gain_model[3]));
+        if (table.frame[2])
+                printf("frame %u %u %u %u\n", le32toh(table.frame[0]), le32toh(table.frame[1]),
+                        le32toh(table.frame[2]), le32toh(table.frame[3]));
+        if (table.clk_ext_trigger)
+                printf("clk_ext_trigger %u\n", le32toh(table.clk_ext_trigger));
+        if (table.clk_pixel)
+                printf("clk_pixel %u\n", le32toh(table.clk_pixel));
+        if (table.flash_factor)
+                printf("flash %u %d\n", le32toh(table.flash_factor), (int32_t)le32toh(table.flash_toffset));
+        if (table.mode_standby != table.mode_operating)
+                printf("sensor_mode 0x%02x 0x%02x\n", table.mode_standby, table.mode_operating);
+        for (index = 0; index < NUM_REGS; index++) {
+                uint16_t addr[4];
+
+                memcpy(addr, table.csr[index].addr, sizeof(addr));
+                if (!addr[0] && !addr[1] && !addr[2] && !addr[3])
+                        continue;
+                printf("reg %s", reg_names[index]);
+                for (count = 4; count > 1 && !addr[count - 1]; count--);
+                for (bit = 0; bit < count; bit++)
+                        print_addr(addr[bit]);
+                printf("\n");
+        }
+        for (index = 0; index < NUM_MODES; index++) {
+                mode = &table.mode[index];
+                if (mode->num_lanes == 0)
+                        continue;
+                if (mode->format >= FORMAT_RAW08 && mode->format < FORMAT_RAW08 + 4)
+                        printf("mode %u %u %s", index, mode->num_lanes, format_names[mode->format - FORMAT_RAW08]);
+                else
+                        printf("mode %u %u 0x%02x", index, mode->num_lanes, mode->format);
+                printf(" %u %u 0x%x %u %u %u %u\n", le32toh(mode->hmax), le32toh(mode->vmax.min),
+                        le32toh(mode->vmax.max), le32toh(mode->vmax.def), le32toh(mode->blacklevel.max),
+                        le32toh(mode->blacklevel.def), le32toh(mode->retrigger_min));
+        }
+        return 0;
+}
+
+int main(int argc, char *argv[])
+{
+        struct fw_table table;
+        FILE *file;
+
+        if (argc == 3 && strcmp(argv[1], "-d") == 0)
+                return dump(argv[2]) ? 1 : 0;
+        if (argc != 3 || argv[1][0] == '-') {
+                fprintf(stderr, "Usage: %s input.txt table.bin\n       %s -d table.bin\n", argv[0], argv[0]);
+                return 1;
+        }
+
+        if (compile(argv[1], &table))
+                return 1;
+
+        file = fopen(argv[2], "wb");
+        if (file == NULL || fwrite(&table, sizeof(table), 1, file) != 1) {
+                perror(argv[2]);
+                return 1;
+        }
+        fclose(file);
+        return 0;
+}
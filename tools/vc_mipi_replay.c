@@ -0,0 +1,321 @@
+// Replays a register capture of the vc_mipi driver (/sys/kernel/debug/vc_mipi/<device>/capture)
+// against a simulated register file and estimates the I2C bus time of the session.
+//
+// Usage: vc_mipi_replay [-s bus_hz] [-o overhead_us] [-v] capture [capture_new]
+//        vc_mipi_replay -c golden capture
+//
+// With two captures the second one is compared against the first one, e.g. the same AE loop
+// recorded before and after a driver change.
+//
+// With -c the register write sequence of the capture has to match the golden capture (same
+// operation, client, address and value in the same order) and the number of transactions must
+// not grow. The exit code is 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define NUM_CLIENTS     128
+#define NUM_REGS        65536
+#define MAX_OPS         16
+
+// Bit times on the bus: start, address byte + 2 register address bytes (+ data) incl. ACK, stop
+#define BITS_WRITE      (1 + 4 * 9 + 1)
+#define BITS_READ       (1 + 3 * 9 + 1 + 2 * 9 + 1)
+
+struct reg_file {
+        uint8_t value[NUM_REGS];
+        uint8_t valid[NUM_REGS];
+};
+
+struct op_summary {
+        char name[32];
+        unsigned long reads;
+        unsigned long writes;
+};
+
+struct summary {
+        unsigned long reads;
+        unsigned long writes;
+        unsigned long errors;
+        unsigned long mismatches;       // Reads that differ from the simulated register state
+        unsigned long redundant;        // Writes of the value the register already has
+        uint64_t recorded_ns;           // Sum of the recorded transaction durations
+        uint64_t session_ns;            // First to last timestamp
+        struct op_summary ops[MAX_OPS];
+        int num_ops;
+};
+
+struct write_entry {
+        char op[32];
+        unsigned int client;
+        unsigned int addr;
+        unsigned int value;
+        unsigned long line;
+};
+
+struct write_seq {
+        struct write_entry *entries;
+        unsigned long count;
+        unsigned long transactions;
+};
+
+static unsigned long bus_hz = 400000;
+static double overhead_us = 0;
+static int verbose;
+
+static struct op_summary *get_op(struct summary *sum, const char *name)
+{
+        int index;
+
+        for (index = 0; index < sum->num_ops; index++)
+                if (strcmp(sum->ops[index].name, name) == 0)
+                        return &sum->ops[index];
+        if (sum->num_ops == MAX_OPS)
+                return &sum->ops[MAX_OPS - 1];
+
+        snprintf(sum->ops[sum->num_ops].name, sizeof(sum->ops[0].name), "%s", name);
+        return &sum->ops[sum->num_ops++];
+}
+
+static double bus_time_us(unsigned long reads, unsigned long writes)
+{
+        double bits = (double)reads * BITS_READ + (double)writes * BITS_WRITE;
+
+        return bits * 1000000 / bus_hz + (reads + writes) * overhead_us;
+}
+
+static int replay(const char *path, struct summary *sum)
+{
+        static struct reg_file *regs[NUM_CLIENTS];
+        unsigned long long timestamp, first = 0, last = 0;
+        unsigned int duration, client, addr, value;
+        char line[256], op[32], rw;
+        struct op_summary *ops;
+        struct reg_file *reg;
+        FILE *file;
+        int ret, index;
+
+        file = fopen(path, "r");
+        if (file == NULL) {
+                perror(path);
+                return -1;
+        }
+
+        memset(sum, 0, sizeof(*sum));
+        for (index = 0; index < NUM_CLIENTS; index++)
+                if (regs[index])
+                        memset(regs[index], 0, sizeof(*regs[index]));
+
+        while (fgets(line, sizeof(line), file)) {
+                if (line[0] == '#' || line[0] == '\n')
+                        continue;
+                if (sscanf(line, "%llu %u %31s %c %x %x %x %d", &timestamp, &duration, op, &rw,
+                        &client, &addr, &value, &ret) != 8 || client >= NUM_CLIENTS || addr >= NUM_REGS) {
+                        fprintf(stderr, "%s: invalid line: %s", path, line);
+                        continue;
+                }
+
+                if (first == 0)
+                        first = timestamp;
+                last = timestamp + duration;
+                sum->recorded_ns += duration;
+
+                ops = get_op(sum, op);
+                if (ret) {
+                        sum->errors++;
+                        continue;
+                }
+
+                if (regs[client] == NULL) {
+                        regs[client] = calloc(1, sizeof(*regs[client]));
+                        if (regs[client] == NULL) {
+                                fclose(file);
+                                return -1;
+                        }
+                }
+                reg = regs[client];
+
+                if (rw == 'R') {
+                        sum->reads++;
+                        ops->reads++;
+                        // Status registers change on their own. Only report, don't fail.
+                        if (reg->valid[addr] && reg->value[addr] != value) {
+                                sum->mismatches++;
+                                if (verbose)
+                                        printf("mismatch: %s 0x%02x 0x%04x: simulated 0x%02x, recorded 0x%02x\n",
+                                                op, client, addr, reg->value[addr], value);
+                        }
+                } else {
+                        sum->writes++;
+                        ops->writes++;
+                        if (reg->valid[addr] && reg->value[addr] == value) {
+                                sum->redundant++;
+                                if (verbose)
+                                        printf("redundant: %s 0x%02x 0x%04x <= 0x%02x\n", op, client, addr, value);
+                        }
+                }
+                reg->value[addr] = value;
+                reg->valid[addr] = 1;
+        }
+        sum->session_ns = last - first;
+
+        fclose(file);
+        return 0;
+}
+
+static void print_summary(const char *path, struct summary *sum)
+{
+        int index;
+
+        printf("%s\n", path);
+        printf("  transactions:   %lu (reads: %lu, writes: %lu, errors: %lu)\n",
+                sum->reads + sum->writes + sum->errors, sum->reads, sum->writes, sum->errors);
+        printf("  redundant:      %lu writes\n", sum->redundant);
+        printf("  mismatches:     %lu reads\n", sum->mismatches);
+        printf("  bus time:       %.0f us (estimated at %lu Hz)\n", bus_time_us(sum->reads, sum->writes), bus_hz);
+        printf("  recorded time:  %.0f us (session: %.0f us)\n", sum->recorded_ns / 1000.0, sum->session_ns / 1000.0);
+        printf("  %-16s %10s %10s %12s\n", "op", "reads", "writes", "bus_us");
+        for (index = 0; index < sum->num_ops; index++)
+                printf("  %-16s %10lu %10lu %12.0f\n", sum->ops[index].name, sum->ops[index].reads,
+                        sum->ops[index].writes, bus_time_us(sum->ops[index].reads, sum->ops[index].writes));
+}
+
+static int load_writes(const char *path, struct write_seq *seq)
+{
+        unsigned long long timestamp;
+        unsigned int duration;
+        struct write_entry entry, *entries;
+        unsigned long line_nr = 0;
+        char line[256], rw;
+        FILE *file;
+        int ret;
+
+        file = fopen(path, "r");
+        if (file == NULL) {
+                perror(path);
+                return -1;
+        }
+
+        memset(seq, 0, sizeof(*seq));
+        while (fgets(line, sizeof(line), file)) {
+                line_nr++;
+                if (line[0] == '#' || line[0] == '\n')
+                        continue;
+                if (sscanf(line, "%llu %u %31s %c %x %x %x %d", &timestamp, &duration, entry.op, &rw,
+                        &entry.client, &entry.addr, &entry.value, &ret) != 8) {
+                        fprintf(stderr, "%s: invalid line: %s", path, line);
+                        continue;
+                }
+                seq->transactions++;
+                if (rw != 'W')
+                        continue;
+
+                if ((seq->count & 1023) == 0) {
+                        entries = realloc(seq->entries, (seq->count + 1024) * sizeof(*entries));
+                        if (entries == NULL) {
+                                fclose(file);
+                                return -1;
+                        }
+                        seq->entries = entries;
+                }
+                entry.line = line_nr;
+                seq->entries[seq->count++] = entry;
+        }
+
+        fclose(file);
+        return 0;
+}
+
+static int check_golden(const char *golden_path, const char *path)
+{
+        struct write_seq golden, seq;
+        struct write_entry *g, *e;
+        unsigned long index;
+        int failed = 0;
+
+        if (load_writes(golden_path, &golden) || load_writes(path, &seq))
+                return 2;
+
+        for (index = 0; index < golden.count && index < seq.count; index++) {
+                g = &golden.entries[index];
+                e = &seq.entries[index];
+                if (strcmp(g->op, e->op) || g->client != e->client || g->addr != e->addr || g->value != e->value) {
+                        printf("FAIL: write #%lu differs\n", index);
+                        printf("  golden  (line %lu): %s 0x%02x 0x%04x <= 0x%02x\n", g->line, g->op, g->client, g->addr, g->value);
+                        printf("  capture (line %lu): %s 0x%02x 0x%04x <= 0x%02x\n", e->line, e->op, e->client, e->addr, e->value);
+                        failed = 1;
+                        break;
+                }
+        }
+        if (!failed && golden.count != seq.count) {
+                printf("FAIL: %lu writes, golden: %lu\n", seq.count, golden.count);
+                failed = 1;
+        }
+        if (seq.transactions > golden.transactions) {
+                printf("FAIL: %lu transactions, golden: %lu (+%lu)\n", seq.transactions, golden.transactions,
+                        seq.transactions - golden.transactions);
+                failed = 1;
+        }
+        if (!failed)
+                printf("OK: %lu writes, %lu transactions (golden: %lu)\n", seq.count, seq.transactions,
+                        golden.transactions);
+
+        free(golden.entries);
+        free(seq.entries);
+        return failed;
+}
+
+static void usage(const char *name)
+{
+        fprintf(stderr, "Usage: %s [-s bus_hz] [-o overhead_us] [-v] capture [capture_new]\n", name);
+        fprintf(stderr, "       %s -c golden capture\n", name);
+        exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+        static struct summary base, next;
+        const char *golden = NULL;
+        double base_us, next_us;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "c:s:o:v")) != -1) {
+                switch (opt) {
+                case 'c': golden = optarg; break;
+                case 's': bus_hz = strtoul(optarg, NULL, 0); break;
+                case 'o': overhead_us = strtod(optarg, NULL); break;
+                case 'v': verbose = 1; break;
+                default: usage(argv[0]);
+                }
+        }
+        if (optind >= argc || argc - optind > 2 || bus_hz == 0)
+                usage(argv[0]);
+
+        if (golden) {
+                if (argc - optind != 1)
+                        usage(argv[0]);
+                return check_golden(golden, argv[optind]);
+        }
+
+        if (replay(argv[optind], &base))
+                return 1;
+        print_summary(argv[optind], &base);
+
+        if (argc - optind == 2) {
+                if (replay(argv[optind + 1], &next))
+                        return 1;
+                print_summary(argv[optind + 1], &next);
+
+                base_us = bus_time_us(base.reads, base.writes);
+                next_us = bus_time_us(next.reads, next.writes);
+                printf("difference\n");
+                printf("  transactions:   %+ld\n", (long)(next.reads + next.writes) - (long)(base.reads + base.writes));
+                printf("  bus time:       %+.0f us (%+.1f %%)\n", next_us - base_us,
+                        base_us > 0 ? (next_us - base_us) * 100 / base_us : 0);
+        }
+
+        return 0;
+}
@@ -1,4 +1,7 @@
 #include "vc_mipi_core.h"
+#include "vc_mipi_debugfs.h"
+#include "vc_mipi_group.h"
+#include "vc_mipi_trigger.h"
 
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
@@ -9,10 +12,13 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/of_device.h>
+#include <linux/property.h>
 #include <linux/regulator/consumer.h>
 #include <linux/slab.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <media/v4l2-async.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
@@ -20,11 +26,50 @@
 #include <media/v4l2-fwnode.h>
 #include <media/v4l2-subdev.h>
 
+#include "vc_mipi_trace.h"
+
+#define V4L2_CID_VC_TRIGGER_MODE        (V4L2_CID_USER_BASE | 0xfff0)
+#define V4L2_CID_VC_IO_MODE             (V4L2_CID_USER_BASE | 0xfff1)
+#define V4L2_CID_VC_FRAME_RATE          (V4L2_CID_USER_BASE | 0xfff2)
+#define V4L2_CID_VC_SINGLE_TRIGGER      (V4L2_CID_USER_BASE | 0xfff3)
+#define V4L2_CID_VC_EXPOSURE_LINES      (V4L2_CID_USER_BASE | 0xfff4)
+#define V4L2_CID_VC_PREPARE_STREAM      (V4L2_CID_USER_BASE | 0xfff5)
+#define V4L2_CID_VC_TRIGGER_PERIOD      (V4L2_CID_USER_BASE | 0xfff6)
+#define V4L2_CID_VC_TRIGGER_COUNT       (V4L2_CID_USER_BASE | 0xfff7)
+#define V4L2_CID_VC_FLASH_OFFSET        (V4L2_CID_USER_BASE | 0xfff8)
+#define V4L2_CID_VC_FLASH_DURATION      (V4L2_CID_USER_BASE | 0xfff9)
+
+#define VC_MAX_LINK_FREQS               24
+
+static bool exposure_in_lines;
+module_param(exposure_in_lines, bool, 0444);
+MODULE_PARM_DESC(exposure_in_lines, "V4L2_CID_EXPOSURE in lines instead of us (as expected by libcamera)");
+
 struct vc_device {
         struct v4l2_subdev sd;
         struct v4l2_ctrl_handler ctrl_handler;
+        struct v4l2_ctrl *ctrl_exposure;
+        struct v4l2_ctrl *ctrl_gain;
+        struct v4l2_ctrl *ctrl_analogue_gain;
+        struct v4l2_ctrl *ctrl_frame_rate;
+        struct v4l2_ctrl *ctrl_trigger_mode;
+        struct v4l2_ctrl *ctrl_io_mode;
+        struct v4l2_ctrl *ctrl_pixel_rate;
+        struct v4l2_ctrl *ctrl_link_freq;
+        struct v4l2_ctrl *ctrl_hblank;
+        struct v4l2_ctrl *ctrl_vblank;
+        struct v4l2_ctrl *ctrl_exposure_lines;
+        struct v4l2_ctrl *ctrl_trigger_period;  // Cluster with the period as master
+        struct v4l2_ctrl *ctrl_trigger_count;
+        struct v4l2_ctrl *ctrl_flash_offset;
+        struct v4l2_ctrl *ctrl_flash_duration;
+        s64 link_freqs[VC_MAX_LINK_FREQS];
+        int num_link_freqs;
         struct media_pad pad;
         struct v4l2_fwnode_endpoint ep;         // the parsed DT endpoint info
+        struct work_struct prepare_work;        // Stream preparation ahead of STREAMON
+        int stream_busy;                        // Stream start or stop in progress, no new preparation
+        int ctrl_sync;                          // Controls are updated to the sensor settings
 
         struct vc_cam cam;
 };
@@ -41,6 +86,8 @@ static inline struct vc_cam *to_vc_cam(struct v4l2_subdev *sd)
 }
 
 
+static int vc_sd_prepare_stream(struct vc_device *device);
+
 // --- v4l2_subdev_core_ops ---------------------------------------------------
 
 // static int vc_sd_s_power(struct v4l2_subdev *sd, int on)
@@ -55,25 +102,54 @@ static int vc_sd_s_ctrl(struct v4l2_subdev *sd, struct v4l2_control *control)
 
         switch (control->id) {
         case V4L2_CID_EXPOSURE:
+                if (exposure_in_lines)
+                        return vc_core_set_exposure_lines(cam, control->value);
                 return vc_sen_set_exposure(cam, control->value);
 
         case V4L2_CID_GAIN:
+        case V4L2_CID_ANALOGUE_GAIN:
                 return vc_sen_set_gain(cam, control->value);
 
-        // case V4L2_CID_BLACK_LEVEL:
-        //         return vc_sen_set_blacklevel(cam, control->value);
+        case V4L2_CID_BLACK_LEVEL:
+                return vc_sen_set_blacklevel(cam, control->value);
+
+        case V4L2_CID_VC_TRIGGER_MODE:
+                return vc_mod_set_trigger_mode(cam, control->value);
+
+        case V4L2_CID_VC_IO_MODE:
+                return vc_mod_set_io_mode(cam, control->value);
+
+        case V4L2_CID_VC_FRAME_RATE:
+                return vc_core_set_framerate(cam, control->value);
 
-        // case V4L2_CID_TRIGGER_MODE:
-        //         return vc_mod_set_trigger_mode(cam, control->value);
+        case V4L2_CID_VC_SINGLE_TRIGGER:
+                return vc_mod_set_single_trigger(cam);
 
-        // case V4L2_CID_FLASH_MODE:
-        //         return vc_mod_set_io_mode(cam, control->value);
+        case V4L2_CID_VBLANK:
+                return vc_core_set_vblank(cam, control->value);
 
-        // case V4L2_CID_FRAME_RATE:
-        //         return vc_core_set_framerate(cam, control->value);
+        case V4L2_CID_VC_EXPOSURE_LINES:
+                return vc_core_set_exposure_lines(cam, control->value);
 
-        // case V4L2_CID_SINGLE_TRIGGER:
-        //         return vc_mod_set_single_trigger(cam);
+        case V4L2_CID_VC_PREPARE_STREAM:
+                return vc_sd_prepare_stream(to_vc_device(sd));
+
+        case V4L2_CID_VC_TRIGGER_PERIOD:
+                if (control->value == 0) {
+                        vc_trigger_stop(cam);
+                        return 0;
+                }
+                return vc_trigger_start(cam, control->value, to_vc_device(sd)->ctrl_trigger_count->val);
+
+        case V4L2_CID_VC_TRIGGER_COUNT:
+                // Applied by the next start of the trigger generator
+                return 0;
+
+        case V4L2_CID_VC_FLASH_OFFSET:
+                return vc_sen_set_flash(cam, control->value, cam->state.flash_duration);
+
+        case V4L2_CID_VC_FLASH_DURATION:
+                return vc_sen_set_flash(cam, cam->state.flash_offset, control->value);
 
         default:
                 vc_warn(dev, "%s(): Unkown control 0x%08x\n", __FUNCTION__, control->id);
@@ -85,41 +161,108 @@ static int vc_sd_s_ctrl(struct v4l2_subdev *sd, struct v4l2_control *control)
 
 // --- v4l2_subdev_video_ops ---------------------------------------------------
 
+// The module reset and the ready wait of a mode change take 200 ms and more. Userspace prepares the
+// cameras asynchronously (V4L2_CID_VC_PREPARE_STREAM), then the STREAMON of each camera only has to
+// start streaming. Preparing several cameras this way takes as long as the slowest of them.
+static void vc_sd_prepare_work(struct work_struct *work)
+{
+        struct vc_device *device = container_of(work, struct vc_device, prepare_work);
+        struct vc_cam *cam = &device->cam;
+        struct vc_stream_event *event;
+        __u64 duration;
+        int reset = 0;
+        int ret;
+
+        mutex_lock(device->ctrl_handler.lock);
+        event = vc_core_begin_stream_event(cam, VC_STREAM_PREPARE);
+        ret = vc_core_prepare_stream(cam, event, &reset);
+        vc_core_end_stream_event(cam, event, reset, ret);
+        duration = event->total_ns;
+        mutex_unlock(device->ctrl_handler.lock);
+
+        trace_vc_stream(cam->ctrl.client_sen->addr, VC_STREAM_PREPARE, ret, duration);
+}
+
+// Has to be called with the control handler lock held.
+static int vc_sd_prepare_stream(struct vc_device *device)
+{
+        if (device->cam.state.streaming || device->stream_busy)
+                return -EBUSY;
+
+        queue_work(system_unbound_wq, &device->prepare_work);
+
+        return 0;
+}
+
+static void vc_sd_set_stream_busy(struct vc_device *device, int busy)
+{
+        mutex_lock(device->ctrl_handler.lock);
+        device->stream_busy = busy;
+        mutex_unlock(device->ctrl_handler.lock);
+}
+
 static int vc_sd_s_stream(struct v4l2_subdev *sd, int enable)
 {
+        struct vc_device *device = to_vc_device(sd);
         struct vc_cam *cam = to_vc_cam(sd);
         // struct vc_ctrl *ctrl = &cam->ctrl;
         struct vc_state *state = &cam->state;
         struct device *dev = sd->dev;
         //struct vc_frame *frame = vc_core_get_frame(cam);
+        struct vc_stream_event *event;
+        __u64 start, duration;
         int reset = 0;
         int ret = 0;
 
-        vc_notice(dev, "%s(): Set streaming: %s\n", __FUNCTION__, enable ? "on" : "off");
+        vc_dbg(dev, "%s(): Set streaming: %s\n", __FUNCTION__, enable ? "on" : "off");
+
+        // Waits for a preparation in progress. It is used by the start, a stop invalidates it. No
+        // preparation can be queued until the start or stop is done (see vc_sd_prepare_stream()).
+        vc_sd_set_stream_busy(device, 1);
+        flush_work(&device->prepare_work);
+        if (!enable)
+                vc_trigger_stop(cam);
+
+        // The members of a sync group start and stop together (see vc_mipi_group.c). The trigger and
+        // IO mode are locked as soon as streaming is requested.
+        if (cam->group) {
+                start = ktime_get_ns();
+                ret = vc_group_set_stream(cam, enable);
+                v4l2_ctrl_grab(device->ctrl_trigger_mode, enable && !ret);
+                v4l2_ctrl_grab(device->ctrl_io_mode, enable && !ret);
+                trace_vc_stream(cam->ctrl.client_sen->addr, enable, ret, ktime_get_ns() - start);
+                vc_sd_set_stream_busy(device, 0);
+                return ret;
+        }
 
-        if (enable) {
-                if (state->streaming == 1) {
-                        vc_warn(dev, "%s(): Sensor is already streaming!\n", __FUNCTION__);
-                        ret = vc_sen_stop_stream(cam);
-                }
+        // The controls write to the same registers, they must not interleave with the start or stop.
+        mutex_lock(device->ctrl_handler.lock);
+        event = vc_core_begin_stream_event(cam, enable);
 
-                ret  = vc_mod_set_mode(cam, &reset);
-                if (!ret && reset) {
-                        ret |= vc_sen_set_roi(cam);
-                        ret |= vc_sen_set_exposure(cam, cam->state.exposure);
-                        ret |= vc_sen_set_gain(cam, cam->state.gain);
-                        ret |= vc_sen_set_blacklevel(cam, cam->state.blacklevel);
+        if (enable) {
+                // A camera which couldn't be programmed isn't started.
+                ret = vc_core_prepare_stream(cam, event, &reset);
+                if (ret == 0) {
+                        ret = vc_sen_start_stream(cam);
+                        vc_core_mark_stream_phase(event, VC_PHASE_START_STREAM);
                 }
-                ret |= vc_sen_start_stream(cam);
-                if (ret == 0)
-                        state->streaming = 1;
 
         } else {
                 ret = vc_sen_stop_stream(cam);
-                if (ret == 0)
-                        state->streaming = 0;
+                vc_core_mark_stream_phase(event, VC_PHASE_STOP_STREAM);
         }
 
+        // Trigger and IO mode are applied on stream start only. Lock them while streaming.
+        __v4l2_ctrl_grab(device->ctrl_trigger_mode, state->streaming);
+        __v4l2_ctrl_grab(device->ctrl_io_mode, state->streaming);
+
+        vc_core_end_stream_event(cam, event, reset, ret);
+        duration = event->total_ns;
+        device->stream_busy = 0;
+        mutex_unlock(device->ctrl_handler.lock);
+
+        trace_vc_stream(cam->ctrl.client_sen->addr, enable, ret, duration);
+
         return ret;
 }
 
@@ -129,39 +272,295 @@ static int vc_sd_get_fmt(struct v4l2_subdev *sd, struct v4l2_subdev_state *sd_st
 {
         struct vc_cam *cam = to_vc_cam(sd);
         struct v4l2_mbus_framefmt *mf = &fmt->format;
-        struct vc_frame* frame = vc_core_get_frame(cam);
+        struct vc_frame* frame;
+
+        if (fmt->which == V4L2_SUBDEV_FORMAT_TRY) {
+                *mf = *v4l2_subdev_get_try_format(sd, sd_state, fmt->pad);
+                return 0;
+        }
+
+        frame = vc_core_get_frame(cam);
 
         mf->code = vc_core_get_format(cam);
         mf->width = frame->width;
         mf->height = frame->height;
+        mf->field = V4L2_FIELD_NONE;
+        mf->colorspace = V4L2_COLORSPACE_RAW;
         // mf->reserved[1] = 30;
 
         return 0;
 }
 
+static void vc_sd_update_ctrl_ranges(struct vc_device *device);
+
 static int vc_sd_set_fmt(struct v4l2_subdev *sd, struct v4l2_subdev_state *sd_state, struct v4l2_subdev_format *fmt)
 {
+        struct vc_device *device = to_vc_device(sd);
         struct vc_cam *cam = to_vc_cam(sd);
         struct v4l2_mbus_framefmt *mf = &fmt->format;
 
+        if (fmt->which == V4L2_SUBDEV_FORMAT_TRY) {
+                struct vc_frame *bounds = &cam->ctrl.frame;
+                struct v4l2_mbus_framefmt *try_fmt = v4l2_subdev_get_try_format(sd, sd_state, fmt->pad);
+
+                if (vc_core_try_format(cam, mf->code))
+                        mf->code = vc_core_get_format(cam);
+                mf->width = clamp_t(__u32, mf->width, 1, bounds->width);
+                mf->height = clamp_t(__u32, mf->height, 1, bounds->height);
+                mf->field = V4L2_FIELD_NONE;
+                mf->colorspace = V4L2_COLORSPACE_RAW;
+                *try_fmt = *mf;
+                return 0;
+        }
+
+        mutex_lock(device->ctrl_handler.lock);
         vc_core_set_format(cam, mf->code);
         vc_core_set_frame(cam, 0, 0, mf->width, mf->height);
-        
+        vc_sd_update_ctrl_ranges(device);
+        mutex_unlock(device->ctrl_handler.lock);
+
+        // Return the format actually set.
+        return vc_sd_get_fmt(sd, sd_state, fmt);
+}
+
+static int vc_sd_init_cfg(struct v4l2_subdev *sd, struct v4l2_subdev_state *sd_state)
+{
+        struct vc_cam *cam = to_vc_cam(sd);
+        struct v4l2_mbus_framefmt *try_fmt = v4l2_subdev_get_try_format(sd, sd_state, 0);
+
+        try_fmt->code = vc_core_get_format(cam);
+        try_fmt->width = cam->ctrl.frame.width;
+        try_fmt->height = cam->ctrl.frame.height;
+        try_fmt->field = V4L2_FIELD_NONE;
+        try_fmt->colorspace = V4L2_COLORSPACE_RAW;
+
+        return 0;
+}
+
+static int vc_sd_enum_mbus_code(struct v4l2_subdev *sd, struct v4l2_subdev_state *sd_state,
+                                struct v4l2_subdev_mbus_code_enum *code)
+{
+        struct vc_cam *cam = to_vc_cam(sd);
+
+        return vc_core_enum_format(cam, code->index, &code->code);
+}
+
+static int vc_sd_enum_frame_size(struct v4l2_subdev *sd, struct v4l2_subdev_state *sd_state,
+                                 struct v4l2_subdev_frame_size_enum *fse)
+{
+        struct vc_cam *cam = to_vc_cam(sd);
+
+        if (fse->index > 0 || vc_core_try_format(cam, fse->code))
+                return -EINVAL;
+
+        // The image can be cropped to any size inside the active pixel array.
+        fse->min_width = 1;
+        fse->max_width = cam->ctrl.frame.width;
+        fse->min_height = 1;
+        fse->max_height = cam->ctrl.frame.height;
+
         return 0;
 }
 
+static int vc_sd_get_selection(struct v4l2_subdev *sd, struct v4l2_subdev_state *sd_state,
+                               struct v4l2_subdev_selection *sel)
+{
+        struct vc_cam *cam = to_vc_cam(sd);
+        struct vc_frame *active = &cam->ctrl.frame;
+        struct vc_frame *frame = &cam->state.frame;
+
+        switch (sel->target) {
+        case V4L2_SEL_TGT_NATIVE_SIZE:
+                sel->r.left = 0;
+                sel->r.top = 0;
+                sel->r.width = active->left + active->width;
+                sel->r.height = active->top + active->height;
+                return 0;
+
+        case V4L2_SEL_TGT_CROP_BOUNDS:
+        case V4L2_SEL_TGT_CROP_DEFAULT:
+                sel->r.left = active->left;
+                sel->r.top = active->top;
+                sel->r.width = active->width;
+                sel->r.height = active->height;
+                return 0;
+
+        case V4L2_SEL_TGT_CROP:
+                if (sel->which == V4L2_SUBDEV_FORMAT_TRY) {
+                        struct v4l2_mbus_framefmt *try_fmt = v4l2_subdev_get_try_format(sd, sd_state, sel->pad);
+                        sel->r.left = active->left;
+                        sel->r.top = active->top;
+                        sel->r.width = try_fmt->width;
+                        sel->r.height = try_fmt->height;
+                        return 0;
+                }
+                sel->r.left = active->left + frame->left;
+                sel->r.top = active->top + frame->top;
+                sel->r.width = frame->width;
+                sel->r.height = frame->height;
+                return 0;
+        }
+
+        return -EINVAL;
+}
+
 // --- v4l2_ctrl_ops ---------------------------------------------------
 
+static void vc_ctrl_modify_range(struct v4l2_ctrl *ctrl, struct vc_control *control)
+{
+        __u32 def = clamp(control->def, control->min, control->max);
+
+        if (ctrl == NULL)
+                return;
+
+        if (ctrl->minimum == control->min && ctrl->maximum == control->max && ctrl->default_value == def)
+                return;
+
+        // Raises a V4L2_EVENT_CTRL_CH_RANGE event and clamps the current value if necessary.
+        __v4l2_ctrl_modify_range(ctrl, control->min, control->max, 1, def);
+}
+
+static void vc_ctrl_modify_range64(struct v4l2_ctrl *ctrl, __u64 value)
+{
+        if (ctrl == NULL)
+                return;
+
+        if (ctrl->minimum == value && ctrl->maximum == value)
+                return;
+
+        __v4l2_ctrl_modify_range(ctrl, value, value, 1, value);
+}
+
+static int vc_sd_find_link_freq(struct vc_device *device, __u64 link_freq)
+{
+        int index;
+
+        for (index = 0; index < device->num_link_freqs; index++) {
+                if (device->link_freqs[index] == link_freq)
+                        return index;
+        }
+        return 0;
+}
+
+// Has to be called with the control handler lock held.
+static void vc_sd_update_ctrl_ranges(struct vc_device *device)
+{
+        struct vc_ctrl *ctrl = &device->cam.ctrl;
+        struct vc_control flash = { .min = 0, .max = ctrl->exposure.max, .def = 0 };
+
+        vc_ctrl_modify_range(device->ctrl_exposure, &ctrl->exposure);
+        vc_ctrl_modify_range(device->ctrl_flash_offset, &flash);
+        vc_ctrl_modify_range(device->ctrl_flash_duration, &flash);
+        vc_ctrl_modify_range(device->ctrl_frame_rate, &ctrl->framerate);
+        vc_ctrl_modify_range(device->ctrl_exposure_lines, &ctrl->exposure_lines);
+        vc_ctrl_modify_range(device->ctrl_hblank, &ctrl->hblank);
+        vc_ctrl_modify_range(device->ctrl_vblank, &ctrl->vblank);
+        vc_ctrl_modify_range64(device->ctrl_pixel_rate, ctrl->pixel_rate);
+        if (device->ctrl_link_freq)
+                __v4l2_ctrl_s_ctrl(device->ctrl_link_freq, vc_sd_find_link_freq(device, ctrl->link_freq));
+}
+
+// Sets a control to the value the sensor already uses. It raises a V4L2_EVENT_CTRL_CH_VALUE event,
+// vc_ctrl_s_ctrl() doesn't write the sensor again.
+static void vc_sd_sync_ctrl(struct vc_device *device, struct v4l2_ctrl *ctrl, s32 value)
+{
+        if (ctrl == NULL || ctrl->cur.val == value)
+                return;
+
+        device->ctrl_sync = 1;
+        __v4l2_ctrl_s_ctrl(ctrl, value);
+        device->ctrl_sync = 0;
+}
+
+// Gain and analogue gain as well as the exposure in µs and in lines set the same sensor value.
+// Has to be called with the control handler lock held.
+static void vc_sd_sync_ctrls(struct vc_device *device, struct v4l2_ctrl *ctrl)
+{
+        struct vc_cam *cam = &device->cam;
+
+        switch (ctrl->id) {
+        case V4L2_CID_GAIN:
+                vc_sd_sync_ctrl(device, device->ctrl_analogue_gain, cam->state.gain);
+                break;
+
+        case V4L2_CID_ANALOGUE_GAIN:
+                vc_sd_sync_ctrl(device, device->ctrl_gain, cam->state.gain);
+                break;
+
+        case V4L2_CID_EXPOSURE:
+                // In lines (exposure_in_lines) it is the only exposure control.
+                if (device->ctrl_exposure)
+                        vc_sd_sync_ctrl(device, device->ctrl_exposure_lines, vc_core_get_exposure_lines(cam));
+                break;
+
+        case V4L2_CID_VC_EXPOSURE_LINES:
+                vc_sd_sync_ctrl(device, device->ctrl_exposure, cam->state.exposure);
+                break;
+        }
+}
+
+// The exposure, the vertical blanking and the frame rate determine the frame length together. The
+// other two controls report the resulting vertical blanking and frame rate.
+// Has to be called with the control handler lock held.
+static void vc_sd_sync_frame_ctrls(struct vc_device *device, struct v4l2_ctrl *ctrl)
+{
+        __u32 vblank, framerate;
+
+        vc_core_get_frame_timing(&device->cam, &vblank, &framerate);
+        if (framerate == 0)
+                return;
+
+        if (ctrl != device->ctrl_vblank)
+                vc_sd_sync_ctrl(device, device->ctrl_vblank, vblank);
+        if (ctrl != device->ctrl_frame_rate)
+                vc_sd_sync_ctrl(device, device->ctrl_frame_rate, framerate);
+}
+
 int vc_ctrl_s_ctrl(struct v4l2_ctrl *ctrl)
 {
         struct vc_device *device = container_of(ctrl->handler, struct vc_device, ctrl_handler);
         struct v4l2_control control;
+        __u64 start;
+        int ret;
+
+        // Read-only controls only reflect the sensor timing, synchronised ones the sensor settings.
+        if (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY || device->ctrl_sync)
+                return 0;
+
+        // The cluster of trigger period and count is also set for a new count only, which is applied
+        // by the next start of the trigger generator. A new period starts it with the new count.
+        if (ctrl->id == V4L2_CID_VC_TRIGGER_PERIOD && !ctrl->is_new)
+                return 0;
 
         control.id = ctrl->id;
         control.value = ctrl->val;
-        vc_sd_s_ctrl(&device->sd, &control);
+        start = ktime_get_ns();
+        ret = vc_sd_s_ctrl(&device->sd, &control);
+        trace_vc_ctrl(device->cam.ctrl.client_sen->addr, ctrl->id, ctrl->val, ret, ktime_get_ns() - start);
 
-        return 0;
+        if (ret == 0)
+                vc_sd_sync_ctrls(device, ctrl);
+
+        switch (ctrl->id) {
+        case V4L2_CID_EXPOSURE:
+        case V4L2_CID_VC_EXPOSURE_LINES:
+        case V4L2_CID_VBLANK:
+        case V4L2_CID_VC_FRAME_RATE:
+                vc_sd_update_ctrl_ranges(device);
+                if (ret == 0) {
+                        vc_sd_sync_frame_ctrls(device, ctrl);
+                        // A longer exposure raises the minimum period of the trigger generator.
+                        vc_trigger_update(&device->cam);
+                }
+                break;
+
+        // The trigger mode determines the exposure limits.
+        case V4L2_CID_VC_TRIGGER_MODE:
+                vc_sd_update_ctrl_ranges(device);
+                break;
+        }
+
+        return ret;
 }
 
 
@@ -204,134 +603,436 @@ static int vc_sd_parse_dt(struct vc_device *device)
         return 0;
 }
 
-// static const struct v4l2_subdev_core_ops vc_core_ops = {
-//         .s_power = vc_sd_s_power,
-//         .s_ctrl = vc_sd_s_ctrl,
-// };
+// The modules of the other cameras on the I2C segment are put into reset, so that only the module
+// of this camera answers at the default addresses. A camera which is probed already holds its reset
+// GPIO, its module has been moved before. The GPIO of a camera which isn't probed yet is released
+// again right away, the line keeps its level until the camera requests it itself.
+static int vc_sd_reset_segment(struct vc_cam *cam, struct device *dev)
+{
+        struct i2c_client *client = to_i2c_client(dev);
+        struct fwnode_handle *child;
+        struct gpio_desc *gpio;
+        int ret = 0;
+        int others = 0;
+
+        device_for_each_child_node(&client->adapter->dev, child) {
+                if (child == dev_fwnode(dev) || !fwnode_device_is_available(child) ||
+                    fwnode_property_match_string(child, "compatible", "vc,vc_mipi") < 0)
+                        continue;
+
+                others++;
+                if (!fwnode_property_present(child, "reset-gpios")) {
+                        vc_err(dev, "%s(): %pfwP shares the I2C bus, but has no reset-gpios\n", __FUNCTION__, child);
+                        ret = -EINVAL;
+                        continue;
+                }
+
+                gpio = fwnode_gpiod_get_index(child, "reset", 0, GPIOD_OUT_HIGH, "vc_mipi reset");
+                if (IS_ERR(gpio))
+                        continue;
+                gpiod_put(gpio);
+        }
+
+        if (others && cam->ctrl.reset_gpio == NULL) {
+                vc_err(dev, "%s(): The I2C bus is shared with %d other camera(s), reset-gpios is required\n",
+                        __FUNCTION__, others);
+                ret = -EINVAL;
+        }
+
+        return ret;
+}
+
+// Several modules can share one I2C segment. The module is moved from its default addresses to the
+// address of the node (sensor) and vc,mod-addr (module controller). Each module needs a reset GPIO
+// which holds it in reset until it is probed and after it is removed, e.g.
+//
+//   camera@1c {
+//           compatible = "vc,vc_mipi";
+//           reg = <0x1c>;
+//           vc,mod-addr = <0x11>;
+//           reset-gpios = <&gpio 5 GPIO_ACTIVE_LOW>;
+//   };
+static int vc_sd_parse_addr(struct vc_cam *cam, struct device *dev)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        __u32 value;
+
+        if (device_property_read_u32(dev, "vc,mod-addr", &value) == 0) {
+                if (value < 0x08 || value > 0x77) {
+                        vc_err(dev, "%s(): Invalid vc,mod-addr 0x%02x\n", __FUNCTION__, value);
+                        return -EINVAL;
+                }
+                ctrl->mod_i2c_addr_target = value;
+        }
+
+        // Requested in reset, vc_core_init() releases it.
+        ctrl->reset_gpio = devm_gpiod_get_optional(dev, "reset", GPIOD_OUT_HIGH);
+        if (IS_ERR(ctrl->reset_gpio)) {
+                vc_err(dev, "%s(): Unable to get reset GPIO\n", __FUNCTION__);
+                return PTR_ERR(ctrl->reset_gpio);
+        }
+
+        return vc_sd_reset_segment(cam, dev);
+}
+
+static const struct v4l2_subdev_core_ops vc_core_ops = {
+        // .s_power = vc_sd_s_power,
+        .subscribe_event = v4l2_ctrl_subdev_subscribe_event,
+        .unsubscribe_event = v4l2_event_subdev_unsubscribe,
+};
 
 static const struct v4l2_subdev_video_ops vc_video_ops = {
         .s_stream = vc_sd_s_stream,
 };
 
 static const struct v4l2_subdev_pad_ops vc_pad_ops = {
+        .init_cfg = vc_sd_init_cfg,
+        .enum_mbus_code = vc_sd_enum_mbus_code,
+        .enum_frame_size = vc_sd_enum_frame_size,
         .get_fmt = vc_sd_get_fmt,
         .set_fmt = vc_sd_set_fmt,
+        .get_selection = vc_sd_get_selection,
 };
 
 static const struct v4l2_subdev_ops vc_subdev_ops = {
-        // .core = &vc_core_ops,
+        .core = &vc_core_ops,
         .video = &vc_video_ops,
         .pad = &vc_pad_ops,
 };
 
+// The flash controls read back the window actually applied inside the current exposure.
+static int vc_ctrl_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+        struct vc_device *device = container_of(ctrl->handler, struct vc_device, ctrl_handler);
+        __u32 offset_us, duration_us;
+
+        switch (ctrl->id) {
+        case V4L2_CID_VC_FLASH_OFFSET:
+        case V4L2_CID_VC_FLASH_DURATION:
+                vc_core_calculate_flash_window(&device->cam, &offset_us, &duration_us);
+                ctrl->val = ctrl->id == V4L2_CID_VC_FLASH_OFFSET ? offset_us : duration_us;
+                break;
+        }
+
+        return 0;
+}
+
 static const struct v4l2_ctrl_ops vc_ctrl_ops = {
+        .g_volatile_ctrl = vc_ctrl_g_volatile_ctrl,
         .s_ctrl = vc_ctrl_s_ctrl,
 };
 
-static int vc_ctrl_init_ctrl(struct vc_device *device, struct v4l2_ctrl_handler *hdl, int id, struct vc_control* control) 
+static struct v4l2_ctrl *vc_ctrl_init_ctrl(struct vc_device *device, struct v4l2_ctrl_handler *hdl, int id, struct vc_control* control) 
 {
         struct i2c_client *client = device->cam.ctrl.client_sen;
         struct device *dev = &client->dev;
         struct v4l2_ctrl *ctrl;
+        __u32 def = clamp(control->def, control->min, control->max);
 
-        ctrl = v4l2_ctrl_new_std(&device->ctrl_handler, &vc_ctrl_ops, id, control->min, control->max, 1, control->def);
+        ctrl = v4l2_ctrl_new_std(&device->ctrl_handler, &vc_ctrl_ops, id, control->min, control->max, 1, def);
         if (ctrl == NULL) {
                 vc_err(dev, "%s(): Failed to init 0x%08x ctrl\n", __FUNCTION__, id);
-                return -EIO;
         }
 
-        return 0;
+        return ctrl;
 }
 
-// static int vc_ctrl_init_custom_ctrl(struct vc_device *device, struct v4l2_ctrl_handler *hdl, const struct v4l2_ctrl_config *config) 
-// {
-//         struct i2c_client *client = device->cam.ctrl.client_sen;
-//         struct device *dev = &client->dev;
-//         struct v4l2_ctrl *ctrl;
+static struct v4l2_ctrl *vc_ctrl_init_custom_ctrl(struct vc_device *device, struct v4l2_ctrl_handler *hdl, const struct v4l2_ctrl_config *config) 
+{
+        struct i2c_client *client = device->cam.ctrl.client_sen;
+        struct device *dev = &client->dev;
+        struct v4l2_ctrl *ctrl;
 
-//         ctrl = v4l2_ctrl_new_custom(&device->ctrl_handler, config, NULL);
-//         if (ctrl == NULL) {
-//                 vc_err(dev, "%s(): Failed to init 0x%08x ctrl\n", __FUNCTION__, config->id);
-//                 return -EIO;
-//         }
+        ctrl = v4l2_ctrl_new_custom(&device->ctrl_handler, config, NULL);
+        if (ctrl == NULL) {
+                vc_err(dev, "%s(): Failed to init 0x%08x ctrl\n", __FUNCTION__, config->id);
+        }
 
-//         return 0;
-// }
+        return ctrl;
+}
+
+static const char * const vc_trigger_mode_menu[] = {
+        "Disabled",
+        "External",
+        "Pulse Width",
+        "Self",
+        "Single",
+        "Sync",
+        "Stream Edge",
+        "Stream Level",
+};
+
+static const char * const vc_io_mode_menu[] = {
+        "Disabled",
+        "Flash Active High",
+        "Flash Active Low",
+        "Trigger Active Low",
+        "Trigger Active Low, Flash Active High",
+        "Trigger and Flash Active Low",
+};
+
+static const struct v4l2_ctrl_config ctrl_trigger_mode = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_TRIGGER_MODE,
+        .name = "Trigger Mode",
+        .type = V4L2_CTRL_TYPE_MENU,
+        .min = 0,
+        .max = ARRAY_SIZE(vc_trigger_mode_menu) - 1,
+        .def = 0,
+        .qmenu = vc_trigger_mode_menu,
+};
+
+static const struct v4l2_ctrl_config ctrl_io_mode = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_IO_MODE,
+        .name = "IO Mode",
+        .type = V4L2_CTRL_TYPE_MENU,
+        .min = 0,
+        .max = ARRAY_SIZE(vc_io_mode_menu) - 1,
+        .def = 0,
+        .qmenu = vc_io_mode_menu,
+};
+
+static const struct v4l2_ctrl_config ctrl_frame_rate = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_FRAME_RATE,
+        .name = "Frame Rate [mHz]",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_SLIDER,
+        .min = 0,
+        .max = 1000000,
+        .step = 1,
+        .def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_exposure_lines = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_EXPOSURE_LINES,
+        .name = "Exposure [lines]",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .min = 1,
+        .max = 1,
+        .step = 1,
+        .def = 1,
+};
+
+static const struct v4l2_ctrl_config ctrl_single_trigger = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_SINGLE_TRIGGER,
+        .name = "Single Trigger",
+        .type = V4L2_CTRL_TYPE_BUTTON,
+        .min = 0,
+        .max = 0,
+        .step = 0,
+        .def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_trigger_period = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_TRIGGER_PERIOD,
+        .name = "Trigger Period [us]",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+        .min = 0,
+        .max = 10000000,
+        .step = 1,
+        .def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_trigger_count = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_TRIGGER_COUNT,
+        .name = "Trigger Count",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .min = 0,
+        .max = 1000000,
+        .step = 1,
+        .def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_flash_offset = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_FLASH_OFFSET,
+        .name = "Flash Offset [us]",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_VOLATILE | V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+        .min = 0,
+        .max = 1,
+        .step = 1,
+        .def = 0,
+};
 
-// static const struct v4l2_ctrl_config ctrl_trigger_mode = {
-//         .ops = &vc_ctrl_ops,
-//         .id = V4L2_CID_TRIGGER_MODE,
-//         .name = "Trigger Mode",
-//         .type = V4L2_CTRL_TYPE_INTEGER,
-//         .flags = V4L2_CTRL_FLAG_SLIDER,
-//         .min = 0,
-//         .max = 7,
-//         .step = 1,
-//         .def = 0,
-// };
-
-// static const struct v4l2_ctrl_config ctrl_flash_mode = {
-//         .ops = &vc_ctrl_ops,
-//         .id = V4L2_CID_FLASH_MODE,
-//         .name = "Flash Mode",
-//         .type = V4L2_CTRL_TYPE_INTEGER,
-//         .flags = V4L2_CTRL_FLAG_SLIDER,
-//         .min = 0,
-//         .max = 1,
-//         .step = 1,
-//         .def = 0,
-// };
-
-// static const struct v4l2_ctrl_config ctrl_frame_rate = {
-//         .ops = &vc_ctrl_ops,
-//         .id = V4L2_CID_FRAME_RATE,
-//         .name = "Frame Rate",
-//         .type = V4L2_CTRL_TYPE_INTEGER,
-//         .flags = V4L2_CTRL_FLAG_SLIDER,
-//         .min = 0,
-//         .max = 1000,
-//         .step = 1,
-//         .def = 0,
-// };
-
-// static const struct v4l2_ctrl_config ctrl_single_trigger = {
-//         .ops = &vc_ctrl_ops,
-//         .id = V4L2_CID_SINGLE_TRIGGER,
-//         .name = "Single Trigger",
-//         .type = V4L2_CTRL_TYPE_INTEGER,
-//         .flags = V4L2_CTRL_FLAG_SLIDER,
-//         .min = 0,
-//         .max = 1,
-//         .step = 1,
-//         .def = 0,
-// };
+static const struct v4l2_ctrl_config ctrl_flash_duration = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_FLASH_DURATION,
+        .name = "Flash Duration [us]",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_VOLATILE | V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+        .min = 0,
+        .max = 1,
+        .step = 1,
+        .def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_prepare_stream = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_VC_PREPARE_STREAM,
+        .name = "Prepare Stream",
+        .type = V4L2_CTRL_TYPE_BUTTON,
+        .min = 0,
+        .max = 0,
+        .step = 0,
+        .def = 0,
+};
+
+static __u64 vc_ctrl_get_trigger_mode_skip_mask(struct vc_cam *cam)
+{
+        // Menu index i corresponds to the mode argument of vc_mod_set_trigger_mode().
+        __u64 mask = 0;
+        int mode;
+
+        for (mode = 0; mode < ARRAY_SIZE(vc_trigger_mode_menu); mode++) {
+                if (!vc_mod_is_trigger_mode_supported(cam, mode))
+                        mask |= BIT(mode);
+        }
+
+        return mask;
+}
+
+static void vc_sd_init_link_freqs(struct vc_device *device)
+{
+        struct vc_desc *desc = &device->cam.desc;
+        int index;
+
+        device->num_link_freqs = 0;
+        for (index = 0; index < desc->num_modes && index < VC_MAX_LINK_FREQS; index++) {
+                __u64 link_freq = vc_core_get_mode_link_freq(&desc->modes[index]);
+                int known;
+
+                for (known = 0; known < device->num_link_freqs; known++) {
+                        if (device->link_freqs[known] == link_freq)
+                                break;
+                }
+                if (known == device->num_link_freqs)
+                        device->link_freqs[device->num_link_freqs++] = link_freq;
+        }
+}
 
 static int vc_sd_init(struct vc_device *device)
 {
         struct i2c_client *client = device->cam.ctrl.client_sen;
         struct device *dev = &client->dev;
+        struct vc_cam *cam = &device->cam;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct v4l2_ctrl_config config;
+        struct vc_control blacklevel = { .min = 0, .max = 100000, .def = cam->state.blacklevel };
+        char sensor_name[V4L2_SUBDEV_NAME_SIZE];
         int ret;
 
         // Initializes the subdevice
         v4l2_i2c_subdev_init(&device->sd, client, &vc_subdev_ops);
 
+        // Name the entity after the sensor (e.g. "imx296 6-001a"). libcamera uses it to select
+        // the sensor properties and gain model.
+        vc_core_get_sensor_name(cam, sensor_name, sizeof(sensor_name));
+        v4l2_i2c_subdev_set_name(&device->sd, client, sensor_name, NULL);
+
         // Initialize the handler
-        ret = v4l2_ctrl_handler_init(&device->ctrl_handler, 3);
+        ret = v4l2_ctrl_handler_init(&device->ctrl_handler, 18);
         if (ret) {
                 vc_err(dev, "%s(): Failed to init control handler\n", __FUNCTION__);
                 return ret;
         }
         // Hook the control handler into the driver
         device->sd.ctrl_handler = &device->ctrl_handler;
+        cam->lock = device->ctrl_handler.lock;
 
         // Add controls
-        ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_EXPOSURE, &device->cam.ctrl.exposure);
-        ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_GAIN, &device->cam.ctrl.gain);
-        //ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_BLACK_LEVEL, &device->cam.ctrl.csr.sen.blacklevel);
-        // ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_trigger_mode);
-        // ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_flash_mode);
-        // ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_frame_rate);
-        // ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_single_trigger);
+        if (exposure_in_lines) {
+                device->ctrl_exposure_lines = vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_EXPOSURE, &ctrl->exposure_lines);
+        } else {
+                device->ctrl_exposure = vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_EXPOSURE, &ctrl->exposure);
+        }
+        device->ctrl_gain = vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_GAIN, &ctrl->gain);
+        device->ctrl_analogue_gain = vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_ANALOGUE_GAIN, &ctrl->gain);
+        if (ctrl->csr.sen.blacklevel.l) {
+                vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_BLACK_LEVEL, &blacklevel);
+        }
+
+        config = ctrl_trigger_mode;
+        config.menu_skip_mask = vc_ctrl_get_trigger_mode_skip_mask(cam);
+        device->ctrl_trigger_mode = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &config);
+
+        if (ctrl->flags & FLAG_IO_ENABLED) {
+                device->ctrl_io_mode = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_io_mode);
+
+                // Without strobe timing registers the flash covers the whole exposure, the controls
+                // only report the window.
+                config = ctrl_flash_offset;
+                config.max = ctrl->exposure.max;
+                if (!vc_core_has_flash_timing(cam))
+                        config.flags |= V4L2_CTRL_FLAG_READ_ONLY;
+                device->ctrl_flash_offset = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &config);
+
+                config = ctrl_flash_duration;
+                config.max = ctrl->exposure.max;
+                if (!vc_core_has_flash_timing(cam))
+                        config.flags |= V4L2_CTRL_FLAG_READ_ONLY;
+                device->ctrl_flash_duration = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &config);
+        }
+
+        // The frame length of a generic module can't be changed (VMAX is never written).
+        if (!(ctrl->flags & FLAG_GENERIC)) {
+                config = ctrl_frame_rate;
+                config.min = ctrl->framerate.min;
+                config.max = ctrl->framerate.max;
+                config.def = ctrl->framerate.def;
+                device->ctrl_frame_rate = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &config);
+        }
+
+        if (ctrl->flags & FLAG_TRIGGER_SINGLE) {
+                vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_single_trigger);
+        }
+        if (cam->trigger) {
+                device->ctrl_trigger_count = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_trigger_count);
+                device->ctrl_trigger_period = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_trigger_period);
+                if (device->ctrl_trigger_period && device->ctrl_trigger_count)
+                        v4l2_ctrl_cluster(2, &device->ctrl_trigger_period);
+        }
+        vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_prepare_stream);
+
+        // Sensor timing
+        if (!exposure_in_lines) {
+                config = ctrl_exposure_lines;
+                config.min = ctrl->exposure_lines.min;
+                config.max = ctrl->exposure_lines.max;
+                config.def = clamp(ctrl->exposure_lines.def, ctrl->exposure_lines.min, ctrl->exposure_lines.max);
+                device->ctrl_exposure_lines = vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &config);
+        }
+
+        device->ctrl_pixel_rate = v4l2_ctrl_new_std(&device->ctrl_handler, &vc_ctrl_ops, V4L2_CID_PIXEL_RATE,
+                ctrl->pixel_rate, ctrl->pixel_rate, 1, ctrl->pixel_rate);
+
+        vc_sd_init_link_freqs(device);
+        device->ctrl_link_freq = v4l2_ctrl_new_int_menu(&device->ctrl_handler, &vc_ctrl_ops, V4L2_CID_LINK_FREQ,
+                device->num_link_freqs - 1, vc_sd_find_link_freq(device, ctrl->link_freq), device->link_freqs);
+        if (device->ctrl_link_freq)
+                device->ctrl_link_freq->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+
+        device->ctrl_hblank = vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_HBLANK, &ctrl->hblank);
+        if (device->ctrl_hblank)
+                device->ctrl_hblank->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+
+        if (!(ctrl->flags & FLAG_GENERIC)) {
+                device->ctrl_vblank = vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_VBLANK, &ctrl->vblank);
+        }
+
+        if (device->ctrl_handler.error) {
+                ret = device->ctrl_handler.error;
+                vc_err(dev, "%s(): Failed to add controls (error: %d)\n", __FUNCTION__, ret);
+                v4l2_ctrl_handler_free(&device->ctrl_handler);
+                return ret;
+        }
 
         return 0;
 }
@@ -352,12 +1053,14 @@ static int vc_probe(struct i2c_client *client)
         struct fwnode_handle *endpoint;
         struct vc_device *device;
         struct vc_cam *cam;
+        __u32 group;
         int ret;
 
         device = devm_kzalloc(dev, sizeof(*device), GFP_KERNEL);
         if (!device)
                 return -ENOMEM;
         cam = &device->cam;
+        INIT_WORK(&device->prepare_work, vc_sd_prepare_work);
 
         endpoint = fwnode_graph_get_next_endpoint(dev_fwnode(dev), NULL);
         if (!endpoint) {
@@ -372,17 +1075,28 @@ static int vc_probe(struct i2c_client *client)
                 return ret;
         }
 
+        ret = vc_sd_parse_addr(cam, dev);
+        if (ret)
+                return ret;
+
         ret  = vc_core_init(cam, client);
         if (ret)
-                goto free_ctrls;
+                goto free_core;
 
         ret = vc_sd_parse_dt(device);
         if (ret)
                 goto free_ctrls;
 
+        // Software trigger generator for the single trigger mode
+        if (cam->ctrl.flags & FLAG_TRIGGER_SINGLE) {
+                ret = vc_trigger_init(cam);
+                if (ret)
+                        goto free_ctrls;
+        }
+
         ret = vc_sd_init(device);
         if (ret)
-                goto free_ctrls;
+                goto free_trigger;
 
         device->sd.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE | V4L2_SUBDEV_FL_HAS_EVENTS;
         device->pad.flags = MEDIA_PAD_FL_SOURCE;
@@ -390,17 +1104,32 @@ static int vc_probe(struct i2c_client *client)
         device->sd.entity.function = MEDIA_ENT_F_CAM_SENSOR;
         ret = media_entity_pads_init(&device->sd.entity, 1, &device->pad);
         if (ret)
-                return ret;
+                goto free_trigger;
+
+        // Cameras with the same vc,sync-group start streaming together.
+        if (device_property_read_u32(dev, "vc,sync-group", &group) == 0) {
+                ret = vc_group_join(cam, group);
+                if (ret)
+                        goto free_trigger;
+        }
 
         ret = v4l2_async_register_subdev_sensor(&device->sd);
         if (ret)
-                goto free_ctrls;
+                goto leave_group;
+
+        vc_debugfs_add_cam(cam, dev_name(dev));
 
         return 0;
 
+leave_group:
+        vc_group_leave(cam);
+free_trigger:
+        vc_trigger_free(cam);
 free_ctrls:
         v4l2_ctrl_handler_free(&device->ctrl_handler);
         media_entity_cleanup(&device->sd.entity);
+free_core:
+        vc_core_free(cam);
         return ret;
 }
 
@@ -409,10 +1138,15 @@ static void vc_remove(struct i2c_client *client)
         struct v4l2_subdev *sd = i2c_get_clientdata(client);
         struct vc_device *device = to_vc_device(sd);
 
+        cancel_work_sync(&device->prepare_work);
+        vc_debugfs_remove_cam(&device->cam);
+        vc_group_leave(&device->cam);
+        vc_trigger_free(&device->cam);
+        vc_core_free_capture(&device->cam);
         v4l2_async_unregister_subdev(&device->sd);
         media_entity_cleanup(&device->sd.entity);
         v4l2_ctrl_handler_free(&device->ctrl_handler);
-
+        vc_core_free(&device->cam);
 }
 
 static const struct i2c_device_id vc_id[] = {
@@ -437,7 +1171,26 @@ static struct i2c_driver vc_i2c_driver = {
         .remove   = vc_remove,
 };
 
-module_i2c_driver(vc_i2c_driver);
+static int __init vc_init(void)
+{
+        int ret;
+
+        vc_debugfs_init();
+        ret = i2c_add_driver(&vc_i2c_driver);
+        if (ret)
+                vc_debugfs_exit();
+
+        return ret;
+}
+
+static void __exit vc_exit(void)
+{
+        i2c_del_driver(&vc_i2c_driver);
+        vc_debugfs_exit();
+}
+
+module_init(vc_init);
+module_exit(vc_exit);
 
 MODULE_VERSION("0.99.0");
 MODULE_DESCRIPTION("Vision Components GmbH - VC MIPI NVIDIA driver");
@@ -3,12 +3,20 @@
 #include <linux/device.h>
 #include <linux/delay.h>
 #include <linux/errno.h>
+#include <linux/gpio/consumer.h>
 #include <linux/v4l2-mediabus.h>
 
 #include  <linux/kernel.h>
+#include <linux/ctype.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
 
 #include "vc_mipi_modules.h"
 
+#define CREATE_TRACE_POINTS
+#include "vc_mipi_trace.h"
+
 // #define READ_VMAX
 
 #define MOD_REG_RESET            0x0100 // register  0 [0x0100]: reset and init register (R/W)
@@ -29,6 +37,9 @@
 #define MOD_REG_RETRIG_H         0x010F // register 15 [0x010F]: retrigger     (R/W, default: 0x29)
 #define MOD_REG_RETRIG_U         0x0110 // register 16 [0x0110]: retrigger MSB (R/W, default: 0x00)
 
+#define MOD_DEFAULT_ADDR         0x10   // Addresses of the module after power up or reset
+#define SEN_DEFAULT_ADDR         0x1a
+
 #define REG_RESET_PWR_UP         0x00
 #define REG_RESET_SENSOR         0x01   // reg0[0] = 0 sensor reset the sensor is held in reset when this bit is 1
 #define REG_RESET_PWR_DOWN       0x02   // reg0[1] = 0 power down power for the sensor is switched off
@@ -51,23 +62,222 @@
 #define REG_TRIGGER_STREAM_EDGE  0x20
 #define REG_TRIGGER_STREAM_LEVEL 0x60
 
-#define MODE_TYPE_STREAM         0x01
-#define MODE_TYPE_TRIGGER        0x02
-#define MODE_TYPE_SLAVE          0x03
-
 // ------------------------------------------------------------------------------------------------
 // Function prototypes
 
-__u32 vc_core_calculate_max_exposure(struct vc_cam *cam, __u8 num_lanes, __u8 format);
-__u32 vc_core_calculate_max_frame_rate(struct vc_cam *cam, __u8 num_lanes, __u8 format);
 static __u32 vc_core_calculate_period_1H(struct vc_cam *cam, __u8 num_lanes, __u8 format);
+static void vc_core_unprepare_stream(struct vc_cam *cam);
+
+static __u8 vc_mod_get_mode_type(struct vc_cam *cam);
+static __u8 vc_mod_find_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format, __u8 type, __u8 binning);
 
 static int vc_sen_read_image_size(struct vc_ctrl *ctrl, struct vc_frame *size);
+static int vc_sen_write_flash(struct vc_cam *cam);
 #ifdef READ_VMAX
 static __u32 vc_sen_read_vmax(struct vc_ctrl *ctrl);
 #endif
 
 
+// ------------------------------------------------------------------------------------------------
+//  Helper Functions for I2C Traffic Statistics
+
+static const char * const vc_op_names[VC_OP_NUM] = {
+        [VC_OP_OTHER]           = "other",
+        [VC_OP_SET_EXPOSURE]    = "set_exposure",
+        [VC_OP_SET_GAIN]        = "set_gain",
+        [VC_OP_SET_ROI]         = "set_roi",
+        [VC_OP_START_STREAM]    = "start_stream",
+        [VC_OP_STOP_STREAM]     = "stop_stream",
+        [VC_OP_MODE_RESET]      = "mode_reset",
+        [VC_OP_DESC_LOAD]       = "desc_load",
+};
+
+const char *vc_core_get_op_name(enum vc_op op)
+{
+        return op < VC_OP_NUM ? vc_op_names[op] : "unknown";
+}
+
+void vc_core_reset_stats(struct vc_cam *cam)
+{
+        enum vc_op op = cam->stats.op;
+
+        memset(&cam->stats, 0, sizeof(cam->stats));
+        cam->stats.op = op;
+}
+
+// Accounts all following I2C transactions to the given operation. Returns the
+// previous operation, which has to be passed to vc_stats_end() (calls may nest).
+static enum vc_op vc_stats_begin(struct vc_cam *cam, enum vc_op op, __u64 *start)
+{
+        enum vc_op prev = cam->stats.op;
+
+        cam->stats.op = op;
+        cam->stats.ops[op].calls++;
+        *start = ktime_get_ns();
+
+        return prev;
+}
+
+static void vc_stats_end(struct vc_cam *cam, enum vc_op prev, __u64 start)
+{
+        struct vc_op_stats *stats = &cam->stats.ops[cam->stats.op];
+        __u64 duration = ktime_get_ns() - start;
+        int bucket = fls64(div_u64(duration, NSEC_PER_USEC));
+
+        stats->total_ns += duration;
+        if (duration > stats->max_ns)
+                stats->max_ns = duration;
+        stats->hist[min(bucket, VC_STATS_HIST_SIZE - 1)]++;
+
+        cam->stats.op = prev;
+}
+
+static void vc_stats_account(struct vc_ctrl *ctrl, __u32 bytes, int ret)
+{
+        struct vc_cam *cam;
+        struct vc_op_stats *stats;
+
+        // Transactions issued via vc_read_i2c_reg() or vc_write_i2c_reg() have no camera context
+        if (ctrl == NULL)
+                return;
+
+        cam = container_of(ctrl, struct vc_cam, ctrl);
+        stats = &cam->stats.ops[cam->stats.op];
+        stats->transactions++;
+        stats->bytes += bytes;
+        if (ret)
+                stats->errors++;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+//  Helper Functions for the Register Capture
+
+// Clears the previous session and records all following register transactions.
+int vc_core_start_capture(struct vc_cam *cam)
+{
+        struct vc_capture *capture = &cam->capture;
+
+        mutex_lock(&capture->lock);
+        if (capture->entries == NULL)
+                capture->entries = vzalloc(VC_CAPTURE_SIZE * sizeof(*capture->entries));
+        if (capture->entries == NULL) {
+                mutex_unlock(&capture->lock);
+                return -ENOMEM;
+        }
+        capture->count = 0;
+        capture->dropped = 0;
+        WRITE_ONCE(capture->enabled, 1);
+        mutex_unlock(&capture->lock);
+
+        return 0;
+}
+
+// The recorded transactions stay available until the next start.
+void vc_core_stop_capture(struct vc_cam *cam)
+{
+        struct vc_capture *capture = &cam->capture;
+
+        mutex_lock(&capture->lock);
+        WRITE_ONCE(capture->enabled, 0);
+        mutex_unlock(&capture->lock);
+}
+
+void vc_core_free_capture(struct vc_cam *cam)
+{
+        struct vc_capture *capture = &cam->capture;
+
+        mutex_lock(&capture->lock);
+        WRITE_ONCE(capture->enabled, 0);
+        vfree(capture->entries);
+        capture->entries = NULL;
+        capture->count = 0;
+        mutex_unlock(&capture->lock);
+}
+
+static void vc_capture_record(struct vc_ctrl *ctrl, struct i2c_client *client, __u16 addr, __u8 value,
+        __u8 flags, int ret, __u64 start, __u64 duration)
+{
+        struct vc_cam *cam;
+        struct vc_capture *capture;
+        struct vc_capture_entry *entry;
+
+        if (ctrl == NULL)
+                return;
+
+        cam = container_of(ctrl, struct vc_cam, ctrl);
+        capture = &cam->capture;
+        if (!READ_ONCE(capture->enabled))
+                return;
+
+        mutex_lock(&capture->lock);
+        if (capture->enabled && capture->count < VC_CAPTURE_SIZE) {
+                entry = &capture->entries[capture->count++];
+                entry->timestamp = start;
+                entry->duration_ns = (__u32)min_t(__u64, duration, U32_MAX);
+                entry->addr = addr;
+                entry->client = client->addr;
+                entry->value = value;
+                entry->ret = ret;
+                entry->op = cam->stats.op;
+                entry->flags = flags;
+        } else if (capture->enabled) {
+                capture->dropped++;
+        }
+        mutex_unlock(&capture->lock);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+//  Helper Functions for the Stream On/Off Latency Breakdown
+
+static const char * const vc_phase_names[VC_PHASE_NUM] = {
+        [VC_PHASE_STOP_STREAM]          = "stop_stream",
+        [VC_PHASE_SET_MODE]             = "set_mode",
+        [VC_PHASE_SET_ROI]              = "set_roi",
+        [VC_PHASE_SET_EXPOSURE]         = "set_exposure",
+        [VC_PHASE_SET_GAIN]             = "set_gain",
+        [VC_PHASE_SET_BLACKLEVEL]       = "set_blacklevel",
+        [VC_PHASE_START_STREAM]         = "start_stream",
+};
+
+const char *vc_core_get_phase_name(enum vc_phase phase)
+{
+        return phase < VC_PHASE_NUM ? vc_phase_names[phase] : "unknown";
+}
+
+// The event is stored in the log ring buffer, but counts only after vc_core_end_stream_event().
+struct vc_stream_event *vc_core_begin_stream_event(struct vc_cam *cam, int enable)
+{
+        struct vc_stream_log *log = &cam->stream_log;
+        struct vc_stream_event *event = &log->events[log->count % VC_STREAM_LOG_SIZE];
+
+        memset(event, 0, sizeof(*event));
+        event->enable = enable;
+        event->timestamp = ktime_get_ns();
+        event->last = event->timestamp;
+
+        return event;
+}
+
+// Assigns the time since the previous phase (or the begin of the event) to the given phase.
+void vc_core_mark_stream_phase(struct vc_stream_event *event, enum vc_phase phase)
+{
+        __u64 now = ktime_get_ns();
+
+        event->phase_ns[phase] += (__u32)min_t(__u64, now - event->last, U32_MAX);
+        event->last = now;
+}
+
+void vc_core_end_stream_event(struct vc_cam *cam, struct vc_stream_event *event, int reset, int ret)
+{
+        event->total_ns = ktime_get_ns() - event->timestamp;
+        event->reset = reset;
+        event->ret = ret;
+        cam->stream_log.count++;
+}
+
+
 // ------------------------------------------------------------------------------------------------
 //  Helper Functions for I2C Communication
 
@@ -76,44 +286,144 @@ static __u32 vc_sen_read_vmax(struct vc_ctrl *ctrl);
 #define M_BYTE(value) (__u8)((value >>  8) & 0xff)
 #define L_BYTE(value) (__u8)((value >>  0) & 0xff)
 
-static __u8 i2c_read_reg(struct device *dev, struct i2c_client *client, const __u16 addr, const char* func)
+// NAKs of the address or a data byte, lost arbitration and bus timeouts may be caused by
+// interference on long cables and are worth repeating.
+static int vc_i2c_is_transient(int ret)
+{
+        return ret == -ENXIO || ret == -EREMOTEIO || ret == -EIO || ret == -EAGAIN || ret == -ETIMEDOUT;
+}
+
+static int vc_i2c_inject_fault(struct vc_ctrl *ctrl)
+{
+        struct vc_cam *cam;
+        struct vc_i2c_policy *policy;
+        __u32 dice;
+
+        if (ctrl == NULL)
+                return 0;
+
+        cam = container_of(ctrl, struct vc_cam, ctrl);
+        policy = &cam->i2c;
+        if (policy->fault_nak == 0 && policy->fault_timeout == 0)
+                return 0;
+
+        dice = get_random_u32() % 1000;
+        if (dice < policy->fault_nak) {
+                cam->stats.injected++;
+                return -ENXIO;
+        }
+        if (dice < policy->fault_nak + policy->fault_timeout) {
+                cam->stats.injected++;
+                fsleep(policy->fault_timeout_us);
+                return -ETIMEDOUT;
+        }
+
+        return 0;
+}
+
+// Returns 0 or a negative error code (i2c_transfer() returns the number of transferred messages).
+static int vc_i2c_transfer(struct vc_ctrl *ctrl, struct i2c_client *client, struct i2c_msg *msgs, int num)
 {
-        __u8 buf[2] = { addr >> 8, addr & 0xff };
         int ret;
+
+        ret = vc_i2c_inject_fault(ctrl);
+        if (ret)
+                return ret;
+
+        ret = i2c_transfer(client->adapter, msgs, num);
+        if (ret < 0)
+                return ret;
+
+        return ret == num ? 0 : -EIO;
+}
+
+// Counts the result of a transfer attempt and decides whether to repeat it. Waits for the backoff
+// time before a retry. Transactions without camera context are not repeated.
+static int vc_i2c_retry(struct vc_ctrl *ctrl, int ret, int attempt)
+{
+        struct vc_cam *cam;
+        struct vc_stats *stats;
+
+        if (ctrl == NULL)
+                return 0;
+
+        cam = container_of(ctrl, struct vc_cam, ctrl);
+        stats = &cam->stats;
+        if (ret == 0) {
+                if (attempt > 0)
+                        stats->recovered++;
+                return 0;
+        }
+
+        if (ret == -ENXIO || ret == -EREMOTEIO)
+                stats->naks++;
+        else if (ret == -ETIMEDOUT)
+                stats->timeouts++;
+        else
+                stats->other_errors++;
+
+        if (!vc_i2c_is_transient(ret) || attempt >= cam->i2c.retries) {
+                stats->failed++;
+                return 0;
+        }
+
+        stats->ops[stats->op].retries++;
+        if (cam->i2c.retry_delay_us)
+                fsleep(cam->i2c.retry_delay_us << min(attempt, 10));
+
+        return 1;
+}
+
+// Returns the register value or a negative error code.
+static int i2c_read_reg(struct vc_ctrl *ctrl, struct i2c_client *client, const __u16 addr, const char* func)
+{
+        __u8 tx[2] = { addr >> 8, addr & 0xff };
+        __u8 rx[1] = { 0 };
+        __u64 start, duration;
+        int ret, attempt = 0;
         struct i2c_msg msgs[] = {
                 {
                         .addr = client->addr,
                         .flags = 0,
                         .len = 2,
-                        .buf = buf,
+                        .buf = tx,
                 },
                 {
                         .addr = client->addr,
                         .flags = I2C_M_RD,
                         .len = 1,
-                        .buf = buf,
+                        .buf = rx,
                 },
         };
 
-        ret = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
-        if (ret < 0) {
-                vc_err(&client->dev, "%s(): Reading register 0x%04x from 0x%02x failed\n", func, addr, client->addr);
+        do {
+                start = ktime_get_ns();
+                ret = vc_i2c_transfer(ctrl, client, msgs, ARRAY_SIZE(msgs));
+                duration = ktime_get_ns() - start;
+                trace_vc_reg_read(client->addr, addr, rx[0], ret, duration);
+                vc_stats_account(ctrl, 3, ret);
+                vc_capture_record(ctrl, client, addr, rx[0], VC_CAPTURE_READ, ret, start, duration);
+        } while (vc_i2c_retry(ctrl, ret, attempt++));
+
+        if (ret) {
+                vc_err(&client->dev, "%s(): Reading register 0x%04x from 0x%02x failed (error: %d)\n", func,
+                        addr, client->addr, ret);
                 return ret;
         }
 
-        vc_dbg(dev, "%s():   addr: 0x%04x => value: 0x%02x\n", func, addr, buf[0]);
+        vc_dbg(&client->dev, "%s():   addr: 0x%04x => value: 0x%02x\n", func, addr, rx[0]);
 
-        return buf[0];
+        return rx[0];
 }
 
-static int i2c_write_reg(struct device *dev, struct i2c_client *client, const __u16 addr, const __u8 value, const char* func)
+static int i2c_write_reg(struct vc_ctrl *ctrl, struct i2c_client *client, const __u16 addr, const __u8 value, const char* func)
 {
-        struct i2c_adapter *adap = client->adapter;
         struct i2c_msg msg;
         __u8 tx[3];
-        int ret;
+        __u64 start, duration;
+        int ret, attempt = 0;
 
-        vc_dbg(dev, "%s():   addr: 0x%04x <= value: 0x%02x\n", func, addr, value);
+        vc_dbg(&client->dev, "%s():   addr: 0x%04x <= value: 0x%02x\n", func, addr, value);
 
         msg.addr = client->addr;
         msg.buf = tx;
@@ -122,192 +432,100 @@ static int i2c_write_reg(struct device *dev, struct i2c_client *client, const __
         tx[0] = addr >> 8;
         tx[1] = addr & 0xff;
         tx[2] = value;
-        ret = i2c_transfer(adap, &msg, 1);
 
-        return ret == 1 ? 0 : -EIO;
+        do {
+                start = ktime_get_ns();
+                ret = vc_i2c_transfer(ctrl, client, &msg, 1);
+                duration = ktime_get_ns() - start;
+                trace_vc_reg_write(client->addr, addr, value, ret, duration);
+                vc_stats_account(ctrl, 3, ret);
+                vc_capture_record(ctrl, client, addr, value, 0, ret, start, duration);
+        } while (vc_i2c_retry(ctrl, ret, attempt++));
+
+        if (ret)
+                vc_err(&client->dev, "%s(): Writing register 0x%04x to 0x%02x failed (error: %d)\n", func,
+                        addr, client->addr, ret);
+
+        return ret;
 }
 
-static __u32 i2c_read_reg2(struct device *dev, struct i2c_client *client, struct vc_csr2 *csr, const char* func)
+static int i2c_read_reg2(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr2 *csr, __u32 *value, const char* func)
 {
-        __u32 reg = 0;
-        __u32 value = 0;
+        int reg;
 
-        reg = i2c_read_reg(dev, client, csr->l, func);
-        if (reg)
-                value |= (0x000000ff & reg);
-        reg = i2c_read_reg(dev, client, csr->m, func);
-        if (reg)
-                value |= (0x000000ff & reg) <<  8;
+        *value = 0;
+        reg = i2c_read_reg(ctrl, client, csr->l, func);
+        if (reg < 0)
+                return reg;
+        *value |= reg;
+        reg = i2c_read_reg(ctrl, client, csr->m, func);
+        if (reg < 0)
+                return reg;
+        *value |= reg << 8;
 
-        return value;
+        return 0;
 }
 
-static int i2c_write_reg2(struct device *dev, struct i2c_client *client, struct vc_csr2 *csr, const __u16 value, const char* func)
+static int i2c_write_reg2(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr2 *csr, const __u16 value, const char* func)
 {
         int ret = 0;
 
         if (csr->l)
-                ret  = i2c_write_reg(dev, client, csr->l, L_BYTE(value), func);
-        if (csr->m)
-                ret |= i2c_write_reg(dev, client, csr->m, M_BYTE(value), func);
+                ret = i2c_write_reg(ctrl, client, csr->l, L_BYTE(value), func);
+        if (csr->m && !ret)
+                ret = i2c_write_reg(ctrl, client, csr->m, M_BYTE(value), func);
 
         return ret;
 }
 
 #ifdef READ_VMAX
-static __u32 i2c_read_reg4(struct device *dev, struct i2c_client *client, struct vc_csr4 *csr, const char* func)
-{
-        __u32 reg = 0;
-        __u32 value = 0;
-
-        reg = i2c_read_reg(dev, client, csr->l, func);
-        if (reg)
-                value |= (0x000000ff & reg);
-        reg = i2c_read_reg(dev, client, csr->m, func);
-        if (reg)
-                value |= (0x000000ff & reg) <<  8;
-        reg = i2c_read_reg(dev, client, csr->h, func);
-        if (reg)
-                value |= (0x000000ff & reg) << 16;
-        reg = i2c_read_reg(dev, client, csr->u, func);
-        if (reg)
-                value |= (0x000000ff & reg) << 24;
-
-        return value;
+static int i2c_read_reg4(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr4 *csr, __u32 *value, const char* func)
+{
+        __u16 addrs[4] = { csr->l, csr->m, csr->h, csr->u };
+        int index, reg;
+
+        *value = 0;
+        for (index = 0; index < 4; index++) {
+                reg = i2c_read_reg(ctrl, client, addrs[index], func);
+                if (reg < 0)
+                        return reg;
+                *value |= (__u32)reg << (8 * index);
+        }
+
+        return 0;
 }
 #endif
 
-static int i2c_write_reg4(struct device *dev, struct i2c_client *client, struct vc_csr4 *csr, const __u32 value, const char *func)
+static int i2c_write_reg4(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr4 *csr, const __u32 value, const char *func)
 {
         int ret = 0;
 
         if (csr->l)
-                ret = i2c_write_reg(dev, client, csr->l, L_BYTE(value), func);
-        if (csr->m)
-                ret |= i2c_write_reg(dev, client, csr->m, M_BYTE(value), func);
-        if (csr->h)
-                ret |= i2c_write_reg(dev, client, csr->h, H_BYTE(value), func);
-        if (csr->u)
-                ret |= i2c_write_reg(dev, client, csr->u, U_BYTE(value), func);
+                ret = i2c_write_reg(ctrl, client, csr->l, L_BYTE(value), func);
+        if (csr->m && !ret)
+                ret = i2c_write_reg(ctrl, client, csr->m, M_BYTE(value), func);
+        if (csr->h && !ret)
+                ret = i2c_write_reg(ctrl, client, csr->h, H_BYTE(value), func);
+        if (csr->u && !ret)
+                ret = i2c_write_reg(ctrl, client, csr->u, U_BYTE(value), func);
 
         return ret;
 }
 
 int vc_read_i2c_reg(struct i2c_client *client, const __u16 addr)
 {
-        return i2c_read_reg(&client->dev, client, addr, __FUNCTION__);
+        return i2c_read_reg(NULL, client, addr, __FUNCTION__);
 }
 
 int vc_write_i2c_reg(struct i2c_client *client, const __u16 addr, const __u8 value)
 {
-        return i2c_write_reg(&client->dev, client, addr, value, __FUNCTION__);
+        return i2c_write_reg(NULL, client, addr, value, __FUNCTION__);
 }
 
 
 // ------------------------------------------------------------------------------------------------
 //  Helper Functions for debugging
 
-static void vc_core_print_desc(struct device *dev, struct vc_desc *desc)
-{
-        int is_color = vc_mod_is_color_sensor(desc);
-
-        vc_notice(dev, "+--- VC MIPI Camera -----------------------------------+\n");
-        vc_notice(dev, "| MANUF. | %s               MID: 0x%04x |\n", desc->manuf, desc->manuf_id);
-        vc_notice(dev, "| MODULE | ID:  0x%04x                     REV:   %04u |\n", desc->mod_id, desc->mod_rev);
-        vc_notice(dev, "| SENSOR | %s%s %s%s                                |\n", desc->sen_manuf, (0 == strcmp("OM", desc->sen_manuf)) ? "  ":"", desc->sen_type, is_color ? "" : " ");
-        vc_notice(dev, "+--------+---------------------------------------------+\n");
-}
-
-static void vc_core_print_csr(struct device *dev, struct vc_desc *desc)
-{
-        vc_notice(dev, "+--- Sensor Registers ------+--------+--------+--------+\n");
-        vc_notice(dev, "|                           | low    | mid    | high   |\n");
-        vc_notice(dev, "+---------------------------+--------+--------+--------+\n");
-        vc_notice(dev, "| idle                      | 0x%04x |        |        |\n", desc->csr_mode);
-        vc_notice(dev, "| horizontal start          | 0x%04x | 0x%04x |        |\n", desc->csr_h_start_l, desc->csr_h_start_h);
-        vc_notice(dev, "| vertical start            | 0x%04x | 0x%04x |        |\n", desc->csr_v_start_l, desc->csr_v_start_h);
-        vc_notice(dev, "| horizontal end            | 0x%04x | 0x%04x |        |\n", desc->csr_h_end_l, desc->csr_h_end_h);
-        vc_notice(dev, "| vertical end              | 0x%04x | 0x%04x |        |\n", desc->csr_v_end_l, desc->csr_v_end_h);
-        vc_notice(dev, "| hor. output width         | 0x%04x | 0x%04x |        |\n", desc->csr_o_width_l, desc->csr_o_width_h);
-        vc_notice(dev, "| ver. output height        | 0x%04x | 0x%04x |        |\n", desc->csr_o_height_l, desc->csr_o_height_h);
-        vc_notice(dev, "| exposure                  | 0x%04x | 0x%04x | 0x%04x |\n", desc->csr_exposure_l, desc->csr_exposure_m, desc->csr_exposure_h);
-        vc_notice(dev, "| gain                      | 0x%04x | 0x%04x |        |\n", desc->csr_gain_l, desc->csr_gain_h);
-        vc_notice(dev, "+---------------------------+--------+--------+--------+\n");
-        vc_notice(dev, "| clock for ext. trigger    | %8u Hz              |\n", desc->clk_ext_trigger);
-        vc_notice(dev, "| pixel clock               | %8u Hz              |\n", desc->clk_pixel);
-        vc_notice(dev, "| shutter offset            | %8u us              |\n", desc->shutter_offset);
-        vc_notice(dev, "+---------------------------+--------------------------+\n");
-}
-
-static void vc_core_print_format(__u8 format, char *buf)
-{
-        switch (format) {
-        case FORMAT_RAW08: strcpy(buf, "RAW08"); break;
-        case FORMAT_RAW10: strcpy(buf, "RAW10"); break;
-        case FORMAT_RAW12: strcpy(buf, "RAW12"); break;
-        case FORMAT_RAW14: strcpy(buf, "RAW14"); break;
-        default: sprintf(buf, "0x%02x ", format); break;
-        }
-}
-
-static void vc_core_print_modes(struct device *dev, struct vc_desc *desc)
-{
-        struct vc_desc_mode *mode;
-        __u32 data_rate = 0;
-        char format[16], type[16];
-        int index = 0;
-
-        vc_notice(dev, "+--- Module Modes -------+---------+---------+---------+\n");
-        vc_notice(dev, "|  # | rate    | lanes   | format  | type    | binning |\n");
-        vc_notice(dev, "+----+---------+---------+---------+---------+---------+\n");
-        for (index = 0; index<desc->num_modes; index++) {
-                mode = &desc->modes[index];
-                data_rate = (*(__u32*)mode->data_rate)/1000000;
-                vc_core_print_format(mode->format, format);
-                switch (mode->type) {
-                case MODE_TYPE_STREAM:  strcpy(type, "STREAM "); break;
-                case MODE_TYPE_TRIGGER: strcpy(type, "EXT.TRG"); break;
-                case MODE_TYPE_SLAVE:   strcpy(type, "SLAVE  "); break;
-                default: sprintf(type, "0x%02x   ", mode->type); break;
-                }
-                vc_notice(dev, "| %2d |    %4u |       %u | %s   | %s |       %u |\n",
-                        index, data_rate, mode->num_lanes, format, type, mode->binning);
-        }
-        vc_notice(dev, "+----+---------+---------+---------+---------+---------+\n");
-}
-
-static void vc_core_print_mode(struct vc_cam *cam)
-{
-        struct vc_ctrl *ctrl = &cam->ctrl;
-        struct device *dev = vc_core_get_mod_device(cam);
-        char sformat[16];
-        int index = 0;
-
-        if (ctrl->flags & FLAG_INCREASE_FRAME_RATE) {
-                vc_notice(dev, "+-------+--------+------------+-----------+\n");
-                vc_notice(dev, "| lanes | format | exposure   | framerate |\n");
-                vc_notice(dev, "|       |        | max [us]   | max [mHz] |\n");
-                vc_notice(dev, "+-------+--------+------------+-----------+\n");
-                while (index < 8 && ctrl->mode[index].num_lanes != 0) {
-                        __u8 num_lanes = ctrl->mode[index].num_lanes;
-                        __u8 format = ctrl->mode[index].format;
-                        __u32 max_exposure = vc_core_calculate_max_exposure(cam, num_lanes, format);
-                        __u32 max_frame_rate = vc_core_calculate_max_frame_rate(cam, num_lanes, format);
-
-                        vc_core_print_format(format, sformat);
-                        vc_notice(dev, "|     %1d | %s  | %10d | %9d |\n",
-                                num_lanes, sformat, max_exposure, max_frame_rate);
-                        index++;
-                }
-                vc_notice(dev, "+-------+--------+------------+-----------+\n");
-        }
-}
-
-void vc_core_print_debug(struct vc_cam *cam)
-{
-        vc_core_print_mode(cam);
-}
-
 // ------------------------------------------------------------------------------------------------
 //  Helper functions for internal data structures
 
@@ -364,7 +582,7 @@ static __u8 vc_core_v4l2_code_to_format(__u32 code)
         return 0;
 }
 
-static __u32 vc_core_format_to_v4l2_code(__u8 format, int is_color, int is_gbrg)
+__u32 vc_core_format_to_v4l2_code(__u8 format, int is_color, int is_gbrg)
 {
         switch (format) {
         case FORMAT_RAW08:
@@ -389,16 +607,72 @@ static __u32 vc_core_get_default_format(struct vc_cam *cam)
         return vc_core_format_to_v4l2_code(format, is_color, is_bgrg);
 }
 
+int vc_core_get_sensor_name(struct vc_cam *cam, char *buf, size_t size)
+{
+        struct vc_desc *desc = &cam->desc;
+        __u32 len = strnlen(desc->sen_type, sizeof(desc->sen_type));
+        __u32 index;
+
+        // The color variant is marked by a trailing 'C' (e.g. IMX296C). It uses the same sensor name.
+        if (vc_mod_is_color_sensor(desc))
+                len--;
+        if (len >= size)
+                len = size - 1;
+
+        for (index = 0; index < len; index++)
+                buf[index] = tolower(desc->sen_type[index]);
+        buf[len] = '\0';
+
+        return len;
+}
+
+int vc_core_enum_format(struct vc_cam *cam, __u32 index, __u32 *code)
+{
+        struct vc_desc *desc = &cam->desc;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        int is_color = vc_mod_is_color_sensor(desc);
+        int is_gbrg = ctrl->flags & FLAG_FORMAT_GBRG;
+        __u32 count = 0;
+        int i, j;
+
+        for (i = 0; i < desc->num_modes; i++) {
+                __u8 format = desc->modes[i].format;
+
+                // Skip formats listed by a previous mode.
+                for (j = 0; j < i; j++) {
+                        if (desc->modes[j].format == format)
+                                break;
+                }
+                if (j < i)
+                        continue;
+
+                if (count == index) {
+                        *code = vc_core_format_to_v4l2_code(format, is_color, is_gbrg);
+                        return 0;
+                }
+                count++;
+        }
+
+        return -EINVAL;
+}
+
 int vc_core_try_format(struct vc_cam *cam, __u32 code)
 {
         struct vc_desc *desc = &cam->desc;
+        struct vc_ctrl *ctrl = &cam->ctrl;
         struct device *dev = vc_core_get_sen_device(cam);
         __u8 format = vc_core_v4l2_code_to_format(code);
+        int is_color = vc_mod_is_color_sensor(desc);
+        int is_gbrg = ctrl->flags & FLAG_FORMAT_GBRG;
         char fourcc[5];
         int index;
 
         vc_core_get_v4l2_fmt(code, fourcc);
-        vc_info(dev, "%s(): Try format 0x%04x (%s, format: 0x%02x)\n", __FUNCTION__, code, fourcc, format);
+        vc_dbg(dev, "%s(): Try format 0x%04x (%s, format: 0x%02x)\n", __FUNCTION__, code, fourcc, format);
+
+        // Only the code matching the sensors color filter array is valid.
+        if (code != vc_core_format_to_v4l2_code(format, is_color, is_gbrg))
+                return -EINVAL;
 
         for (index = 0; index < desc->num_modes; index++) {
                 struct vc_desc_mode *mode = &desc->modes[index];
@@ -418,7 +692,8 @@ int vc_core_set_format(struct vc_cam *cam, __u32 code)
         char fourcc[5];
 
         vc_core_get_v4l2_fmt(code, fourcc);
-        vc_notice(dev, "%s(): Set format 0x%04x (%s)\n", __FUNCTION__, code, fourcc);
+        vc_dbg(dev, "%s(): Set format 0x%04x (%s)\n", __FUNCTION__, code, fourcc);
+        vc_core_unprepare_stream(cam);
 
         if (vc_core_try_format(cam, code)) {
                 state->format_code = vc_core_get_default_format(cam);
@@ -441,7 +716,7 @@ __u32 vc_core_get_format(struct vc_cam *cam)
         char fourcc[5];
 
         vc_core_get_v4l2_fmt(code, fourcc);
-        vc_info(dev, "%s(): Get format 0x%04x (%s)\n", __FUNCTION__, code, fourcc);
+        vc_dbg(dev, "%s(): Get format 0x%04x (%s)\n", __FUNCTION__, code, fourcc);
 
         return code;
 }
@@ -452,7 +727,8 @@ int vc_core_set_frame(struct vc_cam *cam, __u32 left, __u32 top, __u32 width, __
         struct vc_state *state = &cam->state;
         struct device *dev = vc_core_get_sen_device(cam);
 
-        vc_notice(dev, "%s(): Set frame (left: %u, top: %u, width: %u, height: %u)\n", __FUNCTION__, left, top, width, height);
+        vc_dbg(dev, "%s(): Set frame (left: %u, top: %u, width: %u, height: %u)\n", __FUNCTION__, left, top, width, height);
+        vc_core_unprepare_stream(cam);
 
         if (width > ctrl->frame.width) {
                 state->frame.width = ctrl->frame.width;
@@ -483,6 +759,9 @@ int vc_core_set_frame(struct vc_cam *cam, __u32 left, __u32 top, __u32 width, __
                 state->frame.left, state->frame.top, state->frame.width, state->frame.height);
         }
 
+        // The maximal frame rate depends on the image height.
+        vc_core_update_controls(cam);
+
         return 0;
 }
 
@@ -491,7 +770,7 @@ struct vc_frame *vc_core_get_frame(struct vc_cam *cam)
         struct vc_frame* frame = &cam->state.frame;
         struct device *dev = vc_core_get_sen_device(cam);
 
-        vc_info(dev, "%s(): Get frame (width: %u, height: %u)\n", __FUNCTION__, frame->width, frame->height);
+        vc_dbg(dev, "%s(): Get frame (width: %u, height: %u)\n", __FUNCTION__, frame->width, frame->height);
 
         return frame;
 }
@@ -508,6 +787,7 @@ int vc_core_set_num_lanes(struct vc_cam *cam, __u32 number)
                 if (mode->num_lanes == number) {
                         vc_info(dev, "%s(): Set number of lanes %u\n", __FUNCTION__, number);
                         state->num_lanes = number;
+                        vc_core_unprepare_stream(cam);
                         vc_core_update_controls(cam);
                         return 0;
                 }
@@ -522,7 +802,7 @@ __u32 vc_core_get_num_lanes(struct vc_cam *cam)
         struct vc_state *state = &cam->state;
         struct device *dev = vc_core_get_sen_device(cam);
 
-        vc_info(dev, "%s(): Get number of lanes: %u\n", __FUNCTION__, state->num_lanes);
+        vc_dbg(dev, "%s(): Get number of lanes: %u\n", __FUNCTION__, state->num_lanes);
         return state->num_lanes;
 }
 
@@ -532,7 +812,7 @@ int vc_core_set_framerate(struct vc_cam *cam, __u32 framerate)
         struct vc_state *state = &cam->state;
         struct device *dev = vc_core_get_sen_device(cam);
 
-        vc_notice(dev, "%s(): Set framerate %u mHz\n", __FUNCTION__, framerate);
+        vc_dbg(dev, "%s(): Set framerate %u mHz\n", __FUNCTION__, framerate);
 
         if (framerate < ctrl->framerate.min) {
                 framerate = ctrl->framerate.min;
@@ -545,6 +825,48 @@ int vc_core_set_framerate(struct vc_cam *cam, __u32 framerate)
         return vc_sen_set_exposure(cam, cam->state.exposure);
 }
 
+int vc_core_set_vblank(struct vc_cam *cam, __u32 vblank)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        struct device *dev = vc_core_get_sen_device(cam);
+
+        vc_dbg(dev, "%s(): Set vertical blanking %u lines\n", __FUNCTION__, vblank);
+
+        if (vblank < ctrl->vblank.min) {
+                vblank = ctrl->vblank.min;
+        }
+        if (vblank > ctrl->vblank.max) {
+                vblank = ctrl->vblank.max;
+        }
+        state->vblank = vblank;
+
+        return vc_sen_set_exposure(cam, cam->state.exposure);
+}
+
+int vc_core_set_exposure_lines(struct vc_cam *cam, __u32 lines)
+{
+        struct vc_state *state = &cam->state;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        __u32 period_1H_ns = vc_core_calculate_period_1H(cam, state->num_lanes, format);
+
+        // Round up, so that the exposure calculation results in the requested number of lines.
+        return vc_sen_set_exposure(cam, DIV_ROUND_UP_ULL((__u64)lines * period_1H_ns, 1000));
+}
+
+// Returns the exposure in lines (V4L2_CID_VC_EXPOSURE_LINES) for the exposure in µs.
+__u32 vc_core_get_exposure_lines(struct vc_cam *cam)
+{
+        struct vc_state *state = &cam->state;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        __u32 period_1H_ns = vc_core_calculate_period_1H(cam, state->num_lanes, format);
+
+        if (period_1H_ns == 0) {
+                return 0;
+        }
+        return ((__u64)state->exposure * 1000) / period_1H_ns;
+}
+
 __u32 vc_core_get_framerate(struct vc_cam *cam)
 {
         struct vc_ctrl *ctrl = &cam->ctrl;
@@ -558,7 +880,7 @@ __u32 vc_core_get_framerate(struct vc_cam *cam)
                 framerate = ctrl->framerate.max;
         }
 
-        vc_info(dev, "%s(): Get framerate %u mHz\n", __FUNCTION__, framerate);
+        vc_dbg(dev, "%s(): Get framerate %u mHz\n", __FUNCTION__, framerate);
         return framerate;
 }
 
@@ -627,6 +949,113 @@ __u32 vc_core_calculate_max_frame_rate(struct vc_cam *cam, __u8 num_lanes, __u8
         return 1000000000 / (((__u64)period_1H_ns * vmax) / 1000);
 }
 
+// Returns the vertical blanking in lines and the frame rate in mHz of the sensor timing (VMAX) of the
+// last exposure calculation. Both are 0 in the trigger modes, which have no frame length of their own.
+void vc_core_get_frame_timing(struct vc_cam *cam, __u32 *vblank, __u32 *framerate)
+{
+        struct vc_state *state = &cam->state;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        __u32 period_1H_ns = vc_core_calculate_period_1H(cam, state->num_lanes, format);
+        __u64 frametime_us = ((__u64)period_1H_ns * state->vmax) / 1000;
+
+        *vblank = 0;
+        *framerate = 0;
+        if (frametime_us == 0) {
+                return;
+        }
+
+        *vblank = (state->vmax > state->frame.height) ? state->vmax - state->frame.height : 0;
+        *framerate = 1000000000 / frametime_us;
+}
+
+// Minimum time between two single triggers in µs: the retrigger time of the mode, at least the
+// exposure time plus the readout of a frame.
+__u32 vc_core_calculate_min_trigger_period(struct vc_cam *cam)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        __u32 retrigger_min = vc_core_get_retrigger(cam, state->num_lanes, format);
+        __u32 frame_rate = vc_core_calculate_max_frame_rate(cam, state->num_lanes, format);
+        __u32 retrigger_us = 0;
+        __u32 frame_us = 0;
+
+        if (ctrl->clk_ext_trigger) {
+                retrigger_us = ((__u64)retrigger_min * 1000000) / ctrl->clk_ext_trigger;
+        }
+        if (frame_rate) {
+                frame_us = 1000000000 / frame_rate;
+        }
+
+        return max(retrigger_us, state->exposure + frame_us);
+}
+
+
+__u8 vc_core_get_bits_per_pixel(__u8 format)
+{
+        switch (format) {
+        case FORMAT_RAW08: return 8;
+        case FORMAT_RAW10: return 10;
+        case FORMAT_RAW12: return 12;
+        case FORMAT_RAW14: return 14;
+        }
+        return 0;
+}
+
+static __u32 vc_core_get_data_rate(struct vc_desc_mode *mode)
+{
+        return *(__u32*)mode->data_rate;
+}
+
+__u64 vc_core_get_mode_link_freq(struct vc_desc_mode *mode)
+{
+        // The data rate of a lane is twice the link frequency (DDR).
+        return vc_core_get_data_rate(mode) / 2;
+}
+
+static void vc_core_update_timing(struct vc_cam *cam)
+{
+        struct vc_desc *desc = &cam->desc;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        struct device *dev = vc_core_get_sen_device(cam);
+        __u8 num_lanes = state->num_lanes;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        __u8 bpp = vc_core_get_bits_per_pixel(format);
+        __u8 index = vc_mod_find_mode(cam, num_lanes, format, vc_mod_get_mode_type(cam), 0);
+        __u32 period_1H_ns = vc_core_calculate_period_1H(cam, num_lanes, format);
+        __u32 vmax_max = vc_core_get_vmax(cam, num_lanes, format).max;
+        __u32 vmax = vc_core_get_optimized_vmax(cam);
+        __u32 height = state->frame.height;
+        __u64 line_length;
+
+        if (period_1H_ns == 0 || bpp == 0) {
+                vc_err(dev, "%s(): Unable to calculate sensor timing (lanes: %u, format: 0x%02x)\n", __FUNCTION__,
+                        num_lanes, format);
+                return;
+        }
+
+        ctrl->link_freq = vc_core_get_mode_link_freq(&desc->modes[index]);
+        ctrl->pixel_rate = ((__u64)vc_core_get_data_rate(&desc->modes[index]) * num_lanes) / bpp;
+
+        // Line length in pixel at the pixel rate: width + hblank = 1H period * pixel rate
+        line_length = ((__u64)period_1H_ns * ctrl->pixel_rate) / 1000000000;
+        ctrl->hblank.min = (line_length > state->frame.width) ? line_length - state->frame.width : 0;
+        ctrl->hblank.max = ctrl->hblank.min;
+        ctrl->hblank.def = ctrl->hblank.min;
+
+        // Frame length in lines: height + vblank = VMAX
+        ctrl->vblank.min = (vmax > height) ? vmax - height : 0;
+        ctrl->vblank.max = (vmax_max > height) ? vmax_max - height : ctrl->vblank.min;
+        ctrl->vblank.def = ctrl->vblank.min;
+
+        ctrl->exposure_lines.min = max_t(__u64, 1, ((__u64)ctrl->exposure.min * 1000) / period_1H_ns);
+        ctrl->exposure_lines.max = ((__u64)ctrl->exposure.max * 1000) / period_1H_ns;
+        ctrl->exposure_lines.def = ((__u64)ctrl->exposure.def * 1000) / period_1H_ns;
+
+        vc_dbg(dev, "%s(): link_freq: %llu Hz, pixel_rate: %llu Hz, hblank: %u, vblank: %u-%u\n", __FUNCTION__,
+                ctrl->link_freq, ctrl->pixel_rate, ctrl->hblank.def, ctrl->vblank.min, ctrl->vblank.max);
+}
 
 vc_mode vc_core_get_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format)
 {
@@ -635,7 +1064,7 @@ vc_mode vc_core_get_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format)
         int index = 0;
         vc_mode tRet;
 
-        for (index = 0; index < 8; index++) {
+        for (index = 0; index < VC_MAX_MODES; index++) {
                 if ( (num_lanes == ctrl->mode[index].num_lanes)
                   && (format == ctrl->mode[index].format) ) {
                         return ctrl->mode[index];
@@ -718,9 +1147,9 @@ int vc_mod_set_power(struct vc_cam *cam, int on)
         struct device *dev = &client_mod->dev;
         int ret;
 
-        vc_info(dev, "%s(): Set module power: %s\n", __FUNCTION__, on ? "up" : "down");
+        vc_dbg(dev, "%s(): Set module power: %s\n", __FUNCTION__, on ? "up" : "down");
 
-        ret = i2c_write_reg(dev, client_mod, MOD_REG_RESET, on ? REG_RESET_PWR_UP : REG_RESET_PWR_DOWN, __FUNCTION__);
+        ret = i2c_write_reg(ctrl, client_mod, MOD_REG_RESET, on ? REG_RESET_PWR_UP : REG_RESET_PWR_DOWN, __FUNCTION__);
         if (ret) {
                 vc_err(dev, "%s(): Unable to power %s the module (error: %d)\n", __FUNCTION__,
                         (on == REG_RESET_PWR_UP) ? "up" : "down", ret);
@@ -732,12 +1161,13 @@ int vc_mod_set_power(struct vc_cam *cam, int on)
         return 0;
 }
 
-static int vc_mod_read_status(struct i2c_client *client)
+static int vc_mod_read_status(struct vc_ctrl *ctrl)
 {
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int ret;
 
-        ret = i2c_read_reg(dev, client, MOD_REG_STATUS, __FUNCTION__);
+        ret = i2c_read_reg(ctrl, client, MOD_REG_STATUS, __FUNCTION__);
         if (ret < 0)
                 vc_err(dev, "%s(): Unable to get module status (error: %d)\n", __FUNCTION__, ret);
         else
@@ -746,36 +1176,39 @@ static int vc_mod_read_status(struct i2c_client *client)
         return ret;
 }
 
-static int vc_mod_write_trigger_mode(struct i2c_client *client, int mode)
+static int vc_mod_write_trigger_mode(struct vc_ctrl *ctrl, int mode)
 {
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int ret;
 
         vc_dbg(dev, "%s(): Write trigger mode: 0x%02x\n", __FUNCTION__, mode);
 
-        ret = i2c_write_reg(dev, client, MOD_REG_EXTTRIG, mode, __FUNCTION__);
+        ret = i2c_write_reg(ctrl, client, MOD_REG_EXTTRIG, mode, __FUNCTION__);
         if (ret)
                 vc_err(dev, "%s(): Unable to write external trigger (error: %d)\n", __FUNCTION__, ret);
 
         return ret;
 }
 
-static int vc_mod_write_io_mode(struct i2c_client *client, int mode)
+static int vc_mod_write_io_mode(struct vc_ctrl *ctrl, int mode)
 {
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int ret;
 
         vc_dbg(dev, "%s(): Write IO mode: %s\n", __FUNCTION__, mode ? "ON" : "OFF");
 
-        ret = i2c_write_reg(dev, client, MOD_REG_IOCTRL, mode, __FUNCTION__);
+        ret = i2c_write_reg(ctrl, client, MOD_REG_IOCTRL, mode, __FUNCTION__);
         if (ret)
                 vc_err(dev, "%s(): Unable to write IO mode (error: %d)\n", __FUNCTION__, ret);
 
         return ret;
 }
 
-static int vc_mod_wait_until_module_is_ready(struct i2c_client *client)
+static int vc_mod_wait_until_module_is_ready(struct vc_ctrl *ctrl)
 {
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int status;
         int try;
@@ -784,11 +1217,14 @@ static int vc_mod_wait_until_module_is_ready(struct i2c_client *client)
 
         status = REG_STATUS_NO_COM;
         try = 0;
-        while (status == REG_STATUS_NO_COM && try < 10) {
+        // The controller may not respond while it boots.
+        while ((status == REG_STATUS_NO_COM || status < 0) && try < 10) {
                 usleep_range(200000, 200000);
-                status = vc_mod_read_status(client);
+                status = vc_mod_read_status(ctrl);
                 try++;
         }
+        if (status < 0)
+                return status;
         if (status == REG_STATUS_ERROR) {
                 vc_err(dev, "%s(): Internal Error!", __func__);
                 return -EIO;
@@ -798,6 +1234,61 @@ static int vc_mod_wait_until_module_is_ready(struct i2c_client *client)
         return 0;
 }
 
+// Serialises the probes of all modules, only one module may answer at the default addresses.
+static DEFINE_MUTEX(vc_mod_addr_lock);
+
+// Releases the module from reset and moves it from the default addresses to the target addresses
+// of the firmware node: the module controller to mod_i2c_addr_target, the sensor to the address of
+// the sensor client. This way several modules share one I2C segment. Every other module on the
+// segment has to be held in reset by its reset GPIO until it is probed itself. Returns the address
+// of the module controller.
+static int vc_mod_assign_addr(struct vc_ctrl *ctrl)
+{
+        struct i2c_client *client_sen = ctrl->client_sen;
+        struct device *dev = &client_sen->dev;
+        __u8 mod_addr = ctrl->mod_i2c_addr_target;
+        __u8 sen_addr = client_sen->addr;
+        struct i2c_client *client;
+        int ret;
+
+        mutex_lock(&vc_mod_addr_lock);
+
+        if (ctrl->reset_gpio) {
+                // The reset restores the default addresses of a module which was moved before.
+                gpiod_set_value_cansleep(ctrl->reset_gpio, 1);
+                usleep_range(10000, 11000);
+                gpiod_set_value_cansleep(ctrl->reset_gpio, 0);
+        }
+
+        if (mod_addr == 0 || mod_addr == MOD_DEFAULT_ADDR) {
+                mutex_unlock(&vc_mod_addr_lock);
+                return MOD_DEFAULT_ADDR;
+        }
+
+        client = vc_mod_get_client(dev, client_sen->adapter, MOD_DEFAULT_ADDR);
+        if (client == NULL) {
+                // Without reset GPIO the module may still be at the target from an earlier probe.
+                mutex_unlock(&vc_mod_addr_lock);
+                vc_notice(dev, "%s(): No module at 0x%02x, expecting it at 0x%02x\n", __FUNCTION__,
+                        MOD_DEFAULT_ADDR, mod_addr);
+                return mod_addr;
+        }
+
+        // The sensor first, the module controller answers at its new address after the write.
+        ret = i2c_write_reg(ctrl, client, MOD_REG_SEN_ADDR, sen_addr, __FUNCTION__);
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_MOD_ADDR, mod_addr, __FUNCTION__));
+        i2c_unregister_device(client);
+        mutex_unlock(&vc_mod_addr_lock);
+        if (ret) {
+                vc_err(dev, "%s(): Unable to move the module to 0x%02x / 0x%02x (error: %d)\n", __FUNCTION__,
+                        mod_addr, sen_addr, ret);
+                return ret;
+        }
+
+        vc_notice(dev, "%s(): Moved module to 0x%02x, sensor to 0x%02x\n", __FUNCTION__, mod_addr, sen_addr);
+        return mod_addr;
+}
+
 static int vc_mod_setup(struct vc_ctrl *ctrl, int mod_i2c_addr, struct vc_desc *desc)
 {
         struct i2c_client *client_sen = ctrl->client_sen;
@@ -822,18 +1313,15 @@ static int vc_mod_setup(struct vc_ctrl *ctrl, int mod_i2c_addr, struct vc_desc *
 
         dev_mod = &client_mod->dev;
         for (addr = 0; addr < sizeof(*desc); addr++) {
-                reg = i2c_read_reg(dev_mod, client_mod, addr + 0x1000, __FUNCTION__);
+                reg = i2c_read_reg(ctrl, client_mod, addr + 0x1000, __FUNCTION__);
                 if (reg < 0) {
                         i2c_unregister_device(client_mod);
-                        return -EIO;
+                        return reg;
                 }
                 *((char *)(desc) + addr) = (char)reg;
         }
 
         // TODO: Check if connected module is really a VC MIPI module
-        vc_core_print_desc(dev_mod, desc);
-        vc_core_print_csr(dev_mod, desc);
-        vc_core_print_modes(dev_mod, desc);
 
         ctrl->client_mod = client_mod;
         ctrl->mod_i2c_addr = mod_i2c_addr;
@@ -862,6 +1350,8 @@ int vc_core_update_controls(struct vc_cam *cam)
                         __FUNCTION__, num_lanes, format, ctrl->exposure.max, ctrl->framerate.max);
         }
 
+        vc_core_update_timing(cam);
+
         return 0;
 }
 
@@ -883,6 +1373,7 @@ static void vc_core_state_init(struct vc_cam *cam)
         state->exposure_cnt = 0;
         state->retrigger_cnt = 0;
         state->framerate = ctrl->framerate.def;
+        state->vblank = 0;
         state->num_lanes = desc->modes[0].num_lanes;
         state->format_code = vc_core_get_default_format(cam);
         format = vc_core_v4l2_code_to_format(state->format_code);
@@ -895,6 +1386,11 @@ static void vc_core_state_init(struct vc_cam *cam)
         state->frame.width = ctrl->frame.width;
         state->frame.height = ctrl->frame.height;
         state->streaming = 0;
+        state->stream_state = VC_STREAM_OFF;
+        state->stream_changed = 0;
+        state->hw.sen_mode = VC_HW_UNKNOWN;
+        state->hw.io_mode = VC_HW_UNKNOWN;
+        state->hw.trigger_mode = VC_HW_UNKNOWN;
         state->flags = 0x00;
 }
 
@@ -902,10 +1398,24 @@ int vc_core_init(struct vc_cam *cam, struct i2c_client *client)
 {
         struct vc_desc *desc = &cam->desc;
         struct vc_ctrl *ctrl = &cam->ctrl;
+        enum vc_op prev;
+        __u64 start;
+        int mod_i2c_addr;
         int ret;
 
+        mutex_init(&cam->capture.lock);
+        cam->i2c.retries = VC_I2C_RETRIES;
+        cam->i2c.retry_delay_us = VC_I2C_RETRY_DELAY_US;
+        cam->i2c.fault_timeout_us = VC_I2C_FAULT_TIMEOUT_US;
+
         ctrl->client_sen = client;
-        ret = vc_mod_setup(ctrl, 0x10, desc);
+        mod_i2c_addr = vc_mod_assign_addr(ctrl);
+        if (mod_i2c_addr < 0) {
+                return mod_i2c_addr;
+        }
+        prev = vc_stats_begin(cam, VC_OP_DESC_LOAD, &start);
+        ret = vc_mod_setup(ctrl, mod_i2c_addr, desc);
+        vc_stats_end(cam, prev, start);
         if (ret) {
                 return -EIO;
         }
@@ -914,49 +1424,112 @@ int vc_core_init(struct vc_cam *cam, struct i2c_client *client)
                 return -EIO;
         }
         if (ctrl->frame.width == 0 || ctrl->frame.height == 0) {
-                vc_sen_read_image_size(ctrl, &ctrl->frame);
+                ret = vc_sen_read_image_size(ctrl, &ctrl->frame);
+                if (ret) {
+                        return ret;
+                }
+        }
+        if (ctrl->mod == NULL) {
+                ret = vc_mod_generic_init(ctrl, desc);
+                if (ret) {
+                        return ret;
+                }
         }
 #ifdef READ_VMAX
         vc_sen_read_vmax(&cam->ctrl);
 #endif
         vc_core_state_init(cam);
         vc_core_update_controls(cam);
-        vc_core_print_mode(cam);
 
-        vc_notice(&ctrl->client_mod->dev, "VC MIPI Core successfully initialized");
+        // Descriptor, modes and limits are available in debugfs (see vc_mipi_debugfs.c)
+        vc_notice(&ctrl->client_mod->dev, "VC MIPI %.*s %.*s (module id: 0x%04x, rev: %u, modes: %u) initialized\n",
+                (int)sizeof(desc->sen_manuf), desc->sen_manuf, (int)sizeof(desc->sen_type), desc->sen_type,
+                desc->mod_id, desc->mod_rev, desc->num_modes);
         return 0;
 }
 
-static int vc_mod_write_exposure(struct i2c_client *client, __u32 value)
+// Releases the module controller client, also after a failed vc_core_init(). The module is held in
+// reset, without reset GPIO it is moved back to its default addresses, so that it answers at the
+// addresses of its firmware node only while it is probed (see vc_mod_assign_addr()).
+void vc_core_free(struct vc_cam *cam)
 {
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct i2c_client *client = ctrl->client_mod;
+        struct device *dev = vc_core_get_sen_device(cam);
+        int ret;
+
+        mutex_lock(&vc_mod_addr_lock);
+        if (ctrl->reset_gpio) {
+                gpiod_set_value_cansleep(ctrl->reset_gpio, 1);
+
+        } else if (client && ctrl->mod_i2c_addr != MOD_DEFAULT_ADDR) {
+                // The module controller answers at its default address after the write.
+                ret = i2c_write_reg(ctrl, client, MOD_REG_SEN_ADDR, SEN_DEFAULT_ADDR, __FUNCTION__);
+                ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_MOD_ADDR, MOD_DEFAULT_ADDR,
+                        __FUNCTION__));
+                if (ret) {
+                        vc_warn(dev, "%s(): Unable to move the module back to 0x%02x / 0x%02x (error: %d)\n",
+                                __FUNCTION__, MOD_DEFAULT_ADDR, SEN_DEFAULT_ADDR, ret);
+                }
+        }
+        mutex_unlock(&vc_mod_addr_lock);
+
+        if (client) {
+                i2c_unregister_device(client);
+                ctrl->client_mod = NULL;
+        }
+}
+
+static int vc_mod_write_exposure(struct vc_ctrl *ctrl, __u32 value)
+{
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int ret;
 
         vc_dbg(dev, "%s(): Write module exposure = 0x%08x (%u)\n", __FUNCTION__, value, value);
 
-        ret  = i2c_write_reg(dev, client, MOD_REG_EXPO_L, L_BYTE(value), __FUNCTION__);
-        ret |= i2c_write_reg(dev, client, MOD_REG_EXPO_M, M_BYTE(value), __FUNCTION__);
-        ret |= i2c_write_reg(dev, client, MOD_REG_EXPO_H, H_BYTE(value), __FUNCTION__);
-        ret |= i2c_write_reg(dev, client, MOD_REG_EXPO_U, U_BYTE(value), __FUNCTION__);
+        ret = i2c_write_reg(ctrl, client, MOD_REG_EXPO_L, L_BYTE(value), __FUNCTION__);
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_EXPO_M, M_BYTE(value), __FUNCTION__));
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_EXPO_H, H_BYTE(value), __FUNCTION__));
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_EXPO_U, U_BYTE(value), __FUNCTION__));
 
         return ret;
 }
 
-static int vc_mod_write_retrigger(struct i2c_client *client, __u32 value)
+static int vc_mod_write_retrigger(struct vc_ctrl *ctrl, __u32 value)
 {
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int ret;
 
         vc_dbg(dev, "%s(): Write module retrigger = 0x%08x (%u)\n", __FUNCTION__, value, value);
 
-        ret  = i2c_write_reg(dev, client, MOD_REG_RETRIG_L, L_BYTE(value), __FUNCTION__);
-        ret |= i2c_write_reg(dev, client, MOD_REG_RETRIG_M, M_BYTE(value), __FUNCTION__);
-        ret |= i2c_write_reg(dev, client, MOD_REG_RETRIG_H, H_BYTE(value), __FUNCTION__);
-        ret |= i2c_write_reg(dev, client, MOD_REG_RETRIG_U, U_BYTE(value), __FUNCTION__);
+        ret = i2c_write_reg(ctrl, client, MOD_REG_RETRIG_L, L_BYTE(value), __FUNCTION__);
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_RETRIG_M, M_BYTE(value), __FUNCTION__));
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_RETRIG_H, H_BYTE(value), __FUNCTION__));
+        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, MOD_REG_RETRIG_U, U_BYTE(value), __FUNCTION__));
 
         return ret;
 }
 
+// Reads a 32 bit count of the module (exposure or retrigger), starting with the LSB register.
+static int vc_mod_read_count(struct vc_ctrl *ctrl, __u16 addr_l, __u32 *value)
+{
+        struct i2c_client *client = ctrl->client_mod;
+        int byte, ret;
+
+        *value = 0;
+        for (byte = 0; byte < 4; byte++) {
+                ret = i2c_read_reg(ctrl, client, addr_l + byte, __FUNCTION__);
+                if (ret < 0) {
+                        return ret;
+                }
+                *value |= (__u32)ret << (8 * byte);
+        }
+
+        return 0;
+}
+
 static __u8 vc_mod_find_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format, __u8 type, __u8 binning)
 {
         struct vc_desc *desc = &cam->desc;
@@ -982,14 +1555,15 @@ static __u8 vc_mod_find_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format, __
         return mode_index;
 }
 
-static int vc_mod_write_mode(struct i2c_client *client, __u8 mode)
+static int vc_mod_write_mode(struct vc_ctrl *ctrl, __u8 mode)
 {
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
         int ret;
 
         vc_dbg(dev, "%s(): Write module mode: 0x%02x\n", __FUNCTION__, mode);
 
-        ret = i2c_write_reg(dev, client, MOD_REG_MODE, mode, __FUNCTION__);
+        ret = i2c_write_reg(ctrl, client, MOD_REG_MODE, mode, __FUNCTION__);
         if (ret)
                 vc_err(dev, "%s(): Unable to write module mode: 0x%02x (error: %d)\n", __FUNCTION__, mode, ret);
 
@@ -1001,60 +1575,84 @@ static int vc_mod_reset_module(struct vc_cam *cam, __u8 mode)
         struct vc_ctrl *ctrl = &cam->ctrl;
         struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
+        enum vc_op prev;
+        __u64 start;
         int ret;
 
         vc_dbg(dev, "%s(): Reset the module!\n", __FUNCTION__);
 
+        prev = vc_stats_begin(cam, VC_OP_MODE_RESET, &start);
         ret = vc_mod_set_power(cam, 0);
-        ret |= vc_mod_write_mode(client, mode);
-        ret |= vc_mod_set_power(cam, 1);
-        ret |= vc_mod_wait_until_module_is_ready(client);
+        ret = vc_first_error(ret, vc_mod_write_mode(ctrl, mode));
+        ret = vc_first_error(ret, vc_mod_set_power(cam, 1));
+        ret = vc_first_error(ret, vc_mod_wait_until_module_is_ready(ctrl));
+
+        // The module and the sensor are back at their register defaults, written again on the next start.
+        cam->state.hw.sen_mode = VC_HW_UNKNOWN;
+        cam->state.hw.io_mode = VC_HW_UNKNOWN;
+        cam->state.hw.trigger_mode = VC_HW_UNKNOWN;
+
+        trace_vc_mode_reset(client->addr, mode, ret, ktime_get_ns() - start);
+        vc_stats_end(cam, prev, start);
 
         return ret;
 }
 
+// Modes of type stream survive a stream stop. All others are set by a module reset at each start.
+static int vc_mod_is_mode_persistent(struct vc_cam *cam)
+{
+        return vc_mod_get_mode_type(cam) == MODE_TYPE_STREAM && !(cam->ctrl.flags & FLAG_RESET_ALWAYS);
+}
+
+static __u8 vc_mod_get_mode_type(struct vc_cam *cam)
+{
+        switch (cam->state.trigger_mode) {
+        case REG_TRIGGER_DISABLE:
+        case REG_TRIGGER_STREAM_EDGE:
+        case REG_TRIGGER_STREAM_LEVEL:
+        default:
+                return MODE_TYPE_STREAM;
+        case REG_TRIGGER_SYNC:
+                if (cam->ctrl.flags & FLAG_TRIGGER_SLAVE) {
+                        return MODE_TYPE_SLAVE;
+                }
+                return MODE_TYPE_STREAM;
+        case REG_TRIGGER_EXTERNAL:
+        case REG_TRIGGER_PULSEWIDTH:
+        case REG_TRIGGER_SELF:
+        case REG_TRIGGER_SINGLE:
+                return MODE_TYPE_TRIGGER;
+        }
+}
+
 int vc_mod_set_mode(struct vc_cam *cam, int *reset)
 {
-        struct vc_ctrl *ctrl = &cam->ctrl;
         struct vc_state *state = &cam->state;
         struct device *dev = vc_core_get_mod_device(cam);
         __u8 num_lanes = state->num_lanes;
         __u8 format = vc_core_v4l2_code_to_format(state->format_code);
         char fourcc[5];
         char *stype;
-        __u8 type = 0;
+        __u8 type = vc_mod_get_mode_type(cam);
         __u8 binning = 0; // TODO: Not implemented yet
         __u8 mode = 0;
         int ret = 0;
 
-        switch (cam->state.trigger_mode) {
-        case REG_TRIGGER_DISABLE:
-        case REG_TRIGGER_STREAM_EDGE:
-        case REG_TRIGGER_STREAM_LEVEL:
+        switch (type) {
+        case MODE_TYPE_STREAM:
         default:
-                type = MODE_TYPE_STREAM;
                 stype = "STREAM";
                 break;
-        case REG_TRIGGER_SYNC:
-                if (cam->ctrl.flags & FLAG_TRIGGER_SLAVE) {
-                        type = MODE_TYPE_SLAVE;
-                        stype = "SLAVE";
-                } else {
-                        type = MODE_TYPE_STREAM;
-                        stype = "STREAM";
-                }
+        case MODE_TYPE_SLAVE:
+                stype = "SLAVE";
                 break;
-        case REG_TRIGGER_EXTERNAL:
-        case REG_TRIGGER_PULSEWIDTH:
-        case REG_TRIGGER_SELF:
-        case REG_TRIGGER_SINGLE:
-                type = MODE_TYPE_TRIGGER;
+        case MODE_TYPE_TRIGGER:
                 stype = "EXT.TRG";
                 break;
         }
 
         mode = vc_mod_find_mode(cam, num_lanes, format, type, binning);
-        if (mode == state->mode && (!(ctrl->flags & FLAG_RESET_ALWAYS) && type == MODE_TYPE_STREAM)) {
+        if (mode == state->mode && vc_mod_is_mode_persistent(cam)) {
                 vc_dbg(dev, "%s(): Module mode %u need not to be set!\n", __FUNCTION__, mode);
                 *reset = 0;
                 return 0;
@@ -1082,6 +1680,37 @@ int vc_mod_is_trigger_enabled(struct vc_cam *cam)
         return cam->state.trigger_mode != REG_TRIGGER_DISABLE;
 }
 
+// A slave in sync trigger mode is triggered by the sync signal of its master.
+int vc_mod_is_sync_slave(struct vc_cam *cam)
+{
+        return (cam->ctrl.flags & FLAG_TRIGGER_SLAVE) && cam->state.trigger_mode == REG_TRIGGER_SYNC;
+}
+
+// In single trigger mode every write of V4L2_CID_VC_SINGLE_TRIGGER (or of the trigger generator)
+// starts one exposure.
+int vc_mod_is_single_trigger(struct vc_cam *cam)
+{
+        return cam->state.trigger_mode == REG_TRIGGER_SINGLE;
+}
+
+// The mode argument is the one of vc_mod_set_trigger_mode().
+int vc_mod_is_trigger_mode_supported(struct vc_cam *cam, int mode)
+{
+        __u32 flags = cam->ctrl.flags;
+
+        switch (mode) {
+        case 0: return 1;
+        case 1: return !!(flags & FLAG_TRIGGER_EXTERNAL);
+        case 2: return !!(flags & FLAG_TRIGGER_PULSEWIDTH);
+        case 3: return !!(flags & (FLAG_TRIGGER_SELF | FLAG_TRIGGER_SELF_V2));
+        case 4: return !!(flags & FLAG_TRIGGER_SINGLE);
+        case 5: return !!(flags & (FLAG_TRIGGER_SYNC | FLAG_TRIGGER_SLAVE));
+        case 6: return !!(flags & FLAG_TRIGGER_STREAM_EDGE);
+        case 7: return !!(flags & FLAG_TRIGGER_STREAM_LEVEL);
+        }
+        return 0;
+}
+
 int vc_mod_set_trigger_mode(struct vc_cam *cam, int mode)
 {
         struct vc_ctrl *ctrl = &cam->ctrl;
@@ -1125,10 +1754,11 @@ int vc_mod_set_trigger_mode(struct vc_cam *cam, int mode)
                 vc_err(dev, "%s(): Trigger mode %d not supported!\n", __FUNCTION__, mode);
                 return -EINVAL;
         }
+        vc_core_unprepare_stream(cam);
 
         vc_core_update_controls(cam);
 
-        vc_notice(dev, "%s(): Set trigger mode: %s\n", __FUNCTION__, mode_desc);
+        vc_dbg(dev, "%s(): Set trigger mode: %s\n", __FUNCTION__, mode_desc);
 
         return 0;
 }
@@ -1150,12 +1780,13 @@ int vc_mod_get_trigger_mode(struct vc_cam *cam)
 
 int vc_mod_set_single_trigger(struct vc_cam *cam)
 {
-        struct i2c_client *client = cam->ctrl.client_mod;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct i2c_client *client = ctrl->client_mod;
         struct device *dev = &client->dev;
 
-        vc_notice(dev, "%s(): Set single trigger\n", __FUNCTION__);
+        vc_dbg(dev, "%s(): Set single trigger\n", __FUNCTION__);
 
-        return i2c_write_reg(dev, client, MOD_REG_EXTTRIG, REG_TRIGGER_SINGLE, __FUNCTION__);
+        return i2c_write_reg(ctrl, client, MOD_REG_EXTTRIG, REG_TRIGGER_SINGLE, __FUNCTION__);
 }
 
 int vc_mod_is_io_enabled(struct vc_cam *cam)
@@ -1207,7 +1838,7 @@ int vc_mod_set_io_mode(struct vc_cam *cam, int mode)
                 return -EINVAL;
         }
 
-        vc_notice(dev, "%s(): Set IO mode: %s\n", __FUNCTION__, mode_desc);
+        vc_dbg(dev, "%s(): Set IO mode: %s\n", __FUNCTION__, mode_desc);
 
         return 0;
 }
@@ -1238,18 +1869,18 @@ static int vc_sen_write_mode(struct vc_ctrl *ctrl, int mode)
         if(mode == ctrl->csr.sen.mode_standby) {
                 value = ctrl->csr.sen.mode_standby;
                 if(ctrl->csr.sen.mode.l) {
-                        ret = i2c_write_reg(dev, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
+                        ret = i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
                 }
                 if(ctrl->csr.sen.mode.m) {
-                        ret |= i2c_write_reg(dev, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
+                        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.m, value, __FUNCTION__));
                 }
         } else {
                 value = ctrl->csr.sen.mode_operating;
                 if(ctrl->csr.sen.mode.m) {
-                        ret |= i2c_write_reg(dev, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
+                        ret = i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
                 }
                 if(ctrl->csr.sen.mode.l) {
-                        ret = i2c_write_reg(dev, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
+                        ret = vc_first_error(ret, i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.l, value, __FUNCTION__));
                 }
         }
         if (ret)
@@ -1262,9 +1893,14 @@ static int vc_sen_read_image_size(struct vc_ctrl *ctrl, struct vc_frame *size)
 {
         struct i2c_client *client = ctrl->client_sen;
         struct device *dev = &client->dev;
+        int ret;
 
-        size->width = i2c_read_reg2(dev, client, &ctrl->csr.sen.o_width, __FUNCTION__);
-        size->height = i2c_read_reg2(dev, client, &ctrl->csr.sen.o_height, __FUNCTION__);
+        ret = i2c_read_reg2(ctrl, client, &ctrl->csr.sen.o_width, &size->width, __FUNCTION__);
+        ret = vc_first_error(ret, i2c_read_reg2(ctrl, client, &ctrl->csr.sen.o_height, &size->height, __FUNCTION__));
+        if (ret) {
+                vc_err(dev, "%s(): Couldn't read image size (error: %d)\n", __FUNCTION__, ret);
+                return ret;
+        }
 
         vc_dbg(dev, "%s(): Read image size (width: %u, height: %u)\n", __FUNCTION__, size->width, size->height);
 
@@ -1278,6 +1914,8 @@ int vc_sen_set_roi(struct vc_cam *cam)
         struct i2c_client *client = ctrl->client_sen;
         struct device *dev = &client->dev;
         int w_left, w_top, w_width, w_height;
+        enum vc_op prev;
+        __u64 start;
         int ret = 0;
 
         __u16 vc2EAV_SEL = 0x3942;
@@ -1285,6 +1923,8 @@ int vc_sen_set_roi(struct vc_cam *cam)
         vc_csr2 vc2OP_BLK_HWIDTH   = (vc_csr2) { .l = 0x30d0, .m = 0x30d1 };
         vc_csr2 vc2INFO_HWIDTH  = (vc_csr2) { .l = 0x30d2, .m = 0x30d3 };
 
+        prev = vc_stats_begin(cam, VC_OP_SET_ROI, &start);
+
         w_left = ctrl->frame.left + state->frame.left;
         w_top = ctrl->frame.top + state->frame.top;
         w_width = state->frame.width;
@@ -1295,24 +1935,26 @@ int vc_sen_set_roi(struct vc_cam *cam)
                 w_height *= 2;
         }
 
-        vc_notice(dev, "%s(): Set sensor roi: (left: %u, top: %u, width: %u, height: %u)\n", __FUNCTION__,
+        vc_dbg(dev, "%s(): Set sensor roi: (left: %u, top: %u, width: %u, height: %u)\n", __FUNCTION__,
                 w_left, w_top, w_width, w_height);
 
-        ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.h_start, w_left, __FUNCTION__);
-        ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.v_start, w_top, __FUNCTION__);
-        ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.o_width, w_width, __FUNCTION__);
-        ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.o_height, w_height, __FUNCTION__);
+        ret = i2c_write_reg2(ctrl, client, &ctrl->csr.sen.h_start, w_left, __FUNCTION__);
+        ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &ctrl->csr.sen.v_start, w_top, __FUNCTION__));
+        ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &ctrl->csr.sen.o_width, w_width, __FUNCTION__));
+        ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &ctrl->csr.sen.o_height, w_height, __FUNCTION__));
 
         if (ctrl->flags & FLAG_PREGIUS_S) {
-                ret |= i2c_write_reg2(dev, client, &vc2OP_BLK_HWIDTH, w_width, __FUNCTION__);
-                ret |= i2c_write_reg2(dev, client, &vc2INFO_HWIDTH, w_width, __FUNCTION__);
-                ret |= i2c_write_reg(dev, client, vc2EAV_SEL, 0x03, __FUNCTION__);
+                ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &vc2OP_BLK_HWIDTH, w_width, __FUNCTION__));
+                ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &vc2INFO_HWIDTH, w_width, __FUNCTION__));
+                ret = vc_first_error(ret, i2c_write_reg(ctrl, client, vc2EAV_SEL, 0x03, __FUNCTION__));
 
         } else {
-                ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.h_end, w_width, __FUNCTION__);
-                ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.v_end, w_height, __FUNCTION__);
+                ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &ctrl->csr.sen.h_end, w_width, __FUNCTION__));
+                ret = vc_first_error(ret, i2c_write_reg2(ctrl, client, &ctrl->csr.sen.v_end, w_height, __FUNCTION__));
         }
 
+        vc_stats_end(cam, prev, start);
+
         if (ret) {
                 vc_err(dev, "%s(): Couldn't set sensor roi: (left: %u, top: %u, width: %u, height: %u) (error: %d)\n", __FUNCTION__,
                         w_left, w_top, w_width, w_height, ret);
@@ -1329,8 +1971,9 @@ static __u32 vc_sen_read_vmax(struct vc_ctrl *ctrl)
 {
         struct i2c_client *client = ctrl->client_sen;
         struct device *dev = &client->dev;
-        __u32 vmax = i2c_read_reg4(dev, client, &ctrl->csr.sen.vmax, __FUNCTION__);
+        __u32 vmax = 0;
 
+        i2c_read_reg4(ctrl, client, &ctrl->csr.sen.vmax, &vmax, __FUNCTION__);
         vc_notice(dev, "%s(): Read sensor VMAX: 0x%08x (%u)\n", __FUNCTION__, vmax, vmax);
 
         return vmax;
@@ -1341,7 +1984,7 @@ static __u32 vc_sen_read_vmax(struct vc_ctrl *ctrl)
 // {
 // 	struct i2c_client *client = ctrl->client_sen;
 // 	struct device *dev = &client->dev;
-// 	__u32 hmax = i2c_read_reg4(dev, client, &ctrl->csr.sen.hmax, __FUNCTION__);
+// 	__u32 hmax = i2c_read_reg4(ctrl, client, &ctrl->csr.sen.hmax, __FUNCTION__);
 
 // 	vc_dbg(dev, "%s(): Read sensor HMAX: 0x%08x (%u)\n", __FUNCTION__, hmax, hmax);
 
@@ -1355,7 +1998,7 @@ static int vc_sen_write_vmax(struct vc_ctrl *ctrl, __u32 vmax)
 
         vc_dbg(dev, "%s(): Write sensor VMAX: 0x%08x (%u)\n", __FUNCTION__, vmax, vmax);
 
-        return i2c_write_reg4(dev, client, &ctrl->csr.sen.vmax, vmax, __FUNCTION__);
+        return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.vmax, vmax, __FUNCTION__);
 }
 
 static int vc_sen_write_shs(struct vc_ctrl *ctrl, __u32 shs)
@@ -1365,7 +2008,7 @@ static int vc_sen_write_shs(struct vc_ctrl *ctrl, __u32 shs)
 
         vc_dbg(dev, "%s(): Write sensor SHS: 0x%08x (%u)\n", __FUNCTION__, shs, shs);
 
-        return i2c_write_reg4(dev, client, &ctrl->csr.sen.shs, shs, __FUNCTION__);
+        return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.shs, shs, __FUNCTION__);
 }
 
 static int vc_sen_write_flash_duration(struct vc_ctrl *ctrl, __u32 duration)
@@ -1375,7 +2018,7 @@ static int vc_sen_write_flash_duration(struct vc_ctrl *ctrl, __u32 duration)
 
         vc_dbg(dev, "%s(): Write sensor flash duration: 0x%08x (%u)\n", __FUNCTION__, duration, duration);
 
-        return i2c_write_reg4(dev, client, &ctrl->csr.sen.flash_duration, duration, __FUNCTION__);
+        return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.flash_duration, duration, __FUNCTION__);
 }
 
 static int vc_sen_write_flash_offset(struct vc_ctrl *ctrl, __u32 offset)
@@ -1385,7 +2028,7 @@ static int vc_sen_write_flash_offset(struct vc_ctrl *ctrl, __u32 offset)
 
         vc_dbg(dev, "%s(): Write sensor flash offset: 0x%08x (%u)\n", __FUNCTION__, offset, offset);
 
-        return i2c_write_reg4(dev, client, &ctrl->csr.sen.flash_offset, offset, __FUNCTION__);
+        return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.flash_offset, offset, __FUNCTION__);
 }
 
 int vc_sen_set_gain(struct vc_cam *cam, int gain)
@@ -1393,6 +2036,8 @@ int vc_sen_set_gain(struct vc_cam *cam, int gain)
         struct vc_ctrl *ctrl = &cam->ctrl;
         struct i2c_client *client = ctrl->client_sen;
         struct device *dev = &client->dev;
+        enum vc_op prev;
+        __u64 start;
         int ret = 0;
 
         if (gain < ctrl->gain.min)
@@ -1400,9 +2045,11 @@ int vc_sen_set_gain(struct vc_cam *cam, int gain)
         if (gain > ctrl->gain.max)
                 gain = ctrl->gain.max;
 
-        vc_notice(dev, "%s(): Set sensor gain: %u\n", __FUNCTION__, gain);
+        vc_dbg(dev, "%s(): Set sensor gain: %u\n", __FUNCTION__, gain);
 
-        ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.gain, gain, __FUNCTION__);
+        prev = vc_stats_begin(cam, VC_OP_SET_GAIN, &start);
+        ret = i2c_write_reg2(ctrl, client, &ctrl->csr.sen.gain, gain, __FUNCTION__);
+        vc_stats_end(cam, prev, start);
         if (ret) {
                 vc_err(dev, "%s(): Couldn't set gain (error: %d)\n", __FUNCTION__, ret);
                 return ret;
@@ -1426,10 +2073,10 @@ int vc_sen_set_blacklevel(struct vc_cam *cam, __u32 blacklevel_rel)
         __u32 blacklevel_max = vc_core_get_blacklevel(cam, num_lanes, format).max;
         __u32 blacklevel_abs = (__u32)DIV_ROUND_CLOSEST((blacklevel_rel * blacklevel_max), 100000);
 
-        vc_notice(dev, "%s(): Set sensor black level: %u (%u/%u)\n", __FUNCTION__, 
+        vc_dbg(dev, "%s(): Set sensor black level: %u (%u/%u)\n", __FUNCTION__, 
                 blacklevel_rel, blacklevel_abs, blacklevel_max);
 
-        ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.blacklevel, blacklevel_abs, __FUNCTION__);
+        ret = i2c_write_reg2(ctrl, client, &ctrl->csr.sen.blacklevel, blacklevel_abs, __FUNCTION__);
         if (ret) {
                 vc_err(dev, "%s(): Couldn't set black level (error: %d)\n", __FUNCTION__, ret);
                 return ret;
@@ -1439,60 +2086,239 @@ int vc_sen_set_blacklevel(struct vc_cam *cam, __u32 blacklevel_rel)
         return 0;
 }
 
-int vc_sen_start_stream(struct vc_cam *cam)
+static const char * const vc_stream_state_names[VC_STREAM_STATE_NUM] = {
+        [VC_STREAM_OFF]                 = "off",
+        [VC_STREAM_STANDBY]             = "standby",
+        [VC_STREAM_STREAMING]           = "streaming",
+        [VC_STREAM_ARMED]               = "armed",
+};
+
+const char *vc_core_get_stream_state_name(enum vc_stream_state stream_state)
+{
+        return stream_state < VC_STREAM_STATE_NUM ? vc_stream_state_names[stream_state] : "unknown";
+}
+
+// Settings which change the module mode or the sensor programming invalidate a preparation. While
+// streaming, the next start has to program the camera again.
+static void vc_core_unprepare_stream(struct vc_cam *cam)
+{
+        if (cam->state.stream_state == VC_STREAM_STANDBY) {
+                cam->state.stream_state = VC_STREAM_OFF;
+        }
+        if (cam->state.streaming) {
+                cam->state.stream_changed = 1;
+        }
+}
+
+// Writes the register only if the value differs from the one written last. A failed write leaves
+// the register unknown, so that it is written again at the next transition. VC_HW_UNKNOWN hands the
+// register over to the module.
+static int vc_core_update_hw(struct vc_cam *cam, int *cached, int value, int (*write)(struct vc_ctrl *, int))
+{
+        int ret;
+
+        if (value == VC_HW_UNKNOWN || *cached == value) {
+                *cached = value;
+                return 0;
+        }
+
+        ret = write(&cam->ctrl, value);
+        *cached = ret ? VC_HW_UNKNOWN : value;
+
+        return ret;
+}
+
+// Register values of the stream states. VC_HW_UNKNOWN: the register is controlled by the module.
+static void vc_core_get_stream_regs(struct vc_cam *cam, enum vc_stream_state stream_state, struct vc_hw_state *regs)
 {
         struct vc_ctrl *ctrl = &cam->ctrl;
         struct vc_state *state = &cam->state;
-        struct i2c_client *client_mod = ctrl->client_mod;
-        struct device *dev = &ctrl->client_sen->dev;
-        int ret = 0;
-
-        vc_notice(dev, "%s(): Start streaming\n", __FUNCTION__);
-        vc_dbg(dev, "%s(): MM: 0x%02x, TM: 0x%02x, IO: 0x%02x\n",
-                __FUNCTION__, state->mode, state->trigger_mode, state->io_mode);
 
-        if (state->streaming) {
-                vc_sen_stop_stream(cam);
+        regs->sen_mode = ctrl->csr.sen.mode_standby;
+        regs->io_mode = REG_IO_DISABLE;
+        regs->trigger_mode = REG_TRIGGER_DISABLE;
+        if (stream_state < VC_STREAM_STREAMING) {
+                return;
         }
 
-        if ((ctrl->flags & FLAG_EXPOSURE_SONY || ctrl->flags & FLAG_EXPOSURE_NORMAL) || 
+        // In trigger mode the module controls the operating mode of OmniVision sensors.
+        if ((ctrl->flags & FLAG_EXPOSURE_SONY || ctrl->flags & FLAG_EXPOSURE_NORMAL) ||
             (ctrl->flags & FLAG_EXPOSURE_OMNIVISION && !vc_mod_is_trigger_enabled(cam))) {
-                ret |= vc_sen_write_mode(ctrl, ctrl->csr.sen.mode_operating);
-                if (ret)
-                        vc_err(dev, "%s(): Unable to start streaming (error: %d)\n", __FUNCTION__, ret);
+                regs->sen_mode = ctrl->csr.sen.mode_operating;
+        } else {
+                regs->sen_mode = VC_HW_UNKNOWN;
+        }
+
+        if (vc_mod_is_sync_slave(cam)) {
+                regs->io_mode = REG_IO_XTRIG_ENABLE;
+                regs->trigger_mode = REG_TRIGGER_DISABLE;
+        } else {
+                regs->io_mode = state->io_mode;
+                regs->trigger_mode = state->trigger_mode;
+        }
+}
+
+static enum vc_stream_state vc_core_get_start_state(struct vc_cam *cam)
+{
+        if (vc_mod_is_trigger_enabled(cam) || vc_mod_is_sync_slave(cam)) {
+                return VC_STREAM_ARMED;
+        }
+        return VC_STREAM_STREAMING;
+}
+
+// A camera which already streams with the settings of the requested start and whose cached sensor,
+// IO and trigger mode match them needn't be touched at all.
+int vc_core_is_stream_current(struct vc_cam *cam)
+{
+        struct vc_state *state = &cam->state;
+        enum vc_stream_state stream_state = vc_core_get_start_state(cam);
+        struct vc_hw_state regs;
+
+        if (!state->streaming || state->stream_changed || state->stream_state != stream_state) {
+                return 0;
         }
 
-        if (ctrl->flags & FLAG_TRIGGER_SLAVE && state->trigger_mode == REG_TRIGGER_SYNC) {
-                ret |= vc_mod_write_io_mode(client_mod, REG_IO_XTRIG_ENABLE);
-                ret |= vc_mod_write_trigger_mode(client_mod, REG_TRIGGER_DISABLE);
+        vc_core_get_stream_regs(cam, stream_state, &regs);
+        return regs.sen_mode == state->hw.sen_mode && regs.io_mode == state->hw.io_mode &&
+                regs.trigger_mode == state->hw.trigger_mode;
+}
+
+// Moves between the states STANDBY (or OFF), STREAMING and ARMED. Only the registers which differ
+// from the cached hardware state are written: sensor, IO and trigger mode towards streaming, the
+// reverse order towards standby. Starting or stopping twice doesn't write anything. A failed write
+// leaves the camera in state OFF.
+static int vc_core_set_stream_state(struct vc_cam *cam, enum vc_stream_state stream_state)
+{
+        struct vc_state *state = &cam->state;
+        struct vc_hw_state *hw = &state->hw;
+        struct device *dev = vc_core_get_sen_device(cam);
+        struct vc_hw_state regs;
+        int ret = 0;
+
+        vc_core_get_stream_regs(cam, stream_state, &regs);
+
+        vc_dbg(dev, "%s(): Stream state: %s -> %s (sensor: %d -> %d, IO: %d -> %d, trigger: %d -> %d)\n",
+                __FUNCTION__, vc_core_get_stream_state_name(state->stream_state),
+                vc_core_get_stream_state_name(stream_state), hw->sen_mode, regs.sen_mode, hw->io_mode,
+                regs.io_mode, hw->trigger_mode, regs.trigger_mode);
 
+        if (stream_state >= VC_STREAM_STREAMING) {
+                ret = vc_core_update_hw(cam, &hw->sen_mode, regs.sen_mode, vc_sen_write_mode);
+                ret = vc_first_error(ret, vc_core_update_hw(cam, &hw->io_mode, regs.io_mode, vc_mod_write_io_mode));
+                ret = vc_first_error(ret, vc_core_update_hw(cam, &hw->trigger_mode, regs.trigger_mode,
+                        vc_mod_write_trigger_mode));
         } else {
-                ret |= vc_mod_write_io_mode(client_mod, state->io_mode);
-                ret |= vc_mod_write_trigger_mode(client_mod, state->trigger_mode);
+                ret = vc_core_update_hw(cam, &hw->trigger_mode, regs.trigger_mode, vc_mod_write_trigger_mode);
+                ret = vc_first_error(ret, vc_core_update_hw(cam, &hw->io_mode, regs.io_mode, vc_mod_write_io_mode));
+                ret = vc_first_error(ret, vc_core_update_hw(cam, &hw->sen_mode, regs.sen_mode, vc_sen_write_mode));
+        }
+
+        if (ret) {
+                state->stream_state = VC_STREAM_OFF;
+                state->stream_changed = 1;
+                state->streaming = 0;
+                return ret;
         }
-        state->streaming = 1;
+
+        state->stream_state = stream_state;
+        state->streaming = (stream_state >= VC_STREAM_STREAMING);
+
+        return 0;
+}
+
+// Sets the mode of the module and, after a reset of the module, programs the sensor (state OFF ->
+// STANDBY). Streaming is started by vc_sen_start_stream() afterwards. The phases are accounted in
+// event. A camera can be prepared ahead of the stream start, e.g. all cameras in parallel. Nothing is
+// written again as long as the mode, frame and trigger mode remain unchanged until the start.
+int vc_core_prepare_stream(struct vc_cam *cam, struct vc_stream_event *event, int *reset)
+{
+        struct vc_state *state = &cam->state;
+        struct device *dev = vc_core_get_sen_device(cam);
+        int ret = 0;
+
+        if (state->stream_state == VC_STREAM_STANDBY) {
+                vc_dbg(dev, "%s(): Stream already prepared\n", __FUNCTION__);
+                *reset = 0;
+                return 0;
+        }
+
+        if (vc_core_is_stream_current(cam)) {
+                vc_dbg(dev, "%s(): Sensor is already streaming with these settings\n", __FUNCTION__);
+                *reset = 0;
+                return 0;
+        }
+
+        if (state->streaming) {
+                vc_warn(dev, "%s(): Sensor is already streaming!\n", __FUNCTION__);
+                ret = vc_sen_stop_stream(cam);
+                vc_core_mark_stream_phase(event, VC_PHASE_STOP_STREAM);
+        }
+
+        ret = vc_first_error(ret, vc_mod_set_mode(cam, reset));
+        vc_core_mark_stream_phase(event, VC_PHASE_SET_MODE);
+        if (!ret && *reset) {
+                ret = vc_first_error(ret, vc_sen_set_roi(cam));
+                vc_core_mark_stream_phase(event, VC_PHASE_SET_ROI);
+                ret = vc_first_error(ret, vc_sen_set_exposure(cam, state->exposure));
+                vc_core_mark_stream_phase(event, VC_PHASE_SET_EXPOSURE);
+                ret = vc_first_error(ret, vc_sen_set_gain(cam, state->gain));
+                vc_core_mark_stream_phase(event, VC_PHASE_SET_GAIN);
+                ret = vc_first_error(ret, vc_sen_set_blacklevel(cam, state->blacklevel));
+                vc_core_mark_stream_phase(event, VC_PHASE_SET_BLACKLEVEL);
+        }
+        state->stream_state = (ret == 0) ? VC_STREAM_STANDBY : VC_STREAM_OFF;
+        state->stream_changed = 0;
 
         return ret;
 }
 
-int vc_sen_stop_stream(struct vc_cam *cam)
+// Starts streaming (state STREAMING) or, in trigger mode and as sync slave, arms the module (state
+// ARMED). A camera which already streams with the same settings isn't touched.
+int vc_sen_start_stream(struct vc_cam *cam)
 {
         struct vc_ctrl *ctrl = &cam->ctrl;
         struct vc_state *state = &cam->state;
-        struct i2c_client *client_mod = ctrl->client_mod;
         struct device *dev = &ctrl->client_sen->dev;
+        enum vc_op prev;
+        __u64 start;
         int ret = 0;
 
-        vc_notice(dev, "%s(): Stop streaming\n", __FUNCTION__);
+        vc_dbg(dev, "%s(): Start streaming\n", __FUNCTION__);
+        vc_dbg(dev, "%s(): MM: 0x%02x, TM: 0x%02x, IO: 0x%02x\n",
+                __FUNCTION__, state->mode, state->trigger_mode, state->io_mode);
+
+        prev = vc_stats_begin(cam, VC_OP_START_STREAM, &start);
+        ret = vc_core_set_stream_state(cam, vc_core_get_start_state(cam));
+        vc_stats_end(cam, prev, start);
+        if (ret)
+                vc_err(dev, "%s(): Unable to start streaming (error: %d)\n", __FUNCTION__, ret);
+
+        return ret;
+}
+
+// Stops streaming. The sensor stays programmed (state STANDBY) if the module mode survives the stop,
+// otherwise the next start has to reset the module again (state OFF).
+int vc_sen_stop_stream(struct vc_cam *cam)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        struct device *dev = &ctrl->client_sen->dev;
+        enum vc_stream_state stream_state = state->stream_state;
+        enum vc_op prev;
+        __u64 start;
+        int ret = 0;
 
-        ret |= vc_mod_write_trigger_mode(client_mod, REG_TRIGGER_DISABLE);
-        ret |= vc_mod_write_io_mode(client_mod, REG_IO_DISABLE);
+        vc_dbg(dev, "%s(): Stop streaming\n", __FUNCTION__);
 
-        ret |= vc_sen_write_mode(ctrl, ctrl->csr.sen.mode_standby);
+        prev = vc_stats_begin(cam, VC_OP_STOP_STREAM, &start);
+        ret = vc_core_set_stream_state(cam, VC_STREAM_STANDBY);
+        vc_stats_end(cam, prev, start);
         if (ret)
                 vc_err(dev, "%s(): Unable to stop streaming (error: %d)\n", __FUNCTION__, ret);
 
-        state->streaming = 0;
+        if (ret || stream_state == VC_STREAM_OFF || state->stream_changed || !vc_mod_is_mode_persistent(cam)) {
+                state->stream_state = VC_STREAM_OFF;
+        }
 
         vc_dbg(dev, "%s(): ----------------------------------------------------------\n", __FUNCTION__);
 
@@ -1507,8 +2333,8 @@ static __u32 vc_core_calculate_period_1H(struct vc_cam *cam, __u8 num_lanes, __u
         struct vc_ctrl *ctrl = &cam->ctrl;
         __u8 index = 0;
 
-        for (index = 0; index <= 7; index++) {
-                struct vc_mode *mode = &ctrl->mode[index];
+        for (index = 0; index < VC_MAX_MODES; index++) {
+                const struct vc_mode *mode = &ctrl->mode[index];
                 if (mode->num_lanes == num_lanes && mode->format == format) {
                         return ((__u64)mode->hmax * 1000000000) / ctrl->clk_pixel;
                 }
@@ -1525,6 +2351,10 @@ static void vc_core_calculate_vmax(struct vc_cam *cam, __u32 period_1H_ns)
         __u64 frametime_1H;
 
         state->vmax = vc_core_get_optimized_vmax(cam);
+        // Extend the frame if the vertical blanking setting requires it.
+        if (state->vblank > 0 && state->frame.height + state->vblank > state->vmax) {
+                state->vmax = state->frame.height + state->vblank;
+        }
         // Lower the frame rate if the frame rate setting requires it.
         if (state->framerate > 0) {
                 frametime_ns = 1000000000000 / state->framerate;
@@ -1547,6 +2377,11 @@ static void vc_calculate_exposure_sony(struct vc_cam *cam, __u64 exposure_1H)
         // Exposure time [s] = (1 H period) × (Number of lines per frame - SHS)
         //                     + Exposure time error (t OFFSET ) [µs]
 
+        // SHS has to stay below VMAX, i.e. the exposure time is at least one line.
+        if (exposure_1H == 0) {
+                exposure_1H = 1;
+        }
+
         // Is exposure time less than frame time?
         if (exposure_1H < state->vmax - shs_min) {
                 // Yes then calculate exposure delay (shs) in between frame time.
@@ -1568,6 +2403,9 @@ static void vc_calculate_exposure_sony(struct vc_cam *cam, __u64 exposure_1H)
         // Special case: Framerate of slave module has to be a little bit faster (Tested with IMX183)
         if (state->trigger_mode == REG_TRIGGER_SYNC) {
                 state->vmax--;
+                if (state->shs >= state->vmax) {
+                        state->shs = state->vmax - 1;
+                }
         }
 }
 
@@ -1683,39 +2521,135 @@ static void vc_calculate_trig_exposure(struct vc_cam *cam, __u32 exposure_us)
         state->exposure_cnt = ((__u64)exposure_us * ctrl->clk_ext_trigger) / 1000000;
 }
 
+// Computes the sensor timing (VMAX, SHS) or the trigger timing (exposure and retrigger counts) of
+// the current mode for the given exposure without writing it.
+void vc_core_calculate_exposure_timing(struct vc_cam *cam, __u32 exposure_us)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+
+        state->vmax = 0;
+        state->shs = 0;
+        state->exposure_cnt = 0;
+        state->retrigger_cnt = 0;
+
+        if (ctrl->flags & FLAG_EXPOSURE_SONY || ctrl->flags & FLAG_EXPOSURE_NORMAL) {
+                switch (state->trigger_mode) {
+                case REG_TRIGGER_EXTERNAL:
+                case REG_TRIGGER_SINGLE:
+                case REG_TRIGGER_SELF:
+                        vc_calculate_trig_exposure(cam, exposure_us);
+                        break;
+                case REG_TRIGGER_PULSEWIDTH:
+                        break;
+                case REG_TRIGGER_DISABLE:
+                case REG_TRIGGER_SYNC:
+                case REG_TRIGGER_STREAM_EDGE:
+                case REG_TRIGGER_STREAM_LEVEL:
+                        vc_calculate_exposure(cam, exposure_us);
+                }
+
+        } else if (ctrl->flags & FLAG_EXPOSURE_OMNIVISION) {
+                vc_calculate_exposure(cam, exposure_us);
+        }
+}
+
+#define VC_SELF_TRIGGER_RETRIES  1
+
+// In self trigger mode (FLAG_TRIGGER_SELF) the module hangs up if the retrigger count shrinks while
+// it triggers, and sometimes misses an exposure change. While streaming the counts are therefore
+// updated in stages: triggering is paused, the counts are written so that the exposure stays below
+// the retrigger count in between, read back (and written again if the module missed them), then
+// triggering resumes. The pause lasts a few I2C transactions, i.e. at most one frame is lost.
+static int vc_mod_write_self_trigger_staged(struct vc_cam *cam, __u32 retrigger_prev)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        struct device *dev = vc_core_get_mod_device(cam);
+        __u32 exposure_cnt, retrigger_cnt;
+        __u64 start, pause_us, frame_us;
+        int attempt, ret;
+
+        start = ktime_get_ns();
+        ret = vc_core_update_hw(cam, &state->hw.trigger_mode, REG_TRIGGER_DISABLE, vc_mod_write_trigger_mode);
+
+        for (attempt = 0; ret == 0; attempt++) {
+                if (state->retrigger_cnt > retrigger_prev) {
+                        ret = vc_mod_write_retrigger(ctrl, state->retrigger_cnt);
+                        ret = vc_first_error(ret, vc_mod_write_exposure(ctrl, state->exposure_cnt));
+                } else {
+                        ret = vc_mod_write_exposure(ctrl, state->exposure_cnt);
+                        ret = vc_first_error(ret, vc_mod_write_retrigger(ctrl, state->retrigger_cnt));
+                }
+                ret = vc_first_error(ret, vc_mod_read_count(ctrl, MOD_REG_EXPO_L, &exposure_cnt));
+                ret = vc_first_error(ret, vc_mod_read_count(ctrl, MOD_REG_RETRIG_L, &retrigger_cnt));
+                if (ret || (exposure_cnt == state->exposure_cnt && retrigger_cnt == state->retrigger_cnt)) {
+                        break;
+                }
+
+                vc_warn(dev, "%s(): Counts not applied (exposure: %u/%u, retrigger: %u/%u)\n", __FUNCTION__,
+                        exposure_cnt, state->exposure_cnt, retrigger_cnt, state->retrigger_cnt);
+                if (attempt == VC_SELF_TRIGGER_RETRIES) {
+                        ret = -EIO;
+                        break;
+                }
+                retrigger_prev = retrigger_cnt;
+        }
+
+        // Resume in any case, a paused module doesn't deliver frames at all.
+        ret = vc_first_error(ret, vc_core_update_hw(cam, &state->hw.trigger_mode, state->trigger_mode,
+                vc_mod_write_trigger_mode));
+
+        pause_us = (ktime_get_ns() - start) / 1000;
+        frame_us = ctrl->clk_ext_trigger ? ((__u64)state->retrigger_cnt * 1000000) / ctrl->clk_ext_trigger : 0;
+        if (pause_us > frame_us) {
+                vc_warn(dev, "%s(): Triggering paused for %llu us, longer than a frame (%llu us)\n", __FUNCTION__,
+                        pause_us, frame_us);
+        } else {
+                vc_dbg(dev, "%s(): Triggering paused for %llu us\n", __FUNCTION__, pause_us);
+        }
+
+        return ret;
+}
+
 int vc_sen_set_exposure(struct vc_cam *cam, int exposure_us)
 {
         struct vc_ctrl *ctrl = &cam->ctrl;
         struct vc_state *state = &cam->state;
         struct device *dev = vc_core_get_sen_device(cam);
-        struct i2c_client *client_mod = ctrl->client_mod;
+        __u32 retrigger_prev = state->retrigger_cnt;
+        enum vc_op prev;
+        __u64 start;
         int ret = 0;
 
-        vc_notice(dev, "%s(): Set sensor exposure: %u us\n", __FUNCTION__, exposure_us);
+        vc_dbg(dev, "%s(): Set sensor exposure: %u us\n", __FUNCTION__, exposure_us);
 
         if (exposure_us < ctrl->exposure.min)
                 exposure_us = ctrl->exposure.min;
         if (exposure_us > ctrl->exposure.max)
                 exposure_us = ctrl->exposure.max;
 
-        state->vmax = 0;
+        prev = vc_stats_begin(cam, VC_OP_SET_EXPOSURE, &start);
 
-        state->shs = 0;
-        state->exposure_cnt = 0;
-        state->retrigger_cnt = 0;
+        vc_core_calculate_exposure_timing(cam, exposure_us);
 
         if (ctrl->flags & FLAG_EXPOSURE_SONY || ctrl->flags & FLAG_EXPOSURE_NORMAL) {
                 switch (state->trigger_mode) {
                 case REG_TRIGGER_EXTERNAL:
                 case REG_TRIGGER_SINGLE:
                 case REG_TRIGGER_SELF:	
-                        vc_calculate_trig_exposure(cam, exposure_us);
-                        ret |= vc_mod_write_exposure(client_mod, state->exposure_cnt);
+                        if (state->streaming && state->trigger_mode == REG_TRIGGER_SELF &&
+                            ctrl->flags & FLAG_TRIGGER_SELF) {
+                                ret = vc_first_error(ret, vc_mod_write_self_trigger_staged(cam, retrigger_prev));
+                                break;
+                        }
+                        ret = vc_first_error(ret, vc_mod_write_exposure(ctrl, state->exposure_cnt));
                         // NOTE for FLAG_TRIGGER_SELF
                         // - Changing retrigger from bigger to smaller values leads to a hang up of the camera. 
                         // - Changing exposure isn't applied sometimes
+                        // Both are handled by vc_mod_write_self_trigger_staged() in self trigger mode.
                         if (!state->streaming || ctrl->flags & FLAG_TRIGGER_SELF_V2) {
-                                ret |= vc_mod_write_retrigger(client_mod, state->retrigger_cnt);
+                                ret = vc_first_error(ret, vc_mod_write_retrigger(ctrl, state->retrigger_cnt));
                         }
                         break;
                 case REG_TRIGGER_PULSEWIDTH:
@@ -1724,21 +2658,18 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure_us)
                 case REG_TRIGGER_SYNC:
                 case REG_TRIGGER_STREAM_EDGE:
                 case REG_TRIGGER_STREAM_LEVEL:
-                        vc_calculate_exposure(cam, exposure_us);
-                        ret |= vc_sen_write_shs(ctrl, state->shs);
-                        ret |= vc_sen_write_vmax(ctrl, state->vmax);
+                        ret = vc_first_error(ret, vc_sen_write_shs(ctrl, state->shs));
+                        ret = vc_first_error(ret, vc_sen_write_vmax(ctrl, state->vmax));
                 }
         
         } else if (ctrl->flags & FLAG_EXPOSURE_OMNIVISION) {
-                __u32 duration = (((__u64)exposure_us)*ctrl->flash_factor)/1000000;
-
-                vc_calculate_exposure(cam, exposure_us);
-                ret |= vc_sen_write_shs(ctrl, state->shs);
-                ret |= vc_sen_write_vmax(ctrl, state->vmax);
-                ret |= vc_sen_write_flash_duration(ctrl, duration);
-                ret |= vc_sen_write_flash_offset(ctrl, ctrl->flash_toffset);
+                ret = vc_first_error(ret, vc_sen_write_shs(ctrl, state->shs));
+                ret = vc_first_error(ret, vc_sen_write_vmax(ctrl, state->vmax));
+                ret = vc_first_error(ret, vc_sen_write_flash(cam));
         }
 
+        vc_stats_end(cam, prev, start);
+
         if (ret == 0) {
                 cam->state.exposure = exposure_us;
         }
@@ -1747,4 +2678,213 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure_us)
                 __FUNCTION__, state->vmax, state->shs, state->retrigger_cnt, state->exposure_cnt);
 
         return ret;
-}
\ No newline at end of file
+}
+
+
+// ------------------------------------------------------------------------------------------------
+//  Flash (Strobe) Timing
+
+// Returns the exposure time in µs as set by the trigger counts or the sensor timing (SHS/VMAX).
+__u32 vc_core_calculate_exposure_window(struct vc_cam *cam)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        __u32 period_1H_ns = vc_core_calculate_period_1H(cam, state->num_lanes, format);
+        __u32 lines = 0;
+
+        if (state->exposure_cnt && ctrl->clk_ext_trigger) {
+                return ((__u64)state->exposure_cnt * 1000000) / ctrl->clk_ext_trigger;
+        }
+
+        if (ctrl->flags & FLAG_EXPOSURE_SONY) {
+                lines = state->vmax > state->shs ? state->vmax - state->shs : 0;
+        } else {
+                lines = state->shs;
+        }
+        if (lines == 0) {
+                // No timing of its own (e.g. pulse width trigger)
+                return state->exposure;
+        }
+
+        return ((__u64)lines * period_1H_ns) / 1000;
+}
+
+// Modules with strobe timing registers place the flash inside the exposure, the others drive the
+// flash output for the whole exposure.
+int vc_core_has_flash_timing(struct vc_cam *cam)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+
+        return ctrl->csr.sen.flash_duration.l != 0 && ctrl->flash_factor != 0;
+}
+
+// Calculates the flash window in µs relative to the start of the exposure. The window never
+// leaves the exposure, a duration of 0 lasts until its end.
+void vc_core_calculate_flash_window(struct vc_cam *cam, __u32 *offset_us, __u32 *duration_us)
+{
+        struct vc_state *state = &cam->state;
+        __u32 exposure_us = vc_core_calculate_exposure_window(cam);
+
+        if (!vc_core_has_flash_timing(cam)) {
+                *offset_us = 0;
+                *duration_us = exposure_us;
+                return;
+        }
+
+        *offset_us = min(state->flash_offset, exposure_us);
+        *duration_us = exposure_us - *offset_us;
+        if (state->flash_duration && state->flash_duration < *duration_us) {
+                *duration_us = state->flash_duration;
+        }
+}
+
+static int vc_sen_write_flash(struct vc_cam *cam)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        __u32 offset_us, duration_us;
+        __u32 offset, duration;
+        int ret = 0;
+
+        if (!vc_core_has_flash_timing(cam)) {
+                return 0;
+        }
+
+        // The strobe registers count in units of 1/flash_factor s, the offset starts at flash_toffset.
+        vc_core_calculate_flash_window(cam, &offset_us, &duration_us);
+        duration = ((__u64)duration_us * ctrl->flash_factor) / 1000000;
+        offset = ctrl->flash_toffset + ((__u64)offset_us * ctrl->flash_factor) / 1000000;
+
+        ret = vc_first_error(ret, vc_sen_write_flash_duration(ctrl, duration));
+        ret = vc_first_error(ret, vc_sen_write_flash_offset(ctrl, offset));
+
+        return ret;
+}
+
+int vc_sen_set_flash(struct vc_cam *cam, __u32 offset_us, __u32 duration_us)
+{
+        struct vc_state *state = &cam->state;
+        struct device *dev = vc_core_get_sen_device(cam);
+        enum vc_op prev;
+        __u64 start;
+        int ret;
+
+        vc_dbg(dev, "%s(): Set flash (offset: %u us, duration: %u us)\n", __FUNCTION__, offset_us, duration_us);
+
+        if (!vc_core_has_flash_timing(cam)) {
+                vc_err(dev, "%s(): Flash timing not supported by this module!\n", __FUNCTION__);
+                return -EINVAL;
+        }
+
+        state->flash_offset = offset_us;
+        state->flash_duration = duration_us;
+
+        prev = vc_stats_begin(cam, VC_OP_SET_EXPOSURE, &start);
+        ret = vc_sen_write_flash(cam);
+        vc_stats_end(cam, prev, start);
+
+        return ret;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+//  Timing Consistency Check
+
+// Checks the timing of the current state against the invariants of the mode tables. Returns a
+// description of the first violated invariant or NULL.
+const char *vc_core_check_state(struct vc_cam *cam)
+{
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        __u8 format = vc_core_v4l2_code_to_format(state->format_code);
+        vc_control vmax = vc_core_get_vmax(cam, state->num_lanes, format);
+        __u32 retrigger_min = vc_core_get_retrigger(cam, state->num_lanes, format);
+
+        if (vc_core_calculate_period_1H(cam, state->num_lanes, format) == 0)
+                return "no timing (hmax) for lanes and format";
+        if (state->exposure < ctrl->exposure.min || state->exposure > ctrl->exposure.max)
+                return "exposure out of range";
+
+        if ((ctrl->flags & (FLAG_EXPOSURE_SONY | FLAG_EXPOSURE_NORMAL)) &&
+            (state->trigger_mode == REG_TRIGGER_EXTERNAL || state->trigger_mode == REG_TRIGGER_SINGLE ||
+             state->trigger_mode == REG_TRIGGER_SELF)) {
+                if (ctrl->clk_ext_trigger == 0)
+                        return "clk_ext_trigger is 0";
+                if (retrigger_min == 0)
+                        return "retrigger_min is 0";
+                if (state->exposure_cnt == 0)
+                        return "exposure count is 0";
+                // Tolerates the rounding to whole µs of the frame time.
+                if ((ctrl->flags & FLAG_TRIGGER_SELF) && state->trigger_mode == REG_TRIGGER_SELF &&
+                    state->retrigger_cnt + ctrl->clk_ext_trigger / 1000000 < retrigger_min)
+                        return "retrigger count < retrigger_min";
+                return NULL;
+        }
+
+        if (state->vmax == 0 && state->shs == 0)
+                return NULL;    // Pulse width trigger: the exposure is defined by the trigger input
+        if (state->shs < vmax.min)
+                return "SHS < SHS_MIN (vmax.min)";
+        if (state->vmax > vmax.max)
+                return "VMAX > vmax.max";
+        if ((ctrl->flags & FLAG_EXPOSURE_SONY) && state->shs >= state->vmax)
+                return "SHS >= VMAX";
+        if (!(ctrl->flags & FLAG_EXPOSURE_SONY) && state->shs > state->vmax)
+                return "SHS > VMAX";
+
+        return NULL;
+}
+
+// Computes the timing for all combinations of lanes, format and trigger mode of the module, each
+// with the default, minimal and maximal frame rate and a range of exposure times, and reports every
+// violation of the timing invariants. The state of cam is changed, so a copy has to be passed.
+// Returns the number of checked combinations.
+__u32 vc_core_check_timing(struct vc_cam *cam, vc_check_report report, void *priv)
+{
+        struct vc_desc *desc = &cam->desc;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        int is_color = vc_mod_is_color_sensor(desc);
+        int is_gbrg = ctrl->flags & FLAG_FORMAT_GBRG;
+        const char *violation;
+        __u32 framerates[3];
+        __u32 exposure, count = 0;
+        int index, trigger, rate;
+
+        for (index = 0; index < desc->num_modes && index < ARRAY_SIZE(desc->modes); index++) {
+                struct vc_desc_mode *mode = &desc->modes[index];
+
+                state->num_lanes = mode->num_lanes;
+                state->format_code = vc_core_format_to_v4l2_code(mode->format, is_color, is_gbrg);
+
+                for (trigger = 0; trigger <= 7; trigger++) {
+                        if (!vc_mod_is_trigger_mode_supported(cam, trigger))
+                                continue;
+                        vc_mod_set_trigger_mode(cam, trigger);
+
+                        framerates[0] = 0;
+                        framerates[1] = ctrl->framerate.min;
+                        framerates[2] = ctrl->framerate.max;
+                        for (rate = 0; rate < ARRAY_SIZE(framerates); rate++) {
+                                state->framerate = framerates[rate];
+
+                                // Exposure times from the minimum in steps of factor 4 up to the maximum
+                                exposure = ctrl->exposure.min;
+                                while (1) {
+                                        state->exposure = exposure;
+                                        vc_core_calculate_exposure_timing(cam, exposure);
+                                        violation = vc_core_check_state(cam);
+                                        if (violation)
+                                                report(priv, cam, violation);
+                                        count++;
+
+                                        if (exposure >= ctrl->exposure.max)
+                                                break;
+                                        exposure = min_t(__u64, (__u64)max(exposure, 1U) * 4, ctrl->exposure.max);
+                                }
+                        }
+                }
+        }
+
+        return count;
+}
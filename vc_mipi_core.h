@@ -5,6 +5,7 @@
 
 #include <linux/types.h>
 #include <linux/i2c.h>
+#include <linux/mutex.h>
 #include <linux/videodev2.h>
 
 #define vc_dbg(dev, fmt, ...) dev_dbg(dev, fmt, ##__VA_ARGS__)
@@ -35,12 +36,21 @@
 #define FLAG_TRIGGER_SLAVE              (1 << 17)
 
 #define FLAG_PREGIUS_S                  (1 << 18)
+#define FLAG_GENERIC                    (1 << 19)       // Driven by the descriptor, timing estimated
 
 #define FORMAT_RAW08                    0x2a
 #define FORMAT_RAW10                    0x2b
 #define FORMAT_RAW12                    0x2c
 #define FORMAT_RAW14                    0x2d
 
+#define MODE_TYPE_STREAM                0x01
+#define MODE_TYPE_TRIGGER               0x02
+#define MODE_TYPE_SLAVE                 0x03
+
+// Analogue gain models (conversion of the gain register value x into a linear gain)
+#define GAIN_MODEL_LINEAR               0       // gain = (m0 * x + c0) / (m1 * x + c1)
+#define GAIN_MODEL_DB                   1       // gain = 10^(x * step / 20), step in 0.001 dB
+
 
 struct vc_desc_mode {
         __u8 data_rate[4];
@@ -100,6 +110,14 @@ typedef struct vc_control {
         __u32 def;
 } vc_control;
 
+typedef struct vc_gain_model {
+        __u8 type;
+        __s32 m0;                       // GAIN_MODEL_DB: step in 0.001 dB
+        __s32 c0;
+        __s32 m1;
+        __s32 c1;
+} vc_gain_model;
+
 typedef struct vc_frame {
         __u32 left;
         __u32 top;
@@ -142,6 +160,8 @@ struct vc_csr {
         struct vc_sen_csr sen;
 };
 
+#define VC_MAX_MODES                    8
+
 typedef struct vc_mode {
         __u8       num_lanes;
         __u8       format;
@@ -151,16 +171,31 @@ typedef struct vc_mode {
         __u32      retrigger_min;
 } vc_mode;
 
+struct vc_module;
+struct gpio_desc;
+
 struct vc_ctrl {
         // Communication
         int mod_i2c_addr;
         struct i2c_client *client_sen;
         struct i2c_client *client_mod;
+        // Address assignment at probe (see vc_mod_assign_addr())
+        __u8 mod_i2c_addr_target;       // 0: The module keeps its default address
+        struct gpio_desc *reset_gpio;   // Holds the module in reset until it is probed (optional)
+        // Module database entry and its modes (see vc_mipi_modules.c)
+        const struct vc_module *mod;
+        const struct vc_mode *mode;     // VC_MAX_MODES entries
         // Controls
-        struct vc_mode mode[8];
         struct vc_control exposure;
         struct vc_control gain;
         struct vc_control framerate;
+        struct vc_gain_model gain_model;
+        // Sensor timing (computed from the active mode)
+        struct vc_control exposure_lines;
+        struct vc_control vblank;       // Lines
+        struct vc_control hblank;       // Pixel
+        __u64 pixel_rate;               // Hz
+        __u64 link_freq;                // Hz
         // Modes & Frame Formats
         struct vc_frame frame;          // Pixel
         // Control and status registers
@@ -175,6 +210,25 @@ struct vc_ctrl {
         __u32 flags;
 };
 
+// Stream state machine, see vc_core_set_stream_state()
+enum vc_stream_state {
+        VC_STREAM_OFF,                  // Module mode and sensor not programmed for the next start
+        VC_STREAM_STANDBY,              // Module mode set and sensor programmed, sensor in standby
+        VC_STREAM_STREAMING,            // Streaming, free running
+        VC_STREAM_ARMED,                // Streaming, the module waits for triggers (or the sync of its master)
+        VC_STREAM_STATE_NUM
+};
+
+#define VC_HW_UNKNOWN                   -1
+
+// Register values last written by the stream state machine, VC_HW_UNKNOWN after a module reset or
+// a failed write.
+struct vc_hw_state {
+        int sen_mode;
+        int io_mode;
+        int trigger_mode;
+};
+
 struct vc_state {
         __u8 mode;
         __u32 vmax;
@@ -185,30 +239,162 @@ struct vc_state {
         __u32 exposure_cnt;
         __u32 retrigger_cnt;
         __u32 framerate;
+        __u32 vblank;                   // Lines (0: not set)
         __u32 format_code;
         struct vc_frame frame;          // Pixel
         __u8 num_lanes;
         __u8 io_mode;
         __u8 trigger_mode;
         int power_on;
-        int streaming;
+        int streaming;                  // Stream state is VC_STREAM_STREAMING or VC_STREAM_ARMED
+        enum vc_stream_state stream_state;
+        int stream_changed;             // Settings changed while streaming
+        struct vc_hw_state hw;
+        __u32 flash_offset;             // µs after the start of the exposure
+        __u32 flash_duration;           // µs, 0: until the end of the exposure
         __u8 flags;
 };
 
+// High level operations for which the I2C traffic is accounted separately
+enum vc_op {
+        VC_OP_OTHER,
+        VC_OP_SET_EXPOSURE,
+        VC_OP_SET_GAIN,
+        VC_OP_SET_ROI,
+        VC_OP_START_STREAM,
+        VC_OP_STOP_STREAM,
+        VC_OP_MODE_RESET,
+        VC_OP_DESC_LOAD,
+        VC_OP_NUM
+};
+
+#define VC_STATS_HIST_SIZE              24      // log2 buckets: [0] < 1 µs, [n] < 2^n µs
+
+typedef struct vc_op_stats {
+        __u32 calls;
+        __u32 transactions;
+        __u64 bytes;
+        __u32 errors;
+        __u32 retries;
+        __u64 total_ns;
+        __u64 max_ns;
+        __u32 hist[VC_STATS_HIST_SIZE]; // Latency of the calls
+} vc_op_stats;
+
+struct vc_stats {
+        enum vc_op op;                  // Operation the I2C traffic is accounted to
+        struct vc_op_stats ops[VC_OP_NUM];
+        // Failed transactions by cause (incl. retried ones) and their outcome
+        __u32 naks;
+        __u32 timeouts;
+        __u32 other_errors;
+        __u32 recovered;                // Transactions that succeeded after a retry
+        __u32 failed;                   // Transactions that failed after all retries
+        __u32 injected;                 // Faults injected by the policy
+};
+
+#define VC_I2C_RETRIES                  3       // Default retries after a transient error
+#define VC_I2C_RETRY_DELAY_US           50      // Default backoff, doubled with every retry
+#define VC_I2C_FAULT_TIMEOUT_US         1000    // Default bus time of an injected timeout
+
+// Error handling of the I2C transactions, adjustable via debugfs
+struct vc_i2c_policy {
+        __u32 retries;
+        __u32 retry_delay_us;
+        __u32 fault_nak;                // Injected NAKs per 1000 transactions
+        __u32 fault_timeout;            // Injected timeouts per 1000 transactions
+        __u32 fault_timeout_us;
+};
+
+// Phases of a stream on/off sequence
+enum vc_phase {
+        VC_PHASE_STOP_STREAM,
+        VC_PHASE_SET_MODE,
+        VC_PHASE_SET_ROI,
+        VC_PHASE_SET_EXPOSURE,
+        VC_PHASE_SET_GAIN,
+        VC_PHASE_SET_BLACKLEVEL,
+        VC_PHASE_START_STREAM,
+        VC_PHASE_NUM
+};
+
+#define VC_STREAM_LOG_SIZE              16
+#define VC_STREAM_PREPARE               2
+
+typedef struct vc_stream_event {
+        __u64 timestamp;                // ns (ktime_get_ns)
+        __u64 last;                     // ns, end of the previous phase
+        __u64 total_ns;
+        __u32 phase_ns[VC_PHASE_NUM];
+        int enable;                     // 0: off, 1: on, VC_STREAM_PREPARE: prepared ahead of the start
+        int reset;                      // 1: module has been reset
+        int ret;
+} vc_stream_event;
+
+struct vc_stream_log {
+        __u32 count;                    // Number of completed events
+        struct vc_stream_event events[VC_STREAM_LOG_SIZE];
+};
+
+#define VC_CAPTURE_SIZE                 65536   // Register transactions per capture session
+#define VC_CAPTURE_READ                 0x01
+
+typedef struct vc_capture_entry {
+        __u64 timestamp;                // ns (ktime_get_ns)
+        __u32 duration_ns;
+        __u16 addr;
+        __u8 client;
+        __u8 value;
+        __s16 ret;
+        __u8 op;                        // enum vc_op
+        __u8 flags;                     // VC_CAPTURE_READ
+} vc_capture_entry;
+
+struct vc_capture {
+        struct mutex lock;
+        int enabled;
+        __u32 count;
+        __u32 dropped;                  // Transactions that didn't fit into the buffer
+        struct vc_capture_entry *entries;
+};
+
+struct dentry;
+struct vc_cam;
+struct vc_group_member;
+struct vc_trigger;
+
+typedef void (*vc_check_report)(void *priv, struct vc_cam *cam, const char *violation);
+
 struct vc_cam {
+        struct mutex *lock;             // Serialises the operations on the camera (the control handler lock)
         struct vc_desc desc;
         struct vc_ctrl ctrl;
         struct vc_state state;
+        struct vc_stats stats;
+        struct vc_i2c_policy i2c;
+        struct vc_stream_log stream_log;
+        struct vc_capture capture;
+        struct dentry *debugfs;
+        struct vc_group_member *group;  // Sync group (see vc_mipi_group.c), NULL: none
+        struct vc_trigger *trigger;     // Trigger generator (see vc_mipi_trigger.c), NULL: none
 };
 
+// Keeps the first error of a sequence of operations (OR-ing error codes results in a wrong code).
+static inline int vc_first_error(int ret, int next)
+{
+        return ret ? ret : next;
+}
+
 // --- Helper functions to allow i2c communication for customization ----------
 int vc_read_i2c_reg(struct i2c_client *client, const __u16 addr);
 int vc_write_i2c_reg(struct i2c_client *client, const __u16 addr, const __u8 value);
 
 // --- Helper functions for internal data structures --------------------------
-void vc_core_print_debug(struct vc_cam *cam);
 struct device *vc_core_get_sen_device(struct vc_cam *cam);
 struct device *vc_core_get_mod_device(struct vc_cam *cam);
+int vc_core_get_sensor_name(struct vc_cam *cam, char *buf, size_t size);
+__u32 vc_core_format_to_v4l2_code(__u8 format, int is_color, int is_gbrg);
+int vc_core_enum_format(struct vc_cam *cam, __u32 index, __u32 *code);
 int vc_core_try_format(struct vc_cam *cam, __u32 code);
 int vc_core_set_format(struct vc_cam *cam, __u32 code);
 __u32 vc_core_get_format(struct vc_cam *cam);
@@ -221,14 +407,45 @@ __u32 vc_core_get_framerate(struct vc_cam *cam);
 vc_control vc_core_get_vmax(struct vc_cam *cam, __u8 num_lanes, __u8 format);
 vc_control vc_core_get_blacklevel(struct vc_cam *cam, __u8 num_lanes, __u8 format);
 __u32 vc_core_get_retrigger(struct vc_cam *cam, __u8 num_lanes, __u8 format);
+__u8 vc_core_get_bits_per_pixel(__u8 format);
+__u64 vc_core_get_mode_link_freq(struct vc_desc_mode *mode);
+__u32 vc_core_calculate_max_exposure(struct vc_cam *cam, __u8 num_lanes, __u8 format);
+__u32 vc_core_calculate_max_frame_rate(struct vc_cam *cam, __u8 num_lanes, __u8 format);
+void vc_core_get_frame_timing(struct vc_cam *cam, __u32 *vblank, __u32 *framerate);
+__u32 vc_core_calculate_min_trigger_period(struct vc_cam *cam);
+__u32 vc_core_calculate_exposure_window(struct vc_cam *cam);
+int vc_core_has_flash_timing(struct vc_cam *cam);
+void vc_core_calculate_flash_window(struct vc_cam *cam, __u32 *offset_us, __u32 *duration_us);
+int vc_core_set_vblank(struct vc_cam *cam, __u32 vblank);
+int vc_core_set_exposure_lines(struct vc_cam *cam, __u32 lines);
+__u32 vc_core_get_exposure_lines(struct vc_cam *cam);
+const char *vc_core_get_op_name(enum vc_op op);
+void vc_core_reset_stats(struct vc_cam *cam);
+const char *vc_core_get_phase_name(enum vc_phase phase);
+struct vc_stream_event *vc_core_begin_stream_event(struct vc_cam *cam, int enable);
+void vc_core_mark_stream_phase(struct vc_stream_event *event, enum vc_phase phase);
+void vc_core_end_stream_event(struct vc_cam *cam, struct vc_stream_event *event, int reset, int ret);
+const char *vc_core_get_stream_state_name(enum vc_stream_state stream_state);
+int vc_core_is_stream_current(struct vc_cam *cam);
+int vc_core_prepare_stream(struct vc_cam *cam, struct vc_stream_event *event, int *reset);
+int vc_core_start_capture(struct vc_cam *cam);
+void vc_core_stop_capture(struct vc_cam *cam);
+void vc_core_free_capture(struct vc_cam *cam);
+void vc_core_calculate_exposure_timing(struct vc_cam *cam, __u32 exposure_us);
+const char *vc_core_check_state(struct vc_cam *cam);
+__u32 vc_core_check_timing(struct vc_cam *cam, vc_check_report report, void *priv);
 
 // --- Function to initialize the vc core --------------------------------------
 int vc_core_init(struct vc_cam *cam, struct i2c_client *client);
+void vc_core_free(struct vc_cam *cam);
 int vc_core_update_controls(struct vc_cam *cam);
 
 // --- Functions for the VC MIPI Controller Module ----------------------------
 int vc_mod_set_mode(struct vc_cam *cam, int *reset);
 int vc_mod_is_trigger_enabled(struct vc_cam *cam);
+int vc_mod_is_sync_slave(struct vc_cam *cam);
+int vc_mod_is_single_trigger(struct vc_cam *cam);
+int vc_mod_is_trigger_mode_supported(struct vc_cam *cam, int mode);
 int vc_mod_set_trigger_mode(struct vc_cam *cam, int mode);
 int vc_mod_get_trigger_mode(struct vc_cam *cam);
 int vc_mod_set_single_trigger(struct vc_cam *cam);
@@ -239,6 +456,7 @@ int vc_mod_get_io_mode(struct vc_cam *cam);
 // --- Functions for the VC MIPI Sensors --------------------------------------
 int vc_sen_set_roi(struct vc_cam *cam);
 int vc_sen_set_exposure(struct vc_cam *cam, int exposure);
+int vc_sen_set_flash(struct vc_cam *cam, __u32 offset_us, __u32 duration_us);
 int vc_sen_set_gain(struct vc_cam *cam, int gain);
 
 //int vc_sen_set_blacklevel(struct vc_cam *cam, int blacklevel);
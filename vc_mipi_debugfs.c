@@ -0,0 +1,501 @@
+#include "vc_mipi_debugfs.h"
+#include "vc_mipi_group.h"
+#include "vc_mipi_trigger.h"
+#include "vc_mipi_modules.h"
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+// Layout: <debugfs>/vc_mipi/<i2c device>/{stats,stream_log,stream_state,desc,modes,limits,check,capture,group,trigger,i2c/}
+static struct dentry *vc_debugfs_root;
+
+// ------------------------------------------------------------------------------------------------
+//  stats: I2C traffic and latency per operation. Any write resets the counters.
+
+static int vc_debugfs_stats_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_op_stats *stats;
+        int op, i;
+
+        seq_printf(s, "%-14s %8s %12s %12s %8s %8s %14s %12s  %s\n", "op", "calls", "transactions",
+                "bytes", "errors", "retries", "total_ns", "max_ns", "hist_log2_us");
+
+        for (op = 0; op < VC_OP_NUM; op++) {
+                stats = &cam->stats.ops[op];
+                seq_printf(s, "%-14s %8u %12u %12llu %8u %8u %14llu %12llu ", vc_core_get_op_name(op),
+                        stats->calls, stats->transactions, stats->bytes, stats->errors, stats->retries,
+                        stats->total_ns, stats->max_ns);
+                for (i = 0; i < VC_STATS_HIST_SIZE; i++)
+                        seq_printf(s, " %u", stats->hist[i]);
+                seq_putc(s, '\n');
+        }
+
+        seq_printf(s, "\nerrors: nak %u, timeout %u, other %u, recovered %u, failed %u, injected %u\n",
+                cam->stats.naks, cam->stats.timeouts, cam->stats.other_errors, cam->stats.recovered,
+                cam->stats.failed, cam->stats.injected);
+
+        return 0;
+}
+
+static int vc_debugfs_stats_open(struct inode *inode, struct file *file)
+{
+        return single_open(file, vc_debugfs_stats_show, inode->i_private);
+}
+
+static ssize_t vc_debugfs_stats_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+        struct seq_file *s = file->private_data;
+
+        vc_core_reset_stats(s->private);
+
+        return count;
+}
+
+static const struct file_operations vc_debugfs_stats_fops = {
+        .owner = THIS_MODULE,
+        .open = vc_debugfs_stats_open,
+        .read = seq_read,
+        .write = vc_debugfs_stats_write,
+        .llseek = seq_lseek,
+        .release = single_release,
+};
+
+// ------------------------------------------------------------------------------------------------
+//  stream_log: Latency breakdown of the last stream on/off events (oldest first)
+
+static int vc_debugfs_stream_log_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_stream_log *log = &cam->stream_log;
+        struct vc_stream_event *event;
+        __u32 first = log->count > VC_STREAM_LOG_SIZE ? log->count - VC_STREAM_LOG_SIZE : 0;
+        __u32 seq;
+        int phase;
+
+        seq_printf(s, "%8s %6s %5s %5s %16s %12s", "seq", "stream", "reset", "ret", "timestamp_ns", "total_ns");
+        for (phase = 0; phase < VC_PHASE_NUM; phase++)
+                seq_printf(s, " %s", vc_core_get_phase_name(phase));
+        seq_putc(s, '\n');
+
+        for (seq = first; seq < log->count; seq++) {
+                event = &log->events[seq % VC_STREAM_LOG_SIZE];
+                seq_printf(s, "%8u %6s %5d %5d %16llu %12llu", seq,
+                        event->enable == VC_STREAM_PREPARE ? "prep" : event->enable ? "on" : "off",
+                        event->reset, event->ret, event->timestamp, event->total_ns);
+                for (phase = 0; phase < VC_PHASE_NUM; phase++)
+                        seq_printf(s, " %u", event->phase_ns[phase]);
+                seq_putc(s, '\n');
+        }
+
+        return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_stream_log);
+
+// ------------------------------------------------------------------------------------------------
+//  stream_state: State of the stream state machine and the cached sensor, IO and trigger mode
+//  (-1: unknown, written at the next transition)
+
+static int vc_debugfs_stream_state_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_state *state = &cam->state;
+
+        seq_printf(s, "%-14s %s\n", "state", vc_core_get_stream_state_name(state->stream_state));
+        seq_printf(s, "%-14s %d\n", "sensor_mode", state->hw.sen_mode);
+        seq_printf(s, "%-14s %d\n", "io_mode", state->hw.io_mode);
+        seq_printf(s, "%-14s %d\n", "trigger_mode", state->hw.trigger_mode);
+
+        return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_stream_state);
+
+// ------------------------------------------------------------------------------------------------
+//  desc, modes, limits: Module descriptor and mode tables (one record per line, blank separated)
+
+static void vc_debugfs_print_format(__u8 format, char *buf)
+{
+        switch (format) {
+        case FORMAT_RAW08: strcpy(buf, "RAW08"); break;
+        case FORMAT_RAW10: strcpy(buf, "RAW10"); break;
+        case FORMAT_RAW12: strcpy(buf, "RAW12"); break;
+        case FORMAT_RAW14: strcpy(buf, "RAW14"); break;
+        default: sprintf(buf, "0x%02x", format); break;
+        }
+}
+
+static void vc_debugfs_print_type(__u8 type, char *buf)
+{
+        switch (type) {
+        case MODE_TYPE_STREAM:  strcpy(buf, "STREAM"); break;
+        case MODE_TYPE_TRIGGER: strcpy(buf, "EXT.TRG"); break;
+        case MODE_TYPE_SLAVE:   strcpy(buf, "SLAVE"); break;
+        default: sprintf(buf, "0x%02x", type); break;
+        }
+}
+
+#define SHOW_STR(name) seq_printf(s, "%-20s %.*s\n", #name, (int)sizeof(desc->name), desc->name)
+#define SHOW_HEX(name) seq_printf(s, "%-20s 0x%04x\n", #name, desc->name)
+#define SHOW_DEC(name) seq_printf(s, "%-20s %u\n", #name, desc->name)
+
+static int vc_debugfs_desc_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_desc *desc = &cam->desc;
+
+        SHOW_STR(manuf);
+        SHOW_HEX(manuf_id);
+        SHOW_STR(sen_manuf);
+        SHOW_STR(sen_type);
+        SHOW_HEX(mod_id);
+        SHOW_DEC(mod_rev);
+        SHOW_HEX(chip_id_high);
+        SHOW_HEX(chip_id_low);
+        SHOW_HEX(chip_rev);
+        SHOW_HEX(csr_mode);
+        SHOW_HEX(csr_h_start_h);
+        SHOW_HEX(csr_h_start_l);
+        SHOW_HEX(csr_v_start_h);
+        SHOW_HEX(csr_v_start_l);
+        SHOW_HEX(csr_h_end_h);
+        SHOW_HEX(csr_h_end_l);
+        SHOW_HEX(csr_v_end_h);
+        SHOW_HEX(csr_v_end_l);
+        SHOW_HEX(csr_o_width_h);
+        SHOW_HEX(csr_o_width_l);
+        SHOW_HEX(csr_o_height_h);
+        SHOW_HEX(csr_o_height_l);
+        SHOW_HEX(csr_exposure_h);
+        SHOW_HEX(csr_exposure_m);
+        SHOW_HEX(csr_exposure_l);
+        SHOW_HEX(csr_gain_h);
+        SHOW_HEX(csr_gain_l);
+        SHOW_DEC(clk_ext_trigger);
+        SHOW_DEC(clk_pixel);
+        SHOW_DEC(shutter_offset);
+        SHOW_DEC(num_modes);
+        SHOW_DEC(bytes_per_mode);
+        seq_printf(s, "%-20s %s\n", "module_table", cam->ctrl.mod->name);
+
+        return 0;
+}
+
+static int vc_debugfs_modes_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_desc *desc = &cam->desc;
+        struct vc_desc_mode *mode;
+        char format[16], type[16];
+        int index;
+
+        seq_printf(s, "%5s %12s %5s %6s %7s %7s\n", "index", "data_rate", "lanes", "format", "type", "binning");
+        for (index = 0; index < desc->num_modes && index < ARRAY_SIZE(desc->modes); index++) {
+                mode = &desc->modes[index];
+                vc_debugfs_print_format(mode->format, format);
+                vc_debugfs_print_type(mode->type, type);
+                seq_printf(s, "%5d %12u %5u %6s %7s %7u\n", index, *(__u32 *)mode->data_rate,
+                        mode->num_lanes, format, type, mode->binning);
+        }
+
+        return 0;
+}
+
+// The limits depend on the current trigger mode and frame size and are computed on each read.
+static int vc_debugfs_limits_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        const struct vc_mode *mode;
+        char format[16];
+        int index;
+
+        seq_printf(s, "%5s %6s %8s %8s %8s %8s %14s %10s %15s %17s\n", "lanes", "format", "vmax_min",
+                "vmax_max", "vmax_def", "hmax", "blacklevel_max", "retrig_min", "exposure_max_us",
+                "framerate_max_mhz");
+        for (index = 0; index < VC_MAX_MODES && ctrl->mode[index].num_lanes != 0; index++) {
+                mode = &ctrl->mode[index];
+                vc_debugfs_print_format(mode->format, format);
+                seq_printf(s, "%5u %6s %8u %8u %8u %8u %14u %10u %15u %17u\n", mode->num_lanes, format,
+                        mode->vmax.min, mode->vmax.max, mode->vmax.def, mode->hmax, mode->blacklevel.max,
+                        mode->retrigger_min,
+                        vc_core_calculate_max_exposure(cam, mode->num_lanes, mode->format),
+                        vc_core_calculate_max_frame_rate(cam, mode->num_lanes, mode->format));
+        }
+
+        return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_desc);
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_modes);
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_limits);
+
+// ------------------------------------------------------------------------------------------------
+//  check: Timing invariants for all modes, trigger modes and exposure times. The computation runs
+//  on a copy of the settings of the camera and doesn't access the module.
+
+struct vc_debugfs_check {
+        struct seq_file *s;
+        __u32 violations;
+};
+
+static void vc_debugfs_check_report(void *priv, struct vc_cam *cam, const char *violation)
+{
+        struct vc_debugfs_check *check = priv;
+        struct vc_state *state = &cam->state;
+
+        check->violations++;
+        seq_printf(check->s, "%5u 0x%04x %7d %9u %10u %8u %8u %10u %10u  %s\n", state->num_lanes, state->format_code,
+                vc_mod_get_trigger_mode(cam), state->framerate, state->exposure, state->vmax, state->shs,
+                state->exposure_cnt, state->retrigger_cnt, violation);
+}
+
+static int vc_debugfs_check_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_debugfs_check check = { .s = s };
+        struct vc_cam *copy;
+        __u32 count;
+
+        copy = kzalloc(sizeof(*copy), GFP_KERNEL);
+        if (copy == NULL)
+                return -ENOMEM;
+
+        // Only the settings are copied, locks and buffers stay with the camera.
+        mutex_lock(cam->lock);
+        copy->desc = cam->desc;
+        copy->ctrl = cam->ctrl;
+        copy->state = cam->state;
+        mutex_unlock(cam->lock);
+
+        seq_printf(s, "%5s %6s %7s %9s %10s %8s %8s %10s %10s  %s\n", "lanes", "code", "trigger",
+                "framerate", "exposure", "vmax", "shs", "expo_cnt", "retrig_cnt", "violation");
+        count = vc_core_check_timing(copy, vc_debugfs_check_report, &check);
+        seq_printf(s, "%u combinations checked, %u violations\n", count, check.violations);
+
+        kfree(copy);
+        return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_check);
+
+// ------------------------------------------------------------------------------------------------
+//  capture: Register transactions of the capture session. Write 1 to start and 0 to stop.
+
+static void *vc_debugfs_capture_get(struct vc_capture *capture, loff_t pos)
+{
+        if (pos == 0)
+                return SEQ_START_TOKEN;
+        if (capture->entries == NULL || pos > capture->count)
+                return NULL;
+        return &capture->entries[pos - 1];
+}
+
+static void *vc_debugfs_capture_start(struct seq_file *s, loff_t *pos)
+{
+        struct vc_cam *cam = s->private;
+
+        mutex_lock(&cam->capture.lock);
+        return vc_debugfs_capture_get(&cam->capture, *pos);
+}
+
+static void *vc_debugfs_capture_next(struct seq_file *s, void *v, loff_t *pos)
+{
+        struct vc_cam *cam = s->private;
+
+        (*pos)++;
+        return vc_debugfs_capture_get(&cam->capture, *pos);
+}
+
+static void vc_debugfs_capture_stop(struct seq_file *s, void *v)
+{
+        struct vc_cam *cam = s->private;
+
+        mutex_unlock(&cam->capture.lock);
+}
+
+static int vc_debugfs_capture_show(struct seq_file *s, void *v)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_capture_entry *entry = v;
+
+        if (v == SEQ_START_TOKEN) {
+                seq_printf(s, "# vc_mipi capture: %s, transactions: %u, dropped: %u\n",
+                        cam->capture.enabled ? "running" : "stopped", cam->capture.count, cam->capture.dropped);
+                seq_printf(s, "# timestamp_ns duration_ns op rw client addr value ret\n");
+                return 0;
+        }
+
+        seq_printf(s, "%llu %u %s %c 0x%02x 0x%04x 0x%02x %d\n", entry->timestamp, entry->duration_ns,
+                vc_core_get_op_name(entry->op), (entry->flags & VC_CAPTURE_READ) ? 'R' : 'W',
+                entry->client, entry->addr, entry->value, entry->ret);
+        return 0;
+}
+
+static const struct seq_operations vc_debugfs_capture_sops = {
+        .start = vc_debugfs_capture_start,
+        .next = vc_debugfs_capture_next,
+        .stop = vc_debugfs_capture_stop,
+        .show = vc_debugfs_capture_show,
+};
+
+static int vc_debugfs_capture_open(struct inode *inode, struct file *file)
+{
+        int ret;
+
+        ret = seq_open(file, &vc_debugfs_capture_sops);
+        if (ret)
+                return ret;
+
+        ((struct seq_file *)file->private_data)->private = inode->i_private;
+        return 0;
+}
+
+static ssize_t vc_debugfs_capture_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+        struct seq_file *s = file->private_data;
+        bool enable;
+        int ret;
+
+        ret = kstrtobool_from_user(buf, count, &enable);
+        if (ret)
+                return ret;
+
+        if (enable) {
+                ret = vc_core_start_capture(s->private);
+                if (ret)
+                        return ret;
+        } else {
+                vc_core_stop_capture(s->private);
+        }
+
+        return count;
+}
+
+static const struct file_operations vc_debugfs_capture_fops = {
+        .owner = THIS_MODULE,
+        .open = vc_debugfs_capture_open,
+        .read = seq_read,
+        .write = vc_debugfs_capture_write,
+        .llseek = seq_lseek,
+        .release = seq_release,
+};
+
+// ------------------------------------------------------------------------------------------------
+//  group: State of the sync group and the timing of its last start
+
+static int vc_debugfs_group_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_group *group = cam->group->group;
+        struct vc_group_member *member;
+
+        mutex_lock(&group->lock);
+        seq_printf(s, "%-14s %u\n", "group", group->id);
+        seq_printf(s, "%-14s %d\n", "streaming", group->streaming);
+        seq_printf(s, "%-14s %llu\n", "prepare_ns", group->prepare_ns);
+        seq_printf(s, "%-14s %llu\n", "start_skew_ns", group->start_skew_ns);
+        list_for_each_entry(member, &group->members, entry) {
+                seq_printf(s, "%-14s %s %s%s\n", "member", dev_name(vc_core_get_sen_device(member->cam)),
+                        vc_mod_is_sync_slave(member->cam) ? "slave" : "master",
+                        member->armed ? " armed" : "");
+        }
+        mutex_unlock(&group->lock);
+
+        return 0;
+}
+
+static int vc_debugfs_group_open(struct inode *inode, struct file *file)
+{
+        return single_open(file, vc_debugfs_group_show, inode->i_private);
+}
+
+static const struct file_operations vc_debugfs_group_fops = {
+        .owner = THIS_MODULE,
+        .open = vc_debugfs_group_open,
+        .read = seq_read,
+        .llseek = seq_lseek,
+        .release = single_release,
+};
+
+// ------------------------------------------------------------------------------------------------
+//  trigger: State of the trigger generator and the timing of the triggers since its last start
+
+static int vc_debugfs_trigger_show(struct seq_file *s, void *unused)
+{
+        struct vc_cam *cam = s->private;
+        struct vc_trigger_stats stats;
+        __u32 period_us, count;
+        int running;
+
+        vc_trigger_get_stats(cam, &stats, &running, &period_us, &count);
+        if (stats.triggers == 0)
+                stats.latency_min_ns = 0;
+        if (stats.triggers < 2)
+                stats.interval_min_ns = 0;
+
+        seq_printf(s, "%-16s %d\n", "running", running);
+        seq_printf(s, "%-16s %u\n", "period_us", period_us);
+        seq_printf(s, "%-16s %u\n", "count", count);
+        seq_printf(s, "%-16s %u\n", "min_period_us", vc_core_calculate_min_trigger_period(cam));
+        seq_printf(s, "%-16s %u\n", "triggers", stats.triggers);
+        seq_printf(s, "%-16s %u\n", "skipped", stats.skipped);
+        seq_printf(s, "%-16s %u\n", "errors", stats.errors);
+        seq_printf(s, "%-16s %llu %llu %llu\n", "latency_ns", stats.latency_min_ns,
+                stats.triggers ? div_u64(stats.latency_sum_ns, stats.triggers) : 0, stats.latency_max_ns);
+        seq_printf(s, "%-16s %llu\n", "jitter_ns", stats.latency_max_ns - stats.latency_min_ns);
+        seq_printf(s, "%-16s %llu %llu\n", "interval_ns", stats.interval_min_ns, stats.interval_max_ns);
+
+        return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(vc_debugfs_trigger);
+
+// ------------------------------------------------------------------------------------------------
+
+void vc_debugfs_init(void)
+{
+        vc_debugfs_root = debugfs_create_dir("vc_mipi", NULL);
+}
+
+void vc_debugfs_exit(void)
+{
+        debugfs_remove_recursive(vc_debugfs_root);
+        vc_debugfs_root = NULL;
+}
+
+void vc_debugfs_add_cam(struct vc_cam *cam, const char *name)
+{
+        struct dentry *dir;
+
+        cam->debugfs = debugfs_create_dir(name, vc_debugfs_root);
+        debugfs_create_file("stats", 0644, cam->debugfs, cam, &vc_debugfs_stats_fops);
+        debugfs_create_file("stream_log", 0444, cam->debugfs, cam, &vc_debugfs_stream_log_fops);
+        debugfs_create_file("stream_state", 0444, cam->debugfs, cam, &vc_debugfs_stream_state_fops);
+        debugfs_create_file("desc", 0444, cam->debugfs, cam, &vc_debugfs_desc_fops);
+        debugfs_create_file("modes", 0444, cam->debugfs, cam, &vc_debugfs_modes_fops);
+        debugfs_create_file("limits", 0444, cam->debugfs, cam, &vc_debugfs_limits_fops);
+        debugfs_create_file("check", 0444, cam->debugfs, cam, &vc_debugfs_check_fops);
+        debugfs_create_file("capture", 0644, cam->debugfs, cam, &vc_debugfs_capture_fops);
+        if (cam->group)
+                debugfs_create_file("group", 0444, cam->debugfs, cam, &vc_debugfs_group_fops);
+        if (cam->trigger)
+                debugfs_create_file("trigger", 0444, cam->debugfs, cam, &vc_debugfs_trigger_fops);
+
+        // I2C retry policy and fault injection (rates per 1000 transactions)
+        dir = debugfs_create_dir("i2c", cam->debugfs);
+        debugfs_create_u32("retries", 0644, dir, &cam->i2c.retries);
+        debugfs_create_u32("retry_delay_us", 0644, dir, &cam->i2c.retry_delay_us);
+        debugfs_create_u32("fault_nak", 0644, dir, &cam->i2c.fault_nak);
+        debugfs_create_u32("fault_timeout", 0644, dir, &cam->i2c.fault_timeout);
+        debugfs_create_u32("fault_timeout_us", 0644, dir, &cam->i2c.fault_timeout_us);
+}
+
+void vc_debugfs_remove_cam(struct vc_cam *cam)
+{
+        debugfs_remove_recursive(cam->debugfs);
+        cam->debugfs = NULL;
+}
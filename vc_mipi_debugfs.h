@@ -0,0 +1,11 @@
+#ifndef _VC_MIPI_DEBUGFS_H
+#define _VC_MIPI_DEBUGFS_H
+
+#include "vc_mipi_core.h"
+
+void vc_debugfs_init(void);
+void vc_debugfs_exit(void);
+void vc_debugfs_add_cam(struct vc_cam *cam, const char *name);
+void vc_debugfs_remove_cam(struct vc_cam *cam);
+
+#endif // _VC_MIPI_DEBUGFS_H
@@ -0,0 +1,574 @@
+// Software emulation of a VC MIPI camera module for hardware-free probing and benchmarking.
+//
+// The module registers a virtual I2C adapter with
+//  - the module controller at 0x10 (registers 0x0100 - 0x0110, descriptor at 0x1000),
+//  - the sensor at sen_addr (register file, reachable while the module is powered and ready)
+// and instantiates a "vc_mipi" client for the sensor, which is bound by the real driver. With
+// mod_addr the client asks the driver to move the module controller (MOD_REG_MOD_ADDR) at probe.
+//
+//   modprobe vc_mipi_emu mod_id=0x0296 bus_hz=400000 latency_us=50
+//   echo 1 > /sys/kernel/debug/vc_mipi_emu/stream     # calls vc_sd_s_stream()
+//   cat /sys/kernel/debug/vc_mipi_emu/stream          # result and duration of the last call
+//   echo "0x00980911 10000" > .../vc_mipi_emu/ctrl    # sets a control (here exposure)
+//   echo "0x300f 1440 1080" > .../vc_mipi_emu/fmt      # sets the active format
+//   cat /sys/kernel/debug/vc_mipi_emu/log             # bus transactions (see tools/vc_mipi_replay)
+
+#include "vc_mipi_core.h"
+#include "vc_mipi_emu.h"
+#include "vc_mipi_modules.h"
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/property.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <media/v4l2-subdev.h>
+
+#define MOD_ADDR                0x10
+#define MOD_REG_BASE            0x0100
+#define MOD_REG_RESET           0x0100
+#define MOD_REG_STATUS          0x0101
+#define MOD_REG_MOD_ADDR        0x0104
+#define MOD_REG_SEN_ADDR        0x0105
+#define MOD_REG_NUM             17      // 0x0100 - 0x0110
+#define MOD_DESC_BASE           0x1000
+
+#define REG_RESET_PWR_DOWN      0x02
+#define REG_STATUS_NO_COM       0x00
+#define REG_STATUS_READY        0x80
+
+static ushort mod_id = MOD_ID_IMX296;
+module_param(mod_id, ushort, 0444);
+MODULE_PARM_DESC(mod_id, "Emulated module (MOD_ID_* of vc_mipi_modules.h, default: 0x0296)");
+
+static bool color;
+module_param(color, bool, 0444);
+MODULE_PARM_DESC(color, "Emulate the color variant of the sensor");
+
+static ushort sen_addr = 0x1a;
+module_param(sen_addr, ushort, 0444);
+MODULE_PARM_DESC(sen_addr, "I2C address of the sensor (default: 0x1a)");
+
+static ushort mod_addr = MOD_ADDR;
+module_param(mod_addr, ushort, 0444);
+MODULE_PARM_DESC(mod_addr, "I2C address the driver moves the module controller to (vc,mod-addr, default: 0x10)");
+
+static uint bus_hz = 400000;
+module_param(bus_hz, uint, 0644);
+MODULE_PARM_DESC(bus_hz, "Emulated bus speed in Hz (0: no bus delay, default: 400000)");
+
+static uint latency_us;
+module_param(latency_us, uint, 0644);
+MODULE_PARM_DESC(latency_us, "Additional latency per transfer in us (default: 0)");
+
+static bool log_probe;
+module_param(log_probe, bool, 0444);
+MODULE_PARM_DESC(log_probe, "Start the transaction log at load time to record the probe sequence");
+
+static uint ready_ms = 200;
+module_param(ready_ms, uint, 0644);
+MODULE_PARM_DESC(ready_ms, "Time from power up until the module reports ready in ms (default: 200)");
+
+struct vc_emu {
+        struct i2c_adapter adapter;
+        struct i2c_client *client_sen;
+        struct mutex lock;
+        struct vc_desc desc;
+        __u8 mod_regs[MOD_REG_NUM];
+        __u16 mod_addr;                 // Current addresses (MOD_REG_MOD_ADDR, MOD_REG_SEN_ADDR)
+        __u16 sen_addr;
+        __u8 *sen_regs;                 // 64k register file
+        ktime_t ready_time;
+        struct dentry *debugfs;
+        int call_ret;
+        __u64 call_ns;
+        // Transaction log (same entries as the driver's register capture)
+        struct vc_capture_entry *log;
+        __u32 log_count;
+        __u32 log_dropped;
+        int log_enabled;
+};
+
+static struct vc_emu *vc_emu;
+
+// ------------------------------------------------------------------------------------------------
+//  Register model
+
+static int vc_emu_is_ready(struct vc_emu *emu)
+{
+        return !(emu->mod_regs[MOD_REG_RESET - MOD_REG_BASE] & REG_RESET_PWR_DOWN) &&
+                !ktime_before(ktime_get(), emu->ready_time);
+}
+
+static int vc_emu_is_present(struct vc_emu *emu, __u16 addr)
+{
+        return addr == emu->mod_addr || (addr == emu->sen_addr && vc_emu_is_ready(emu));
+}
+
+static __u8 vc_emu_read(struct vc_emu *emu, __u16 client, __u16 addr)
+{
+        if (client != emu->mod_addr)
+                return emu->sen_regs[addr];
+
+        if (addr == MOD_REG_STATUS)
+                return vc_emu_is_ready(emu) ? REG_STATUS_READY : REG_STATUS_NO_COM;
+        if (addr >= MOD_REG_BASE && addr < MOD_REG_BASE + MOD_REG_NUM)
+                return emu->mod_regs[addr - MOD_REG_BASE];
+        if (addr >= MOD_DESC_BASE && addr < MOD_DESC_BASE + sizeof(emu->desc))
+                return ((__u8 *)&emu->desc)[addr - MOD_DESC_BASE];
+
+        return 0;
+}
+
+static void vc_emu_write(struct vc_emu *emu, __u16 client, __u16 addr, __u8 value)
+{
+        __u8 *reset = &emu->mod_regs[MOD_REG_RESET - MOD_REG_BASE];
+
+        if (client != emu->mod_addr) {
+                emu->sen_regs[addr] = value;
+                return;
+        }
+
+        if (addr == MOD_REG_RESET) {
+                // The sensor loses its configuration on power down and needs ready_ms after power up.
+                if (value & REG_RESET_PWR_DOWN)
+                        memset(emu->sen_regs, 0, 0x10000);
+                else if (*reset & REG_RESET_PWR_DOWN)
+                        emu->ready_time = ktime_add_ms(ktime_get(), ready_ms);
+        }
+        if (addr >= MOD_REG_BASE && addr < MOD_REG_BASE + MOD_REG_NUM && addr != MOD_REG_STATUS)
+                emu->mod_regs[addr - MOD_REG_BASE] = value;
+        // The module answers at the new addresses from the next message on.
+        if (addr == MOD_REG_MOD_ADDR)
+                emu->mod_addr = value;
+        if (addr == MOD_REG_SEN_ADDR)
+                emu->sen_addr = value;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  I2C adapter
+
+static void vc_emu_log(struct vc_emu *emu, __u16 client, __u16 addr, __u8 value, __u8 flags, int ret)
+{
+        struct vc_capture_entry *entry;
+
+        if (!emu->log_enabled)
+                return;
+        if (emu->log_count == VC_CAPTURE_SIZE) {
+                emu->log_dropped++;
+                return;
+        }
+
+        entry = &emu->log[emu->log_count++];
+        entry->timestamp = ktime_get_ns();
+        entry->duration_ns = 0;
+        entry->addr = addr;
+        entry->client = client;
+        entry->value = value;
+        entry->ret = ret;
+        entry->flags = flags;
+}
+
+static int vc_emu_xfer(struct i2c_adapter *adapter, struct i2c_msg *msgs, int num)
+{
+        struct vc_emu *emu = i2c_get_adapdata(adapter);
+        __u16 addr = 0;
+        __u64 bits = 0;
+        int ret = num;
+        int index, byte;
+
+        mutex_lock(&emu->lock);
+        for (index = 0; index < num; index++) {
+                struct i2c_msg *msg = &msgs[index];
+
+                // (Repeated) start, address and data bytes incl. ACK, stop
+                bits += 1 + (msg->len + 1) * 9 + (index == num - 1);
+
+                if (!vc_emu_is_present(emu, msg->addr)) {
+                        vc_emu_log(emu, msg->addr, addr, 0, (msg->flags & I2C_M_RD) ? VC_CAPTURE_READ : 0, -ENXIO);
+                        ret = -ENXIO;
+                        break;
+                }
+
+                if (msg->flags & I2C_M_RD) {
+                        for (byte = 0; byte < msg->len; byte++) {
+                                msg->buf[byte] = vc_emu_read(emu, msg->addr, addr);
+                                vc_emu_log(emu, msg->addr, addr++, msg->buf[byte], VC_CAPTURE_READ, 0);
+                        }
+                } else if (msg->len >= 2) {
+                        addr = (msg->buf[0] << 8) | msg->buf[1];
+                        for (byte = 2; byte < msg->len; byte++) {
+                                vc_emu_write(emu, msg->addr, addr, msg->buf[byte]);
+                                vc_emu_log(emu, msg->addr, addr++, msg->buf[byte], 0, 0);
+                        }
+                }
+        }
+        mutex_unlock(&emu->lock);
+
+        if (bus_hz || latency_us)
+                fsleep((bus_hz ? DIV_ROUND_UP_ULL(bits * USEC_PER_SEC, bus_hz) : 0) + latency_us);
+
+        return ret;
+}
+
+static u32 vc_emu_functionality(struct i2c_adapter *adapter)
+{
+        return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm vc_emu_algorithm = {
+        .master_xfer = vc_emu_xfer,
+        .functionality = vc_emu_functionality,
+};
+
+// ------------------------------------------------------------------------------------------------
+//  Firmware node of the sensor with a single CSI-2 endpoint (parsed by vc_probe())
+
+static const u32 vc_emu_data_lanes[] = { 1, 2, 3, 4 };
+
+static const struct property_entry vc_emu_endpoint_props[] = {
+        PROPERTY_ENTRY_U32_ARRAY("data-lanes", vc_emu_data_lanes),
+        { }
+};
+
+// vc,mod-addr, set by vc_emu_init() when the module is moved
+static struct property_entry vc_emu_props[2];
+
+static const struct software_node vc_emu_node = {
+        .name = "vc_mipi_emu",
+        .properties = vc_emu_props,
+};
+
+static const struct software_node vc_emu_port = {
+        .name = "port@0",
+        .parent = &vc_emu_node,
+};
+
+static const struct software_node vc_emu_endpoint = {
+        .name = "endpoint@0",
+        .parent = &vc_emu_port,
+        .properties = vc_emu_endpoint_props,
+};
+
+static const struct software_node *vc_emu_nodes[] = {
+        &vc_emu_node,
+        &vc_emu_port,
+        &vc_emu_endpoint,
+        NULL
+};
+
+// ------------------------------------------------------------------------------------------------
+//  debugfs: log (bus transactions in the format of the driver's capture file, write 1/0 to start/stop)
+
+static void *vc_emu_log_get(struct vc_emu *emu, loff_t pos)
+{
+        if (pos == 0)
+                return SEQ_START_TOKEN;
+        if (pos > emu->log_count)
+                return NULL;
+        return &emu->log[pos - 1];
+}
+
+static void *vc_emu_log_start(struct seq_file *s, loff_t *pos)
+{
+        struct vc_emu *emu = s->private;
+
+        mutex_lock(&emu->lock);
+        return vc_emu_log_get(emu, *pos);
+}
+
+static void *vc_emu_log_next(struct seq_file *s, void *v, loff_t *pos)
+{
+        (*pos)++;
+        return vc_emu_log_get(s->private, *pos);
+}
+
+static void vc_emu_log_stop(struct seq_file *s, void *v)
+{
+        struct vc_emu *emu = s->private;
+
+        mutex_unlock(&emu->lock);
+}
+
+static int vc_emu_log_show(struct seq_file *s, void *v)
+{
+        struct vc_emu *emu = s->private;
+        struct vc_capture_entry *entry = v;
+
+        if (v == SEQ_START_TOKEN) {
+                seq_printf(s, "# vc_mipi_emu log: %s, transactions: %u, dropped: %u\n",
+                        emu->log_enabled ? "running" : "stopped", emu->log_count, emu->log_dropped);
+                seq_printf(s, "# timestamp_ns duration_ns op rw client addr value ret\n");
+                return 0;
+        }
+
+        seq_printf(s, "%llu %u bus %c 0x%02x 0x%04x 0x%02x %d\n", entry->timestamp, entry->duration_ns,
+                (entry->flags & VC_CAPTURE_READ) ? 'R' : 'W', entry->client, entry->addr, entry->value,
+                entry->ret);
+        return 0;
+}
+
+static const struct seq_operations vc_emu_log_sops = {
+        .start = vc_emu_log_start,
+        .next = vc_emu_log_next,
+        .stop = vc_emu_log_stop,
+        .show = vc_emu_log_show,
+};
+
+static int vc_emu_log_open(struct inode *inode, struct file *file)
+{
+        int ret;
+
+        ret = seq_open(file, &vc_emu_log_sops);
+        if (ret)
+                return ret;
+
+        ((struct seq_file *)file->private_data)->private = inode->i_private;
+        return 0;
+}
+
+static ssize_t vc_emu_log_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+        struct vc_emu *emu = ((struct seq_file *)file->private_data)->private;
+        bool enable;
+        int ret;
+
+        ret = kstrtobool_from_user(buf, count, &enable);
+        if (ret)
+                return ret;
+
+        mutex_lock(&emu->lock);
+        if (enable) {
+                emu->log_count = 0;
+                emu->log_dropped = 0;
+        }
+        emu->log_enabled = enable;
+        mutex_unlock(&emu->lock);
+
+        return count;
+}
+
+static const struct file_operations vc_emu_log_fops = {
+        .owner = THIS_MODULE,
+        .open = vc_emu_log_open,
+        .read = seq_read,
+        .write = vc_emu_log_write,
+        .llseek = seq_lseek,
+        .release = seq_release,
+};
+
+// ------------------------------------------------------------------------------------------------
+//  debugfs: stream, fmt and ctrl call the operations of the bound sensor subdevice. Reading
+//  returns the result and the duration of the last call.
+//
+//   echo 1 > stream                    s_stream(1)
+//   echo "0x300f 1440 1080" > fmt      set_fmt(code, width, height), code 0 keeps the active code
+//   echo "0x00980911 10000" > ctrl     v4l2_ctrl_s_ctrl(id, value)
+
+static struct v4l2_subdev *vc_emu_get_subdev(struct vc_emu *emu)
+{
+        // The driver data of a bound vc_mipi client is its subdevice (see v4l2_i2c_subdev_init()).
+        if (emu->client_sen->dev.driver == NULL)
+                return NULL;
+        return i2c_get_clientdata(emu->client_sen);
+}
+
+static int vc_emu_call_show(struct seq_file *s, void *unused)
+{
+        struct vc_emu *emu = s->private;
+
+        seq_printf(s, "ret: %d, duration: %llu ns\n", emu->call_ret, emu->call_ns);
+        return 0;
+}
+
+static int vc_emu_call_open(struct inode *inode, struct file *file)
+{
+        return single_open(file, vc_emu_call_show, inode->i_private);
+}
+
+enum vc_emu_call {
+        VC_EMU_CALL_STREAM,
+        VC_EMU_CALL_FMT,
+        VC_EMU_CALL_CTRL,
+};
+
+static ssize_t vc_emu_call_write(struct file *file, const char __user *ubuf, size_t count, enum vc_emu_call call)
+{
+        struct vc_emu *emu = ((struct seq_file *)file->private_data)->private;
+        struct device *dev = &emu->client_sen->dev;
+        struct v4l2_subdev_format format = { .which = V4L2_SUBDEV_FORMAT_ACTIVE };
+        struct v4l2_subdev *sd;
+        struct v4l2_ctrl *ctrl;
+        char buf[64];
+        __u32 arg0 = 0, arg1 = 0, arg2 = 0;
+        __u64 start;
+        int ret;
+
+        if (count >= sizeof(buf))
+                return -EINVAL;
+        if (copy_from_user(buf, ubuf, count))
+                return -EFAULT;
+        buf[count] = '\0';
+        if (sscanf(buf, "%i %i %i", &arg0, &arg1, &arg2) < 1)
+                return -EINVAL;
+
+        device_lock(dev);
+        sd = vc_emu_get_subdev(emu);
+        if (sd == NULL) {
+                device_unlock(dev);
+                return -ENODEV;
+        }
+
+        start = ktime_get_ns();
+        switch (call) {
+        case VC_EMU_CALL_STREAM:
+                ret = v4l2_subdev_call(sd, video, s_stream, arg0);
+                break;
+        case VC_EMU_CALL_FMT:
+                if (arg0 == 0) {
+                        ret = v4l2_subdev_call(sd, pad, get_fmt, NULL, &format);
+                        if (ret)
+                                break;
+                        arg0 = format.format.code;
+                }
+                format.format.code = arg0;
+                format.format.width = arg1;
+                format.format.height = arg2;
+                ret = v4l2_subdev_call(sd, pad, set_fmt, NULL, &format);
+                break;
+        default:
+                ctrl = v4l2_ctrl_find(sd->ctrl_handler, arg0);
+                ret = ctrl ? v4l2_ctrl_s_ctrl(ctrl, arg1) : -EINVAL;
+                break;
+        }
+        emu->call_ns = ktime_get_ns() - start;
+        emu->call_ret = ret;
+        device_unlock(dev);
+
+        return ret ? ret : count;
+}
+
+#define VC_EMU_CALL_FOPS(name, call) \
+static ssize_t vc_emu_##name##_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos) \
+{ \
+        return vc_emu_call_write(file, ubuf, count, call); \
+} \
+\
+static const struct file_operations vc_emu_##name##_fops = { \
+        .owner = THIS_MODULE, \
+        .open = vc_emu_call_open, \
+        .read = seq_read, \
+        .write = vc_emu_##name##_write, \
+        .llseek = seq_lseek, \
+        .release = single_release, \
+};
+
+VC_EMU_CALL_FOPS(stream, VC_EMU_CALL_STREAM)
+VC_EMU_CALL_FOPS(fmt, VC_EMU_CALL_FMT)
+VC_EMU_CALL_FOPS(ctrl, VC_EMU_CALL_CTRL)
+
+// ------------------------------------------------------------------------------------------------
+
+static int __init vc_emu_init(void)
+{
+        struct i2c_board_info info = {
+                I2C_BOARD_INFO("vc_mipi", 0),
+                .swnode = &vc_emu_node,
+        };
+        struct vc_emu *emu;
+        int ret;
+
+        emu = kzalloc(sizeof(*emu), GFP_KERNEL);
+        if (!emu)
+                return -ENOMEM;
+
+        emu->sen_regs = vzalloc(0x10000);
+        emu->log = vzalloc(VC_CAPTURE_SIZE * sizeof(*emu->log));
+        if (!emu->sen_regs || !emu->log) {
+                ret = -ENOMEM;
+                goto free_regs;
+        }
+        emu->log_enabled = log_probe;
+
+        ret = vc_emu_init_desc(&emu->desc, mod_id, color);
+        if (ret) {
+                pr_err("vc_mipi_emu: Module id 0x%04x is not supported\n", mod_id);
+                goto free_regs;
+        }
+
+        mutex_init(&emu->lock);
+        emu->ready_time = ktime_get();
+        emu->mod_addr = MOD_ADDR;
+        emu->sen_addr = sen_addr;
+        emu->mod_regs[MOD_REG_MOD_ADDR - MOD_REG_BASE] = MOD_ADDR;
+        emu->mod_regs[MOD_REG_SEN_ADDR - MOD_REG_BASE] = sen_addr;
+        if (mod_addr != MOD_ADDR)
+                vc_emu_props[0] = PROPERTY_ENTRY_U32("vc,mod-addr", mod_addr);
+
+        emu->adapter.owner = THIS_MODULE;
+        emu->adapter.algo = &vc_emu_algorithm;
+        strscpy(emu->adapter.name, "vc_mipi_emu", sizeof(emu->adapter.name));
+        i2c_set_adapdata(&emu->adapter, emu);
+        ret = i2c_add_adapter(&emu->adapter);
+        if (ret)
+                goto free_regs;
+
+        ret = software_node_register_node_group(vc_emu_nodes);
+        if (ret)
+                goto del_adapter;
+
+        info.addr = sen_addr;
+        emu->client_sen = i2c_new_client_device(&emu->adapter, &info);
+        if (IS_ERR(emu->client_sen)) {
+                ret = PTR_ERR(emu->client_sen);
+                goto unregister_nodes;
+        }
+
+        emu->debugfs = debugfs_create_dir("vc_mipi_emu", NULL);
+        debugfs_create_file("log", 0644, emu->debugfs, emu, &vc_emu_log_fops);
+        debugfs_create_file("stream", 0644, emu->debugfs, emu, &vc_emu_stream_fops);
+        debugfs_create_file("fmt", 0644, emu->debugfs, emu, &vc_emu_fmt_fops);
+        debugfs_create_file("ctrl", 0644, emu->debugfs, emu, &vc_emu_ctrl_fops);
+
+        pr_info("vc_mipi_emu: Emulating %s (0x%04x) on i2c-%d with %u modes\n", emu->desc.sen_type,
+                mod_id, i2c_adapter_id(&emu->adapter), emu->desc.num_modes);
+
+        vc_emu = emu;
+        return 0;
+
+unregister_nodes:
+        software_node_unregister_node_group(vc_emu_nodes);
+del_adapter:
+        i2c_del_adapter(&emu->adapter);
+free_regs:
+        vfree(emu->log);
+        vfree(emu->sen_regs);
+        kfree(emu);
+        return ret;
+}
+
+static void __exit vc_emu_exit(void)
+{
+        struct vc_emu *emu = vc_emu;
+
+        debugfs_remove_recursive(emu->debugfs);
+        i2c_unregister_device(emu->client_sen);
+        i2c_del_adapter(&emu->adapter);
+        software_node_unregister_node_group(vc_emu_nodes);
+        vfree(emu->log);
+        vfree(emu->sen_regs);
+        kfree(emu);
+}
+
+module_init(vc_emu_init);
+module_exit(vc_emu_exit);
+
+MODULE_DESCRIPTION("Vision Components GmbH - VC MIPI module emulator");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,9 @@
+#ifndef _VC_MIPI_EMU_H
+#define _VC_MIPI_EMU_H
+
+#include "vc_mipi_core.h"
+
+// Builds the descriptor the module mod_id reports at 0x1000. Returns -EINVAL for unknown modules.
+int vc_emu_init_desc(struct vc_desc *desc, __u16 mod_id, int color);
+
+#endif // _VC_MIPI_EMU_H
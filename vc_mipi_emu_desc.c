@@ -0,0 +1,128 @@
+// Descriptors of the emulated modules, shared by the module emulator (vc_mipi_emu.c) and the KUnit
+// tests (vc_mipi_test.c). The modes (lanes x formats x stream/trigger) match the MODE() tables of
+// vc_mipi_modules.c. The sensor register addresses in the descriptor are placeholders.
+
+#include "vc_mipi_emu.h"
+#include "vc_mipi_modules.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#define LANES_1                 (1 << 0)
+#define LANES_2                 (1 << 1)
+#define LANES_4                 (1 << 2)
+#define RAW08                   (1 << 0)
+#define RAW10                   (1 << 1)
+#define RAW12                   (1 << 2)
+#define RAW14                   (1 << 3)
+
+struct vc_emu_module {
+        __u16 mod_id;
+        const char *sen_type;
+        __u8 lanes;
+        __u8 formats;
+        __u32 data_rate;                // Hz per lane
+};
+
+static const struct vc_emu_module vc_emu_modules[] = {
+        { MOD_ID_IMX178, "IMX178", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12 | RAW14,  1188000000 },
+        { MOD_ID_IMX183, "IMX183", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1188000000 },
+        { MOD_ID_IMX226, "IMX226", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1188000000 },
+        { MOD_ID_IMX250, "IMX250", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1188000000 },
+        { MOD_ID_IMX252, "IMX252", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1188000000 },
+        { MOD_ID_IMX264, "IMX264", LANES_2,            RAW08 | RAW10 | RAW12,           594000000 },
+        { MOD_ID_IMX265, "IMX265", LANES_2,            RAW08 | RAW10 | RAW12,           594000000 },
+        { MOD_ID_IMX273, "IMX273", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1188000000 },
+        { MOD_ID_IMX290, "IMX290", LANES_2 | LANES_4,  RAW10 | RAW12,                   445500000 },
+        { MOD_ID_IMX296, "IMX296", LANES_1,            RAW10,                          1188000000 },
+        { MOD_ID_IMX297, "IMX297", LANES_1,            RAW10,                          1188000000 },
+        { MOD_ID_IMX327, "IMX327", LANES_2 | LANES_4,  RAW10 | RAW12,                   445500000 },
+        { MOD_ID_IMX335, "IMX335", LANES_2 | LANES_4,  RAW10 | RAW12,                   594000000 },
+        { MOD_ID_IMX392, "IMX392", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1188000000 },
+        { MOD_ID_IMX412, "IMX412", LANES_2 | LANES_4,  RAW10,                          1500000000 },
+        { MOD_ID_IMX415, "IMX415", LANES_2 | LANES_4,  RAW10,                           891000000 },
+        { MOD_ID_IMX462, "IMX462", LANES_2 | LANES_4,  RAW10,                           445500000 },
+        { MOD_ID_IMX565, "IMX565", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1500000000 },
+        { MOD_ID_IMX566, "IMX566", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1500000000 },
+        { MOD_ID_IMX567, "IMX567", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1500000000 },
+        { MOD_ID_IMX568, "IMX568", LANES_2 | LANES_4,  RAW08 | RAW10 | RAW12,          1500000000 },
+        { MOD_ID_OV7251, "OV7251", LANES_1,            RAW08 | RAW10,                   800000000 },
+        { MOD_ID_OV9281, "OV9281", LANES_2,            RAW08 | RAW10,                   800000000 },
+};
+
+int vc_emu_init_desc(struct vc_desc *desc, __u16 mod_id, int color)
+{
+        const struct vc_emu_module *module = NULL;
+        static const __u8 formats[] = { FORMAT_RAW08, FORMAT_RAW10, FORMAT_RAW12, FORMAT_RAW14 };
+        static const __u8 lanes[] = { 1, 2, 4 };
+        static const __u8 types[] = { MODE_TYPE_STREAM, MODE_TYPE_TRIGGER };
+        int index, l, f, t;
+        int is_sony;
+
+        for (index = 0; index < ARRAY_SIZE(vc_emu_modules); index++) {
+                if (vc_emu_modules[index].mod_id == mod_id)
+                        module = &vc_emu_modules[index];
+        }
+        if (module == NULL)
+                return -EINVAL;
+
+        is_sony = module->sen_type[0] == 'I';
+
+        memset(desc, 0, sizeof(*desc));
+        strscpy(desc->magic, "VC-MIPI-EMU", sizeof(desc->magic));
+        strscpy(desc->manuf, "Vision Components", sizeof(desc->manuf));
+        strscpy(desc->sen_manuf, is_sony ? "SONY" : "OM", sizeof(desc->sen_manuf));
+        snprintf(desc->sen_type, sizeof(desc->sen_type), "%s%s", module->sen_type, color ? "C" : "");
+        desc->mod_id = module->mod_id;
+        desc->mod_rev = 1;
+
+        if (is_sony) {
+                desc->csr_mode = 0x3000;
+                desc->csr_h_start_l = 0x3040; desc->csr_h_start_h = 0x3041;
+                desc->csr_v_start_l = 0x3044; desc->csr_v_start_h = 0x3045;
+                desc->csr_h_end_l = 0x3048; desc->csr_h_end_h = 0x3049;
+                desc->csr_v_end_l = 0x304c; desc->csr_v_end_h = 0x304d;
+                desc->csr_o_width_l = 0x3050; desc->csr_o_width_h = 0x3051;
+                desc->csr_o_height_l = 0x3054; desc->csr_o_height_h = 0x3055;
+                desc->csr_exposure_l = 0x3058; desc->csr_exposure_m = 0x3059; desc->csr_exposure_h = 0x305a;
+                desc->csr_gain_l = 0x3204; desc->csr_gain_h = 0x3205;
+                desc->clk_ext_trigger = 74250000;
+                desc->clk_pixel = 74250000;
+        } else {
+                desc->csr_mode = 0x0100;
+                desc->csr_h_start_l = 0x3801; desc->csr_h_start_h = 0x3800;
+                desc->csr_v_start_l = 0x3803; desc->csr_v_start_h = 0x3802;
+                desc->csr_h_end_l = 0x3805; desc->csr_h_end_h = 0x3804;
+                desc->csr_v_end_l = 0x3807; desc->csr_v_end_h = 0x3806;
+                desc->csr_o_width_l = 0x3809; desc->csr_o_width_h = 0x3808;
+                desc->csr_o_height_l = 0x380b; desc->csr_o_height_h = 0x380a;
+                desc->csr_exposure_l = 0x3502; desc->csr_exposure_m = 0x3501; desc->csr_exposure_h = 0x3500;
+                desc->csr_gain_l = 0x350b; desc->csr_gain_h = 0x350a;
+                desc->clk_ext_trigger = 25000000;
+                desc->clk_pixel = 25000000;
+        }
+
+        desc->bytes_per_mode = sizeof(struct vc_desc_mode);
+        for (t = 0; t < ARRAY_SIZE(types); t++) {
+                for (l = 0; l < ARRAY_SIZE(lanes); l++) {
+                        for (f = 0; f < ARRAY_SIZE(formats); f++) {
+                                struct vc_desc_mode *mode = &desc->modes[desc->num_modes];
+
+                                if (!(module->lanes & (1 << l)) || !(module->formats & (1 << f)))
+                                        continue;
+                                if (desc->num_modes == ARRAY_SIZE(desc->modes))
+                                        return 0;
+
+                                memcpy(mode->data_rate, &module->data_rate, sizeof(mode->data_rate));
+                                mode->num_lanes = lanes[l];
+                                mode->format = formats[f];
+                                mode->type = types[t];
+                                desc->num_modes++;
+                        }
+                }
+        }
+
+        return 0;
+}
+EXPORT_SYMBOL_GPL(vc_emu_init_desc);
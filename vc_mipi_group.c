@@ -0,0 +1,266 @@
+#include "vc_mipi_group.h"
+
+#include <linux/ktime.h>
+#include <linux/lockdep.h>
+#include <linux/slab.h>
+
+// Cameras with the same vc,sync-group property form a sync group. The group starts when the last
+// member requests streaming: the modes and registers of all members are prepared in parallel, then
+// the slaves (FLAG_TRIGGER_SLAVE in sync trigger mode) are released back to back before the
+// masters, so that every slave waits for the first sync of its master. Stopping a member stops the
+// whole group, the masters first.
+
+static LIST_HEAD(vc_groups);
+static DEFINE_MUTEX(vc_groups_lock);
+
+static struct vc_group *vc_group_find(__u32 id)
+{
+        struct vc_group *group;
+
+        list_for_each_entry(group, &vc_groups, entry) {
+                if (group->id == id) {
+                        return group;
+                }
+        }
+        return NULL;
+}
+
+static int vc_group_count_members(struct vc_group *group)
+{
+        struct vc_group_member *member;
+        int count = 0;
+
+        list_for_each_entry(member, &group->members, entry) {
+                count++;
+        }
+        return count;
+}
+
+static void vc_group_lock_members(struct vc_group *group)
+{
+        struct vc_group_member *member;
+        int index = 0;
+
+        list_for_each_entry(member, &group->members, entry) {
+                mutex_lock_nested(member->cam->lock, index++);
+        }
+}
+
+static void vc_group_unlock_members(struct vc_group *group)
+{
+        struct vc_group_member *member;
+
+        list_for_each_entry_reverse(member, &group->members, entry) {
+                mutex_unlock(member->cam->lock);
+        }
+}
+
+static void vc_group_prepare_work(struct work_struct *work)
+{
+        struct vc_group_member *member = container_of(work, struct vc_group_member, work);
+
+        member->reset = 0;
+        member->ret = vc_core_prepare_stream(member->cam, member->event, &member->reset);
+}
+
+static int vc_group_is_armed(struct vc_group *group)
+{
+        struct vc_group_member *member;
+
+        list_for_each_entry(member, &group->members, entry) {
+                if (!member->armed) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+// A group which already streams with the settings of all members isn't started again.
+static int vc_group_is_current(struct vc_group *group)
+{
+        struct vc_group_member *member;
+
+        if (!group->streaming) {
+                return 0;
+        }
+        list_for_each_entry(member, &group->members, entry) {
+                if (!vc_core_is_stream_current(member->cam)) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+static int vc_group_stop(struct vc_group *group)
+{
+        struct vc_group_member *member;
+        struct vc_stream_event *event;
+        int pass, ret = 0, next;
+
+        // Masters (pass 0) before slaves (pass 1)
+        for (pass = 0; pass < 2; pass++) {
+                list_for_each_entry(member, &group->members, entry) {
+                        if (vc_mod_is_sync_slave(member->cam) != pass || !member->cam->state.streaming) {
+                                continue;
+                        }
+                        event = vc_core_begin_stream_event(member->cam, 0);
+                        next = vc_sen_stop_stream(member->cam);
+                        vc_core_mark_stream_phase(event, VC_PHASE_STOP_STREAM);
+                        vc_core_end_stream_event(member->cam, event, 0, next);
+                        ret = vc_first_error(ret, next);
+                }
+        }
+        group->streaming = 0;
+
+        return ret;
+}
+
+static int vc_group_start(struct vc_group *group)
+{
+        struct vc_group_member *member;
+        __u64 start;
+        int pass, ret = 0;
+
+        if (vc_group_is_current(group)) {
+                return 0;
+        }
+
+        start = ktime_get_ns();
+        list_for_each_entry(member, &group->members, entry) {
+                member->event = vc_core_begin_stream_event(member->cam, 1);
+                queue_work(system_unbound_wq, &member->work);
+        }
+        list_for_each_entry(member, &group->members, entry) {
+                flush_work(&member->work);
+                ret = vc_first_error(ret, member->ret);
+        }
+        group->prepare_ns = ktime_get_ns() - start;
+
+        // Slaves (pass 0) before masters (pass 1), nothing else in between.
+        start = ktime_get_ns();
+        for (pass = 0; pass < 2 && ret == 0; pass++) {
+                list_for_each_entry(member, &group->members, entry) {
+                        if (vc_mod_is_sync_slave(member->cam) == pass) {
+                                continue;
+                        }
+                        member->ret = vc_sen_start_stream(member->cam);
+                        vc_core_mark_stream_phase(member->event, VC_PHASE_START_STREAM);
+                        ret = vc_first_error(ret, member->ret);
+                }
+        }
+        group->start_skew_ns = ktime_get_ns() - start;
+
+        list_for_each_entry(member, &group->members, entry) {
+                vc_core_end_stream_event(member->cam, member->event, member->reset, member->ret);
+        }
+
+        if (ret) {
+                member = list_first_entry(&group->members, struct vc_group_member, entry);
+                vc_err(vc_core_get_sen_device(member->cam), "%s(): Unable to start sync group %u (error: %d)\n",
+                        __FUNCTION__, group->id, ret);
+                vc_group_stop(group);
+                return ret;
+        }
+        group->streaming = 1;
+
+        return 0;
+}
+
+// Requests streaming of a member. The group starts when all members are armed.
+int vc_group_set_stream(struct vc_cam *cam, int enable)
+{
+        struct vc_group_member *member = cam->group;
+        struct vc_group *group = member->group;
+        int ret = 0;
+
+        mutex_lock(&group->lock);
+        member->armed = enable;
+        if (enable && vc_group_is_armed(group)) {
+                vc_group_lock_members(group);
+                ret = vc_group_start(group);
+                vc_group_unlock_members(group);
+        } else if (!enable && group->streaming) {
+                vc_group_lock_members(group);
+                ret = vc_group_stop(group);
+                vc_group_unlock_members(group);
+        }
+        mutex_unlock(&group->lock);
+
+        return ret;
+}
+
+int vc_group_join(struct vc_cam *cam, __u32 id)
+{
+        struct vc_group_member *member;
+        struct vc_group *group;
+
+        member = kzalloc(sizeof(*member), GFP_KERNEL);
+        if (member == NULL) {
+                return -ENOMEM;
+        }
+        member->cam = cam;
+        INIT_WORK(&member->work, vc_group_prepare_work);
+
+        mutex_lock(&vc_groups_lock);
+        group = vc_group_find(id);
+        if (group == NULL) {
+                group = kzalloc(sizeof(*group), GFP_KERNEL);
+                if (group == NULL) {
+                        mutex_unlock(&vc_groups_lock);
+                        kfree(member);
+                        return -ENOMEM;
+                }
+                group->id = id;
+                mutex_init(&group->lock);
+                INIT_LIST_HEAD(&group->members);
+                list_add_tail(&group->entry, &vc_groups);
+        }
+
+        mutex_lock(&group->lock);
+        if (vc_group_count_members(group) == MAX_LOCKDEP_SUBCLASSES) {
+                mutex_unlock(&group->lock);
+                mutex_unlock(&vc_groups_lock);
+                kfree(member);
+                vc_err(vc_core_get_sen_device(cam), "%s(): Sync group %u is limited to %lu members\n",
+                        __FUNCTION__, id, MAX_LOCKDEP_SUBCLASSES);
+                return -EBUSY;
+        }
+        member->group = group;
+        list_add_tail(&member->entry, &group->members);
+        mutex_unlock(&group->lock);
+        mutex_unlock(&vc_groups_lock);
+
+        cam->group = member;
+        vc_notice(vc_core_get_sen_device(cam), "%s(): Joined sync group %u\n", __FUNCTION__, id);
+
+        return 0;
+}
+
+void vc_group_leave(struct vc_cam *cam)
+{
+        struct vc_group_member *member = cam->group;
+        struct vc_group *group;
+
+        if (member == NULL) {
+                return;
+        }
+        group = member->group;
+
+        mutex_lock(&vc_groups_lock);
+        mutex_lock(&group->lock);
+        if (group->streaming) {
+                vc_group_lock_members(group);
+                vc_group_stop(group);
+                vc_group_unlock_members(group);
+        }
+        list_del(&member->entry);
+        mutex_unlock(&group->lock);
+        if (list_empty(&group->members)) {
+                list_del(&group->entry);
+                kfree(group);
+        }
+        mutex_unlock(&vc_groups_lock);
+
+        cam->group = NULL;
+        kfree(member);
+}
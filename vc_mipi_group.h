@@ -0,0 +1,39 @@
+#ifndef _VC_MIPI_GROUP_H
+#define _VC_MIPI_GROUP_H
+
+#include "vc_mipi_core.h"
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
+struct vc_group;
+
+struct vc_group_member {
+        struct list_head entry;         // vc_group.members
+        struct vc_group *group;
+        struct vc_cam *cam;
+        int armed;                      // Streaming has been requested for the member
+        // Preparation of the stream start, runs in parallel for all members
+        struct work_struct work;
+        struct vc_stream_event *event;
+        int reset;
+        int ret;
+};
+
+struct vc_group {
+        struct list_head entry;         // vc_groups
+        __u32 id;
+        struct mutex lock;
+        struct list_head members;
+        int streaming;
+        // Last start
+        __u64 prepare_ns;               // Preparation of all members
+        __u64 start_skew_ns;            // First to last start of a member
+};
+
+int vc_group_join(struct vc_cam *cam, __u32 id);
+void vc_group_leave(struct vc_cam *cam);
+int vc_group_set_stream(struct vc_cam *cam, int enable);
+
+#endif // _VC_MIPI_GROUP_H
@@ -1,21 +1,26 @@
 #include "vc_mipi_modules.h"
+#include <linux/device.h>
+#include <linux/firmware.h>
+#include <linux/module.h>
 #include <linux/v4l2-mediabus.h>
 
 
-#define INIT_MESSAGE(camera) \
-        struct device *dev = &ctrl->client_mod->dev; \
-        vc_notice(dev, "%s(): Initialising module control for %s\n", __FUNCTION__, camera);
-
 #define FRAME(_left, _top, _width, _height) \
-        ctrl->frame = (vc_frame) { .left = _left, .top = _top, .width = _width, .height = _height };
+        .frame = { .left = _left, .top = _top, .width = _width, .height = _height },
+
+#define GAIN_LINEAR(_m0, _c0, _m1, _c1) \
+        .gain_model = { .type = GAIN_MODEL_LINEAR, .m0 = _m0, .c0 = _c0, .m1 = _m1, .c1 = _c1 },
+
+#define GAIN_DB(_step) \
+        .gain_model = { .type = GAIN_MODEL_DB, .m0 = _step },
 
 #define MODE(index, lanes, format, _hmax, vmax_min, vmax_max, vmax_def, \
         blacklevel_max, blacklevel_def, _retrigger_min) \
-        ctrl->mode[index] = (vc_mode) { lanes, format, \
+        .mode[index] = { lanes, format, \
                 .hmax = _hmax,  \
                 .vmax = {.min = vmax_min, .max = vmax_max, .def = vmax_def}, \
                 .blacklevel = {.min = 0, .max = blacklevel_max,  .def = blacklevel_def }, \
-                .retrigger_min = _retrigger_min };
+                .retrigger_min = _retrigger_min },
 
 
 int vc_mod_is_color_sensor(struct vc_desc *desc)
@@ -34,17 +39,18 @@ static void vc_init_ctrl(struct vc_ctrl *ctrl, struct vc_desc* desc)
         ctrl->exposure                  = (vc_control) { .min =   1, .max = 100000000, .def =  10000 };
         ctrl->gain                      = (vc_control) { .min =   0, .max =       255, .def =      0 };
         ctrl->framerate                 = (vc_control) { .min =   0, .max =   1000000, .def =      0 };
+        ctrl->gain_model                = (vc_gain_model) { .type = GAIN_MODEL_LINEAR, .m0 = 1, .c0 = 0, .m1 = 0, .c1 = 1 };
 
         ctrl->csr.sen.mode              = (vc_csr2) { .l = desc->csr_mode, .m = 0x0000 };
 
-        ctrl->csr.sen.mode_standby      = 0x00; 
+        ctrl->csr.sen.mode_standby      = 0x00;
         ctrl->csr.sen.mode_operating    = 0x01;
-        
+
         ctrl->csr.sen.shs.l             = desc->csr_exposure_l;
         ctrl->csr.sen.shs.m             = desc->csr_exposure_m;
         ctrl->csr.sen.shs.h             = desc->csr_exposure_h;
         ctrl->csr.sen.shs.u             = 0;
-        
+
         ctrl->csr.sen.gain.l            = desc->csr_gain_l;
         ctrl->csr.sen.gain.m            = desc->csr_gain_h;
 
@@ -66,82 +72,98 @@ static void vc_init_ctrl(struct vc_ctrl *ctrl, struct vc_desc* desc)
 
         ctrl->clk_ext_trigger           = desc->clk_ext_trigger;
         ctrl->clk_pixel                 = desc->clk_pixel;
-}
 
-static void vc_init_ctrl_imx183_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x7004, .m = 0x7005, .h = 0x7006, .u = 0x0000 };
-        ctrl->csr.sen.hmax              = (vc_csr4) { .l = 0x7002, .m = 0x7003, .h = 0x0000, .u = 0x0000 };
-
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_SELF |
-                                          FLAG_TRIGGER_SINGLE | FLAG_TRIGGER_SYNC;
+        ctrl->flags                     = 0;
 }
 
-static void vc_init_ctrl_imx252_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       511, .def =      0 };
+// ------------------------------------------------------------------------------------------------
+//  Module families
+//
+//  Settings shared by the modules of a sensor family. An entry inherits every setting it doesn't
+//  set itself from its base, the flags of the base are extended by the flags of the entry.
 
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x0210, .m = 0x0211, .h = 0x0212, .u = 0x0000 };
-        ctrl->csr.sen.hmax              = (vc_csr4) { .l = 0x0214, .m = 0x0215, .h = 0x0000, .u = 0x0000 };
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x0454, .m = 0x0455 };
+static const struct vc_module vc_mod_imx183_base = {
+        .csr.vmax                       = { .l = 0x7004, .m = 0x7005, .h = 0x7006, .u = 0x0000 },
+        .csr.hmax                       = { .l = 0x7002, .m = 0x7003, .h = 0x0000, .u = 0x0000 },
 
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH |
-                                          FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE;
-}
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_INCREASE_FRAME_RATE | FLAG_IO_ENABLED |
+                                          FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_SELF |
+                                          FLAG_TRIGGER_SINGLE | FLAG_TRIGGER_SYNC,
+};
 
-static void vc_init_ctrl_imx290_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       255, .def =      0 };
-        
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x3018, .m = 0x3019, .h = 0x301A, .u = 0x0000 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x300a, .m = 0x300b };
+static const struct vc_module vc_mod_imx252_base = {
+        .gain                           = { .min =   0, .max =       511, .def =      0 },
+        GAIN_DB(100)          // 0.1 dB/step
+
+        .csr.vmax                       = { .l = 0x0210, .m = 0x0211, .h = 0x0212, .u = 0x0000 },
+        .csr.hmax                       = { .l = 0x0214, .m = 0x0215, .h = 0x0000, .u = 0x0000 },
+        .csr.blacklevel                 = { .l = 0x0454, .m = 0x0455 },
+
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_INCREASE_FRAME_RATE | FLAG_IO_ENABLED |
+                                          FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH |
+                                          FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE,
+};
+
+static const struct vc_module vc_mod_imx290_base = {
+        .gain                           = { .min =   0, .max =       255, .def =      0 },
+        GAIN_DB(300)          // 0.3 dB/step
+
+        .csr.vmax                       = { .l = 0x3018, .m = 0x3019, .h = 0x301A, .u = 0x0000 },
+        .csr.mode_standby               = 0x01,
+        .csr.mode_operating             = 0x00,
+        .csr.blacklevel                 = { .l = 0x300a, .m = 0x300b },
 
         FRAME(0, 0, 1920, 1080)
-        
-        ctrl->clk_ext_trigger           = 74250000;
-        ctrl->clk_pixel                 = 74250000;
 
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-}
+        .clk_ext_trigger                = 74250000,
+        .clk_pixel                      = 74250000,
 
-static void vc_init_ctrl_imx296_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       480, .def =      0 };
-        
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x3010, .m = 0x3011, .h = 0x3012, .u = 0x0000 };
-        ctrl->csr.sen.mode              = (vc_csr2) { .l = 0x3000, .m = 0x300A };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating	= 0x00;
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x3254, .m = 0x3255 };
-
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH | FLAG_TRIGGER_SELF_V2;
-}
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_INCREASE_FRAME_RATE,
+};
+
+static const struct vc_module vc_mod_imx296_base = {
+        .gain                           = { .min =   0, .max =       480, .def =      0 },
+        GAIN_DB(100)          // 0.1 dB/step
+
+        .csr.vmax                       = { .l = 0x3010, .m = 0x3011, .h = 0x3012, .u = 0x0000 },
+        .csr.mode                       = { .l = 0x3000, .m = 0x300A },
+        .csr.mode_standby               = 0x01,
+        .csr.mode_operating             = 0x00,
+        .csr.blacklevel                 = { .l = 0x3254, .m = 0x3255 },
+
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_INCREASE_FRAME_RATE | FLAG_IO_ENABLED |
+                                          FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH | FLAG_TRIGGER_SELF_V2,
+};
+
+static const struct vc_module vc_mod_imx565_base = {
+        .gain                           = { .min =   0, .max =       480, .def =      0 },
+        GAIN_DB(100)          // 0.1 dB/step
+
+        .csr.blacklevel                 = { .l = 0x35b4, .m = 0x35b5 },
+        .csr.vmax                       = { .l = 0x30d4, .m = 0x30d5, .h = 0x30d6, .u = 0x0000 },
+        .csr.mode                       = { .l = 0x3000, .m = 0x3010 },
+        .csr.mode_standby               = 0x01,
+        .csr.mode_operating             = 0x00,
+
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_PREGIUS_S | FLAG_INCREASE_FRAME_RATE |
+                                          FLAG_IO_ENABLED |
+                                          FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH |
+                                          FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE,
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX178/IMX178C  (Rev.02)
 //  6.44 MegaPixel Starvis
 
-static void vc_init_ctrl_imx178(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX178")
+static const struct vc_module vc_mod_imx178 = {
+        .mod_id                         = MOD_ID_IMX178,
+        .name                           = "IMX178",
+        .base                           = &vc_mod_imx183_base,
 
-        vc_init_ctrl_imx183_base(ctrl, desc);
+        .gain                           = { .min =   0, .max =       480, .def =      0 },
+        GAIN_DB(100)          // 0.1 dB/step
 
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       480, .def =      0 };
-
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x3015, .m = 0x3016 };
+        .csr.blacklevel                 = { .l = 0x3015, .m = 0x3016 },
 
         FRAME(0, 0, 3072, 2048)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -154,21 +176,21 @@ static void vc_init_ctrl_imx178(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(5, 4, FORMAT_RAW10,  600,    9, 0x1ffff,  2126, 1023,   50,   2698560)
         MODE(6, 4, FORMAT_RAW12,  680,    9, 0x1ffff,  2126, 1023,  200,   2698560)
         MODE(7, 4, FORMAT_RAW14, 1156,    9, 0x1ffff,  2126, 4095,  800,   2698560)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX183/IMX183C (Rev.15)
 //  20.2 MegaPixel
 
-static void vc_init_ctrl_imx183(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX183")
+static const struct vc_module vc_mod_imx183 = {
+        .mod_id                         = MOD_ID_IMX183,
+        .name                           = "IMX183",
+        .base                           = &vc_mod_imx183_base,
 
-        vc_init_ctrl_imx183_base(ctrl, desc);
+        .gain                           = { .min =   0, .max =     0x7a5, .def =      0 },
+        GAIN_LINEAR(0, 2048, -1, 2048)
 
-        ctrl->gain                      = (vc_control) { .min =   0, .max =     0x7a5, .def =      0 };
-        
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x0045, .m = 0x0000 };
+        .csr.blacklevel                 = { .l = 0x0045, .m = 0x0000 },
 
         FRAME(0, 0, 5440, 3648)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -179,21 +201,21 @@ static void vc_init_ctrl_imx183(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  720,    5, 0x1ffff,  3728,  255,   50,   3599997)
         MODE(4, 4, FORMAT_RAW10,  720,    5, 0x1ffff,  3728,  255,   50,   3599997)
         MODE(5, 4, FORMAT_RAW12,  862,    5, 0x1ffff,  3728,  255,   50,   3599997)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX226/IMX226C (Rev.16)
 //  12.4 MegaPixel Starvis
 
-static void vc_init_ctrl_imx226(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX226")
+static const struct vc_module vc_mod_imx226 = {
+        .mod_id                         = MOD_ID_IMX226,
+        .name                           = "IMX226",
+        .base                           = &vc_mod_imx183_base,
 
-        vc_init_ctrl_imx183_base(ctrl, desc);
+        .gain                           = { .min =   0, .max =     0x7a5, .def =      0 },
+        GAIN_LINEAR(0, 2048, -1, 2048)
 
-        ctrl->gain                      = (vc_control) { .min =   0, .max =     0x7a5, .def =      0 };
-        
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x0045, .m = 0x0000 };
+        .csr.blacklevel                 = { .l = 0x0045, .m = 0x0000 },
 
         FRAME(0, 0, 3904, 3000)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -205,21 +227,20 @@ static void vc_init_ctrl_imx226(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(4, 4, FORMAT_RAW10,  536,    5, 0x1ffff,  3079,  255,   50,   2698560)
         MODE(5, 4, FORMAT_RAW12,  644,    5, 0x1ffff,  3079,  255,   50,   2698560)
 
-        ctrl->clk_pixel                 = 72000000;
+        .clk_pixel                      = 72000000,
 
-        ctrl->flags                    |= FLAG_FORMAT_GBRG;
-        ctrl->flags                    |= FLAG_TRIGGER_STREAM_EDGE | FLAG_TRIGGER_STREAM_LEVEL;
-}
+        .flags                          = FLAG_FORMAT_GBRG |
+                                          FLAG_TRIGGER_STREAM_EDGE | FLAG_TRIGGER_STREAM_LEVEL,
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX250/IMX250C (Rev.09)
 //  5.01 MegaPixel Pregius
 
-static void vc_init_ctrl_imx250(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX250")
-
-        vc_init_ctrl_imx252_base(ctrl, desc);
+static const struct vc_module vc_mod_imx250 = {
+        .mod_id                         = MOD_ID_IMX250,
+        .name                           = "IMX250",
+        .base                           = &vc_mod_imx252_base,
 
         FRAME(0, 0, 2432, 2048)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -230,17 +251,16 @@ static void vc_init_ctrl_imx250(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  350,   10, 0xfffff,  2094,  255,   15,   1580040)
         MODE(4, 4, FORMAT_RAW10,  430,   10, 0xfffff,  2094, 1023,   60,   1580040)
         MODE(5, 4, FORMAT_RAW12,  510,   10, 0xfffff,  2094, 4095,  240,   1580040)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX252/IMX252C (Rev.12)
 //  3.15 MegaPixel Pregius
 
-static void vc_init_ctrl_imx252(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX252")
-
-        vc_init_ctrl_imx252_base(ctrl, desc);
+static const struct vc_module vc_mod_imx252 = {
+        .mod_id                         = MOD_ID_IMX252,
+        .name                           = "IMX252",
+        .base                           = &vc_mod_imx252_base,
 
         FRAME(0, 0, 2048, 1536)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -251,17 +271,16 @@ static void vc_init_ctrl_imx252(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  310,   10, 0xfffff,  1582,  255,   15,   1063754)
         MODE(4, 4, FORMAT_RAW10,  380,   10, 0xfffff,  1582, 1023,   60,   1063754)
         MODE(5, 4, FORMAT_RAW12,  444,   10, 0xfffff,  1582, 4095,  240,   1063754)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX264/IMX264C (Rev.05)
 //  5.1 MegaPixel Pregius
 
-static void vc_init_ctrl_imx264(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX264")
-
-        vc_init_ctrl_imx252_base(ctrl, desc);
+static const struct vc_module vc_mod_imx264 = {
+        .mod_id                         = MOD_ID_IMX264,
+        .name                           = "IMX264",
+        .base                           = &vc_mod_imx252_base,
 
         FRAME(0, 0, 2432, 2048)
         //                       hmax  vmax     vmax    vmax  blkl  blkl  retrigger
@@ -269,17 +288,16 @@ static void vc_init_ctrl_imx264(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(0, 2, FORMAT_RAW08,  996,   10, 0xfffff, 2100,  255,   15,   1580040)
         MODE(1, 2, FORMAT_RAW10,  996,   10, 0xfffff, 2100, 1023,   60,   1580040)
         MODE(2, 2, FORMAT_RAW12,  996,   10, 0xfffff, 2100, 4095,  240,   1580040)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX265/IMX265C (Rev.05)
 //  3.2 MegaPixel Pregius
 
-static void vc_init_ctrl_imx265(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX265")
-
-        vc_init_ctrl_imx252_base(ctrl, desc);
+static const struct vc_module vc_mod_imx265 = {
+        .mod_id                         = MOD_ID_IMX265,
+        .name                           = "IMX265",
+        .base                           = &vc_mod_imx252_base,
 
         FRAME(0, 0, 2048, 1536)
         //                       hmax  vmax     vmax  vmax  blkl  blkl  retrigger
@@ -287,17 +305,16 @@ static void vc_init_ctrl_imx265(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(0, 2, FORMAT_RAW08,  846,   10, 0xfffff, 1587,  255,   255,   1580040)
         MODE(1, 2, FORMAT_RAW10,  846,   10, 0xfffff, 1587, 1023,  1023,   1580040)
         MODE(2, 2, FORMAT_RAW12,  846,   10, 0xfffff, 1587, 4095,  4095,   1580040)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX273/IMX273C (Rev.16)
 //  1.56 MegaPixel Pregius
 
-static void vc_init_ctrl_imx273(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX273")
-
-        vc_init_ctrl_imx252_base(ctrl, desc);
+static const struct vc_module vc_mod_imx273 = {
+        .mod_id                         = MOD_ID_IMX273,
+        .name                           = "IMX273",
+        .base                           = &vc_mod_imx252_base,
 
         FRAME(0, 0, 1440, 1080)
         //                       hmax  vmax     vmax  vmax  blkl  blkl  retrigger
@@ -308,17 +325,16 @@ static void vc_init_ctrl_imx273(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  238,   15, 0xfffff, 1130,  255,   15,    519230)
         MODE(4, 4, FORMAT_RAW10,  290,   15, 0xfffff, 1130, 1032,   60,    519230)
         MODE(5, 4, FORMAT_RAW12,  396,   15, 0xfffff, 1130, 4095,  240,    519230)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX290 (Rev.02)
 //  2.0 MegaPixel Starvis
 
-static void vc_init_ctrl_imx290(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX290")
-
-        vc_init_ctrl_imx290_base(ctrl, desc);
+static const struct vc_module vc_mod_imx290 = {
+        .mod_id                         = MOD_ID_IMX290,
+        .name                           = "IMX290",
+        .base                           = &vc_mod_imx290_base,
 
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
         //                              min      max    def   max   def
@@ -326,39 +342,37 @@ static void vc_init_ctrl_imx290(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(1, 2, FORMAT_RAW12,  550,    1, 0x3ffff, 0x465,  511,  240,         0)
         MODE(2, 4, FORMAT_RAW10,  550,    1, 0x3ffff, 0x465,  511,   60,         0)
         MODE(3, 4, FORMAT_RAW12,  550,    1, 0x3ffff, 0x465,  511,  240,         0)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX296/IMX296C (Rev.43)
 //  1.56 MegaPixel Pregius
 
-static void vc_init_ctrl_imx296(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX296")
-
-        vc_init_ctrl_imx296_base(ctrl, desc);
+static const struct vc_module vc_mod_imx296 = {
+        .mod_id                         = MOD_ID_IMX296,
+        .name                           = "IMX296",
+        .base                           = &vc_mod_imx296_base,
 
         FRAME(0, 0, 1440, 1080)
         //                       hmax  vmax     vmax  vmax  blkl  blkl  retrigger
         //                              min      max   def   max   def
         MODE(0, 1, FORMAT_RAW10, 1100,    5, 0xfffff, 1110, 1023,   60,    883008)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX297 (Rev.43)
 //  0.39 MegaPixel Pregius
 
-static void vc_init_ctrl_imx297(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{       
-        INIT_MESSAGE("IMX297")
-
-        vc_init_ctrl_imx296_base(ctrl, desc);
+static const struct vc_module vc_mod_imx297 = {
+        .mod_id                         = MOD_ID_IMX297,
+        .name                           = "IMX297",
+        .base                           = &vc_mod_imx296_base,
 
         FRAME(0, 0, 704, 540) // 720 isn't divisible by 32
         //                      hmax  vmax     vmax   vmax  blkl  blkl  retrigger
         //                             min      max    def   max   def
         MODE(0, 1, FORMAT_RAW10, 550,    5, 0xfffff,  1110,  511,   60,    883008)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX327C (Rev.02)
@@ -367,19 +381,18 @@ static void vc_init_ctrl_imx297(struct vc_ctrl *ctrl, struct vc_desc* desc)
 // NOTES:
 // - For vertical flipping VREVERSE 0x3007 = 0x01 has to be set.
 // - For horizontal flipping HREVERSE 0x3007 = 0x02 has to be set.
-// - For cropping WINMODE 0x3007 = 0x40 has to be set. Unfortunatly cropping mode does not reduce 
+// - For cropping WINMODE 0x3007 = 0x40 has to be set. Unfortunatly cropping mode does not reduce
 //   the image size. The image is always filled up to a size of 1920x1080.
 // - To increase the frame rate it is possible to reduce VMAX. In this case the image height is forced
 //   to be height = VMAX - 15. This is independend of the cropped image height.
 // => Cropping is not properly supported.
-// => Frame rate increase by image height reduction could be implemented. 
+// => Frame rate increase by image height reduction could be implemented.
 //    But, it need an own implementation.
 
-static void vc_init_ctrl_imx327(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX327")
-
-        vc_init_ctrl_imx290_base(ctrl, desc);
+static const struct vc_module vc_mod_imx327 = {
+        .mod_id                         = MOD_ID_IMX327,
+        .name                           = "IMX327",
+        .base                           = &vc_mod_imx290_base,
 
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
         //                              min      max    def   max   def
@@ -387,22 +400,23 @@ static void vc_init_ctrl_imx327(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(1, 2, FORMAT_RAW12, 1100,    1, 0x3ffff, 0x465,  511,  240,         0)
         MODE(2, 4, FORMAT_RAW10, 1100,    1, 0x3ffff, 0x465,  511,   60,         0)
         MODE(3, 4, FORMAT_RAW12, 1100,    1, 0x3ffff, 0x465,  511,  240,         0)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX335 (Rev.02)
 //  5.0 MegaPixel Starvis
 
-static void vc_init_ctrl_imx335(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX335")
+static const struct vc_module vc_mod_imx335 = {
+        .mod_id                         = MOD_ID_IMX335,
+        .name                           = "IMX335",
 
-        ctrl->gain                      = (vc_control) { .min =   0, .max =      0xff, .def =      0 };
+        .gain                           = { .min =   0, .max =      0xff, .def =      0 },
+        GAIN_DB(300)          // 0.3 dB/step
 
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x3302, .m = 0x3303 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x3030, .m = 0x3031, .h = 0x3032, .u = 0x0000 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
+        .csr.blacklevel                 = { .l = 0x3302, .m = 0x3303 },
+        .csr.vmax                       = { .l = 0x3030, .m = 0x3031, .h = 0x3032, .u = 0x0000 },
+        .csr.mode_standby               = 0x01,
+        .csr.mode_operating             = 0x00,
 
         FRAME(7, 52, 2592, 1944)
         //                        hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -412,21 +426,18 @@ static void vc_init_ctrl_imx335(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(2, 4, FORMAT_RAW10, 0x113,    9, 0xfffff,  4500, 1023,   50,         0)
         MODE(3, 4, FORMAT_RAW12, 0x226,    9, 0xfffff,  4500, 1023,   50,         0)
 
-        ctrl->flags                    |= FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_DOUBLE_HEIGHT;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-}
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_INCREASE_FRAME_RATE | FLAG_DOUBLE_HEIGHT |
+                                          FLAG_IO_ENABLED,
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX392/IMX392C (Rev.08)
 //  2.3 MegaPixel Pregius
 
-static void vc_init_ctrl_imx392(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX392")
-
-        vc_init_ctrl_imx252_base(ctrl, desc);
+static const struct vc_module vc_mod_imx392 = {
+        .mod_id                         = MOD_ID_IMX392,
+        .name                           = "IMX392",
+        .base                           = &vc_mod_imx252_base,
 
         FRAME(0, 0, 1920, 1200)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -437,24 +448,25 @@ static void vc_init_ctrl_imx392(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  294,   10, 0xfffff,  1252,  255,   15,   1063754)
         MODE(4, 4, FORMAT_RAW10,  355,   10, 0xfffff,  1252, 1023,   60,   1063754)
         MODE(5, 4, FORMAT_RAW12,  441,   10, 0xfffff,  1252, 4095,  240,   1063754)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX412C (Rev.05)
 //  12.3 MegaPixel Starvis
-//  
-//  TODO: 
+//
+//  TODO:
 //  - No black level (0x0B04 <= 1 - Black level correction enable)
 
-static void vc_init_ctrl_imx412(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX412")
-        
-        ctrl->gain                      = (vc_control) { .min =   0, .max =      1023, .def =      0 };
+static const struct vc_module vc_mod_imx412 = {
+        .mod_id                         = MOD_ID_IMX412,
+        .name                           = "IMX412",
+
+        .gain                           = { .min =   0, .max =      1023, .def =      0 },
+        GAIN_LINEAR(0, 1024, -1, 1024)
 
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x0009, .m = 0x0008 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x0341, .m = 0x0340, .h = 0x0000, .u = 0x0000 };
-        ctrl->csr.sen.shs               = (vc_csr4) { .l = 0x0203, .m = 0x0202, .h = 0x0000, .u = 0x0000 };
+        .csr.blacklevel                 = { .l = 0x0009, .m = 0x0008 },
+        .csr.vmax                       = { .l = 0x0341, .m = 0x0340, .h = 0x0000, .u = 0x0000 },
+        .csr.shs                        = { .l = 0x0203, .m = 0x0202, .h = 0x0000, .u = 0x0000 },
 
         FRAME(0, 0, 4032, 3040)
         //                       hmax  vmax     vmax    vmax  blkl  blkl  retrigger
@@ -462,30 +474,28 @@ static void vc_init_ctrl_imx412(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(0, 2, FORMAT_RAW10,  436,   10,  0xffff, 0x0c14, 1023,   40,         0)
         MODE(1, 4, FORMAT_RAW10,  218,   10,  0xffff, 0x0c14, 1023,   40,         0)
 
-        ctrl->clk_ext_trigger           = 27000000;
-        ctrl->clk_pixel                 = 27000000;
+        .clk_ext_trigger                = 27000000,
+        .clk_pixel                      = 27000000,
 
-        ctrl->flags                     = FLAG_RESET_ALWAYS;
-        ctrl->flags                    |= FLAG_EXPOSURE_NORMAL;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_SLAVE;
-}
+        .flags                          = FLAG_RESET_ALWAYS | FLAG_EXPOSURE_NORMAL | FLAG_INCREASE_FRAME_RATE |
+                                          FLAG_IO_ENABLED | FLAG_TRIGGER_SLAVE,
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX415C (Rev.02)
 //  8.3 MegaPixel Starvis
 
-static void vc_init_ctrl_imx415(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX415")
-        
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       240, .def =      0 };
+static const struct vc_module vc_mod_imx415 = {
+        .mod_id                         = MOD_ID_IMX415,
+        .name                           = "IMX415",
 
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x30e2, .m = 0x30e3 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x3024, .m = 0x3025, .h = 0x3026, .u = 0x0000 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
+        .gain                           = { .min =   0, .max =       240, .def =      0 },
+        GAIN_DB(300)          // 0.3 dB/step
+
+        .csr.blacklevel                 = { .l = 0x30e2, .m = 0x30e3 },
+        .csr.vmax                       = { .l = 0x3024, .m = 0x3025, .h = 0x3026, .u = 0x0000 },
+        .csr.mode_standby               = 0x01,
+        .csr.mode_operating             = 0x00,
 
         FRAME(0, 0, 3840, 2160)
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
@@ -493,50 +503,40 @@ static void vc_init_ctrl_imx415(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(0, 2, FORMAT_RAW10, 1042,    8, 0xfffff, 0x8ca, 1023,   50,         0)
         MODE(1, 4, FORMAT_RAW10,  551,    8, 0xfffff, 0x8ca, 1023,   50,         0)
 
-        ctrl->clk_pixel                 = 74250000;
+        .clk_pixel                      = 74250000,
 
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_DOUBLE_HEIGHT;
-        ctrl->flags                    |= FLAG_FORMAT_GBRG;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-}
+        .flags                          = FLAG_EXPOSURE_SONY | FLAG_INCREASE_FRAME_RATE | FLAG_DOUBLE_HEIGHT |
+                                          FLAG_FORMAT_GBRG | FLAG_IO_ENABLED,
+};
 
 // -------------------------------------------------------------
 //  Settings for IMX462 (Rev.01)
 //  2.0 MegaPixel Starvis
 
-static void vc_init_ctrl_imx462(struct vc_ctrl *ctrl, struct vc_desc *desc)
-{
-        INIT_MESSAGE("IMX462")
-
-        vc_init_ctrl_imx290_base(ctrl, desc);
+static const struct vc_module vc_mod_imx462 = {
+        .mod_id                         = MOD_ID_IMX462,
+        .name                           = "IMX462",
+        .base                           = &vc_mod_imx290_base,
 
-        ctrl->gain    = (vc_control) { .min = 0, .max = 238,     .def = 0 };
+        .gain                           = { .min = 0, .max = 238,     .def = 0 },
 
         //                       hmax  vmax     vmax   vmax  blkl  blkl  retrigger
         //                              min      max    def   max   def
         MODE(0, 2, FORMAT_RAW10, 1100,    1, 0x3ffff, 0x465,  511,   60,         0)
         MODE(1, 4, FORMAT_RAW10,  550,    1, 0x3ffff, 0x465,  511,   60,         0)
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX565 (Rev.03)
 //  12.4 MegaPixel Pregius S
 
-static void vc_init_ctrl_imx565(struct vc_ctrl *ctrl, struct vc_desc *desc)
-{
-        INIT_MESSAGE("IMX565")
-
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       480, .def =      0 };
-        
-        ctrl->csr.sen.gain              = (vc_csr2) { .l = 0x3514, .m = 0x3515 };
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x35b4, .m = 0x35b5 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x30d4, .m = 0x30d5, .h = 0x30d6, .u = 0x0000 };
-        ctrl->csr.sen.hmax              = (vc_csr4) { .l = 0x30d8, .m = 0x30d9, .h = 0x0000, .u = 0x0000 };
-        ctrl->csr.sen.mode              = (vc_csr2) { .l = 0x3000, .m = 0x3010 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
+static const struct vc_module vc_mod_imx565 = {
+        .mod_id                         = MOD_ID_IMX565,
+        .name                           = "IMX565",
+        .base                           = &vc_mod_imx565_base,
+
+        .csr.gain                       = { .l = 0x3514, .m = 0x3515 },
+        .csr.hmax                       = { .l = 0x30d8, .m = 0x30d9, .h = 0x0000, .u = 0x0000 },
 
         FRAME(0, 0, 4128, 3000)
         //                       hmax  vmax      vmax   vmax  blkl  blkl  retrigger
@@ -546,38 +546,22 @@ static void vc_init_ctrl_imx565(struct vc_ctrl *ctrl, struct vc_desc *desc)
         MODE(2, 2, FORMAT_RAW12, 1586,   14, 0xffffff, 0xc26, 4095,  240,   3568752)
         MODE(3, 4, FORMAT_RAW08,  555,   30, 0xffffff, 0xc40,  255,   15,   1256094)
         // ---------------------------------------------------------------
-        // Workaround for Rev.01. .hmax = 1197. 
+        // Workaround for Rev.01. .hmax = 1197.
         // This limits the fps to 18.8 fps!
         // The theoretically correct value for Rev.02 is .hmax = 684
         // ---------------------------------------------------------------
         MODE(4, 4, FORMAT_RAW10,  684,   26, 0xffffff, 0xc3a, 1023,   60,   1546074)
         MODE(5, 4, FORMAT_RAW12,  812,   22, 0xffffff, 0xc34, 4095,  240,   1833030)
-
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_PREGIUS_S;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_PULSEWIDTH;
-        ctrl->flags                    |= FLAG_TRIGGER_SELF;
-        ctrl->flags                    |= FLAG_TRIGGER_SINGLE;
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX566 (Rev.03)
 //  8.3 MegaPixel Pregius S
 
-static void vc_init_ctrl_imx566(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX566")
-
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       480, .def =      0 };
-
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x35b4, .m = 0x35b5 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x30d4, .m = 0x30d5, .h = 0x30d6, .u = 0x0000 };
-        ctrl->csr.sen.mode              = (vc_csr2) { .l = 0x3000, .m = 0x3010 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
+static const struct vc_module vc_mod_imx566 = {
+        .mod_id                         = MOD_ID_IMX566,
+        .name                           = "IMX566",
+        .base                           = &vc_mod_imx565_base,
 
         FRAME(0, 0, 2848, 2848)
         //                       hmax  vmax      vmax   vmax  blkl  blkl  retrigger
@@ -588,30 +572,16 @@ static void vc_init_ctrl_imx566(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  396,   40, 0xffffff, 0xbb0,  255,   15,    854172)
         MODE(4, 4, FORMAT_RAW10,  485,   34, 0xffffff, 0xba6, 1023,   60,   1043334)
         MODE(5, 4, FORMAT_RAW12,  574,   30, 0xffffff, 0xba0, 4095,  240,   1233144)
-
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_PREGIUS_S;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH |
-                                          FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE;
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX567 (Rev.03)
 //  5.1 MegaPixel Pregius S
 
-static void vc_init_ctrl_imx567(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX567")
-
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       480, .def =      0 };
-
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x35b4, .m = 0x35b5 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x30d4, .m = 0x30d5, .h = 0x30d6, .u = 0x0000 };
-        ctrl->csr.sen.mode              = (vc_csr2) { .l = 0x3000, .m = 0x3010 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
+static const struct vc_module vc_mod_imx567 = {
+        .mod_id                         = MOD_ID_IMX567,
+        .name                           = "IMX567",
+        .base                           = &vc_mod_imx565_base,
 
         FRAME(0, 0, 2464, 2064)
         //                       hmax  vmax      vmax   vmax  blkl  blkl  retrigger
@@ -622,155 +592,563 @@ static void vc_init_ctrl_imx567(struct vc_ctrl *ctrl, struct vc_desc* desc)
         MODE(3, 4, FORMAT_RAW08,  348,   46, 0xffffff, 0x8a8,  255,   15,    553716)
         MODE(4, 4, FORMAT_RAW10,  425,   38, 0xffffff, 0x89e, 1023,   60,    673812)
         MODE(5, 4, FORMAT_RAW12,  502,   34, 0xffffff, 0x896, 4095,  240,    793692)
-
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_PREGIUS_S;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH |
-                                          FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE;
-}
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX568 (Rev.04)
 //  5.1 MegaPixel Pregius S
+//
+//  Same settings as the IMX567.
 
-static void vc_init_ctrl_imx568(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("IMX568")
-
-        ctrl->gain                      = (vc_control) { .min =   0, .max =       480, .def =      0 };
-
-        ctrl->csr.sen.blacklevel        = (vc_csr2) { .l = 0x35b4, .m = 0x35b5 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x30d4, .m = 0x30d5, .h = 0x30d6, .u = 0x0000 };
-        ctrl->csr.sen.mode              = (vc_csr2) { .l = 0x3000, .m = 0x3010 };
-        ctrl->csr.sen.mode_standby      = 0x01;
-        ctrl->csr.sen.mode_operating    = 0x00;
-
-        FRAME(0, 0, 2464, 2064)
-        //                       hmax  vmax      vmax   vmax  blkl  blkl  retrigger
-        //                              min       max    def   max   def
-        MODE(0, 2, FORMAT_RAW08,  656,   26, 0xffffff, 0x88a,  255,   15,   1058562)
-        MODE(1, 2, FORMAT_RAW10,  810,   22, 0xffffff, 0x884, 1023,   60,   1273590)
-        MODE(2, 2, FORMAT_RAW12,  965,   20, 0xffffff, 0x880, 4095,  240,   1514484)
-        MODE(3, 4, FORMAT_RAW08,  348,   46, 0xffffff, 0x8a8,  255,   15,    553716)
-        MODE(4, 4, FORMAT_RAW10,  425,   38, 0xffffff, 0x89e, 1023,   60,    673812)
-        MODE(5, 4, FORMAT_RAW12,  502,   34, 0xffffff, 0x896, 4095,  240,    793692)
-
-        ctrl->flags                     = FLAG_EXPOSURE_SONY;
-        ctrl->flags                    |= FLAG_PREGIUS_S;
-        ctrl->flags                    |= FLAG_INCREASE_FRAME_RATE;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL | FLAG_TRIGGER_PULSEWIDTH |
-                                          FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE;
-}
+static const struct vc_module vc_mod_imx568 = {
+        .mod_id                         = MOD_ID_IMX568,
+        .name                           = "IMX568",
+        .base                           = &vc_mod_imx567,
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for OV7251 (Rev.01)
 //  0.3 MegaPixel OmniPixel3-GS
 //
-//  TODO: 
+//  TODO:
 //  - No flash out
 
-static void vc_init_ctrl_ov7251(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("OV7251")
+static const struct vc_module vc_mod_ov7251 = {
+        .mod_id                         = MOD_ID_OV7251,
+        .name                           = "OV7251",
 
-        ctrl->exposure                  = (vc_control) { .min =   1, .max =   1000000, .def =  10000 };
-        ctrl->gain                      = (vc_control) { .min =   0, .max =      1023, .def =      0 };
+        .exposure                       = { .min =   1, .max =   1000000, .def =  10000 },
+        .gain                           = { .min =   0, .max =      1023, .def =      0 },
+        GAIN_LINEAR(1, 0, 0, 16)
 
-        ctrl->csr.sen.h_end             = (vc_csr2) { .l = 0x0000, .m = 0x0000 };
-        ctrl->csr.sen.v_end             = (vc_csr2) { .l = 0x0000, .m = 0x0000 };
-        ctrl->csr.sen.flash_duration    = (vc_csr4) { .l = 0x3b8f, .m = 0x3b8e, .h = 0x3b8d, .u = 0x3b8c };
-        ctrl->csr.sen.flash_offset      = (vc_csr4) { .l = 0x3b8b, .m = 0x3b8a, .h = 0x3b89, .u = 0x3b88 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x380f, .m = 0x380e, .h = 0x0000, .u = 0x0000 };
+        .csr.h_end                      = { .l = VC_CSR_NONE },
+        .csr.v_end                      = { .l = VC_CSR_NONE },
+        .csr.flash_duration             = { .l = 0x3b8f, .m = 0x3b8e, .h = 0x3b8d, .u = 0x3b8c },
+        .csr.flash_offset               = { .l = 0x3b8b, .m = 0x3b8a, .h = 0x3b89, .u = 0x3b88 },
+        .csr.vmax                       = { .l = 0x380f, .m = 0x380e, .h = 0x0000, .u = 0x0000 },
         // NOTE: Modules rom table contains swapped address assigment.
-        ctrl->csr.sen.gain              = (vc_csr2) { .l = 0x350b, .m = 0x350a };
-        
+        .csr.gain                       = { .l = 0x350b, .m = 0x350a },
+
         FRAME(0, 0, 640, 480)
         //                       hmax  vmax      vmax   vmax  blkl  blkl  retrigger
         //                              min       max    def   max   def
         MODE(0, 1, FORMAT_RAW08,  772,    0,   0xffff,   598,    0,    0,         0)
         MODE(1, 1, FORMAT_RAW10,  772,    0,   0xffff,   598,    0,    0,         0)
 
-        ctrl->flash_factor              = 1758241 >> 4; // (1000 << 4)/9100 >> 4
-        ctrl->flash_toffset             = 4;
+        .flash_factor                   = 1758241 >> 4, // (1000 << 4)/9100 >> 4
+        .flash_toffset                  = 4,
 
-        ctrl->flags                     = FLAG_EXPOSURE_OMNIVISION;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-}
+        .flags                          = FLAG_EXPOSURE_OMNIVISION | FLAG_IO_ENABLED,
+};
 
 // ------------------------------------------------------------------------------------------------
 //  Settings for OV9281 (Rev.03)
 //  1.02 MegaPixel OmniPixel3-GS
 
-static void vc_init_ctrl_ov9281(struct vc_ctrl *ctrl, struct vc_desc* desc)
-{
-        INIT_MESSAGE("OV9281")
-        
-        ctrl->exposure                  = (vc_control) { .min = 146, .max =    595000, .def =  10000 };
-        ctrl->gain                      = (vc_control) { .min =  16, .max =       255, .def =     16 };
-
-        ctrl->csr.sen.h_end             = (vc_csr2) { .l = 0x0000, .m = 0x0000 };
-        ctrl->csr.sen.v_end             = (vc_csr2) { .l = 0x0000, .m = 0x0000 };
-        ctrl->csr.sen.flash_duration	= (vc_csr4) { .l = 0x3928, .m = 0x3927, .h = 0x3926, .u = 0x3925 };
-        ctrl->csr.sen.flash_offset      = (vc_csr4) { .l = 0x3924, .m = 0x3923, .h = 0x3922, .u = 0x0000 };
-        ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x380f, .m = 0x380e, .h = 0x0000, .u = 0x0000 };
+static const struct vc_module vc_mod_ov9281 = {
+        .mod_id                         = MOD_ID_OV9281,
+        .name                           = "OV9281",
+
+        .exposure                       = { .min = 146, .max =    595000, .def =  10000 },
+        .gain                           = { .min =  16, .max =       255, .def =     16 },
+        GAIN_LINEAR(1, 0, 0, 16)
+
+        .csr.h_end                      = { .l = VC_CSR_NONE },
+        .csr.v_end                      = { .l = VC_CSR_NONE },
+        .csr.flash_duration             = { .l = 0x3928, .m = 0x3927, .h = 0x3926, .u = 0x3925 },
+        .csr.flash_offset               = { .l = 0x3924, .m = 0x3923, .h = 0x3922, .u = 0x0000 },
+        .csr.vmax                       = { .l = 0x380f, .m = 0x380e, .h = 0x0000, .u = 0x0000 },
         // NOTE: Modules rom table contains swapped address assigment.
-        ctrl->csr.sen.gain              = (vc_csr2) { .l = 0x3509, .m = 0x0000 };
-        
+        .csr.gain                       = { .l = 0x3509, .m = 0x0000 },
+
         FRAME(0, 0, 1280, 800)
         //                       hmax  vmax      vmax   vmax  blkl  blkl  retrigger
         //                              min       max    def   max   def
         MODE(0, 2, FORMAT_RAW08,  227,   16,   0xffff,   910,    0,    0,         0)
         MODE(1, 2, FORMAT_RAW10,  227,   16,   0xffff,   910,    0,    0,         0)
 
-        ctrl->clk_ext_trigger           = 25000000;
-        ctrl->clk_pixel                 = 25000000;
+        .clk_ext_trigger                = 25000000,
+        .clk_pixel                      = 25000000,
+
+        .flash_factor                   = 1758241 >> 4, // (1000 << 4)/9100 >> 4
+        .flash_toffset                  = 4,
+
+        .flags                          = FLAG_EXPOSURE_OMNIVISION | FLAG_IO_ENABLED | FLAG_TRIGGER_EXTERNAL,
+};
+
+// ------------------------------------------------------------------------------------------------
+//  Module database
+
+static const struct vc_module *vc_modules[] = {
+        &vc_mod_imx178,
+        &vc_mod_imx183,
+        &vc_mod_imx226,
+        &vc_mod_imx250,
+        &vc_mod_imx252,
+        &vc_mod_imx264,
+        &vc_mod_imx265,
+        &vc_mod_imx273,
+        &vc_mod_imx290,
+        &vc_mod_imx296,
+        &vc_mod_imx297,
+        &vc_mod_imx327,
+        &vc_mod_imx335,
+        &vc_mod_imx392,
+        &vc_mod_imx412,
+        &vc_mod_imx415,
+        &vc_mod_imx462,
+        &vc_mod_imx565,
+        &vc_mod_imx566,
+        &vc_mod_imx567,
+        &vc_mod_imx568,
+        &vc_mod_ov7251,
+        &vc_mod_ov9281,
+};
+
+const struct vc_module *vc_mod_find(__u16 mod_id, __u16 mod_rev)
+{
+        const struct vc_module *found = NULL;
+        int index;
+
+        // An entry for the exact revision takes precedence over an entry for all revisions.
+        for (index = 0; index < ARRAY_SIZE(vc_modules); index++) {
+                const struct vc_module *mod = vc_modules[index];
+                if (mod->mod_id != mod_id) {
+                        continue;
+                }
+                if (mod->mod_rev == mod_rev) {
+                        return mod;
+                }
+                if (mod->mod_rev == 0) {
+                        found = mod;
+                }
+        }
+        return found;
+}
+
+static void vc_mod_apply_csr2(struct vc_csr2 *csr, const struct vc_csr2 *mod)
+{
+        if (mod->l == VC_CSR_NONE) {
+                *csr = (vc_csr2) { 0 };
+        } else if (mod->l || mod->m) {
+                *csr = *mod;
+        }
+}
+
+static void vc_mod_apply_csr4(struct vc_csr4 *csr, const struct vc_csr4 *mod)
+{
+        if (mod->l == VC_CSR_NONE) {
+                *csr = (vc_csr4) { 0 };
+        } else if (mod->l || mod->m || mod->h || mod->u) {
+                *csr = *mod;
+        }
+}
+
+// Applies the settings of an entry on top of the settings of its base. Only the settings the
+// entry sets are applied, the modes are referenced and not copied.
+static void vc_mod_apply(struct vc_ctrl *ctrl, const struct vc_module *mod)
+{
+        struct vc_sen_csr *csr = &ctrl->csr.sen;
+
+        if (mod->base) {
+                vc_mod_apply(ctrl, mod->base);
+        }
+
+        if (mod->exposure.max) {
+                ctrl->exposure = mod->exposure;
+        }
+        if (mod->gain.max) {
+                ctrl->gain = mod->gain;
+        }
+        if (mod->gain_model.m0 || mod->gain_model.c0 || mod->gain_model.m1 || mod->gain_model.c1) {
+                ctrl->gain_model = mod->gain_model;
+        }
 
-        ctrl->flash_factor              = 1758241 >> 4; // (1000 << 4)/9100 >> 4
-        ctrl->flash_toffset             = 4;
+        vc_mod_apply_csr2(&csr->mode, &mod->csr.mode);
+        if (mod->csr.mode_standby != mod->csr.mode_operating) {
+                csr->mode_standby = mod->csr.mode_standby;
+                csr->mode_operating = mod->csr.mode_operating;
+        }
+        vc_mod_apply_csr4(&csr->vmax, &mod->csr.vmax);
+        vc_mod_apply_csr4(&csr->hmax, &mod->csr.hmax);
+        vc_mod_apply_csr4(&csr->shs, &mod->csr.shs);
+        vc_mod_apply_csr2(&csr->gain, &mod->csr.gain);
+        vc_mod_apply_csr2(&csr->blacklevel, &mod->csr.blacklevel);
+        vc_mod_apply_csr2(&csr->h_start, &mod->csr.h_start);
+        vc_mod_apply_csr2(&csr->v_start, &mod->csr.v_start);
+        vc_mod_apply_csr2(&csr->h_end, &mod->csr.h_end);
+        vc_mod_apply_csr2(&csr->v_end, &mod->csr.v_end);
+        vc_mod_apply_csr2(&csr->o_width, &mod->csr.o_width);
+        vc_mod_apply_csr2(&csr->o_height, &mod->csr.o_height);
+        vc_mod_apply_csr4(&csr->flash_duration, &mod->csr.flash_duration);
+        vc_mod_apply_csr4(&csr->flash_offset, &mod->csr.flash_offset);
+
+        if (mod->frame.width) {
+                ctrl->frame = mod->frame;
+        }
+        if (mod->mode[0].num_lanes) {
+                ctrl->mode = mod->mode;
+        }
 
-        ctrl->flags                     = FLAG_EXPOSURE_OMNIVISION;
-        ctrl->flags                    |= FLAG_IO_ENABLED;
-        ctrl->flags                    |= FLAG_TRIGGER_EXTERNAL;
+        if (mod->clk_ext_trigger) {
+                ctrl->clk_ext_trigger = mod->clk_ext_trigger;
+        }
+        if (mod->clk_pixel) {
+                ctrl->clk_pixel = mod->clk_pixel;
+        }
+        if (mod->flash_factor) {
+                ctrl->flash_factor = mod->flash_factor;
+                ctrl->flash_toffset = mod->flash_toffset;
+        }
+
+        ctrl->flags |= mod->flags;
 }
 
+// ------------------------------------------------------------------------------------------------
+//  Firmware module tables
+//
+//  A table for the module revision (vc_mipi/mod_<mod_id>_<mod_rev>.bin, e.g. vc_mipi/mod_0565_1.bin)
+//  takes precedence over a table for all revisions (vc_mipi/mod_<mod_id>.bin). The table is based
+//  on the built-in entry of the module. Modules without a built-in entry need a complete table.
 
-int vc_mod_ctrl_init(struct vc_ctrl* ctrl, struct vc_desc* desc)
+static bool load_tables = true;
+module_param(load_tables, bool, 0444);
+MODULE_PARM_DESC(load_tables, "Load module tables from /lib/firmware/vc_mipi (default: on)");
+
+static struct vc_control vc_fw_control(const struct vc_fw_control *fw)
+{
+        return (vc_control) { .min = le32_to_cpu(fw->min), .max = le32_to_cpu(fw->max),
+                .def = le32_to_cpu(fw->def) };
+}
+
+static __u32 vc_fw_addr(__le16 addr)
+{
+        __u16 value = le16_to_cpu(addr);
+
+        return value == VC_FW_CSR_NONE ? VC_CSR_NONE : value;
+}
+
+static void vc_fw_csr2(struct vc_csr2 *csr, const struct vc_fw_csr *fw)
+{
+        csr->l = vc_fw_addr(fw->l);
+        csr->m = vc_fw_addr(fw->m);
+}
+
+static void vc_fw_csr4(struct vc_csr4 *csr, const struct vc_fw_csr *fw)
+{
+        csr->l = vc_fw_addr(fw->l);
+        csr->m = vc_fw_addr(fw->m);
+        csr->h = vc_fw_addr(fw->h);
+        csr->u = vc_fw_addr(fw->u);
+}
+
+static struct vc_module *vc_mod_parse_table(struct device *dev, const struct firmware *fw,
+        const char *name, struct vc_desc *desc, const struct vc_module *base)
+{
+        const struct vc_fw_table *table = (const struct vc_fw_table *)fw->data;
+        struct vc_module *mod;
+        struct vc_sen_csr *csr;
+        int index;
+
+        if (fw->size < sizeof(*table) || le32_to_cpu(table->magic) != VC_FW_MAGIC) {
+                vc_err(dev, "%s(): %s is no module table\n", __FUNCTION__, name);
+                return NULL;
+        }
+        if (le16_to_cpu(table->version) != VC_FW_VERSION) {
+                vc_err(dev, "%s(): %s has version %u (supported: %u)\n", __FUNCTION__, name,
+                        le16_to_cpu(table->version), VC_FW_VERSION);
+                return NULL;
+        }
+        if (le16_to_cpu(table->size) != sizeof(*table)) {
+                vc_err(dev, "%s(): %s has size %u (expected: %zu)\n", __FUNCTION__, name,
+                        le16_to_cpu(table->size), sizeof(*table));
+                return NULL;
+        }
+        if (le16_to_cpu(table->mod_id) != desc->mod_id ||
+            (table->mod_rev && le16_to_cpu(table->mod_rev) != desc->mod_rev)) {
+                vc_err(dev, "%s(): %s is for module 0x%04x rev %u\n", __FUNCTION__, name,
+                        le16_to_cpu(table->mod_id), le16_to_cpu(table->mod_rev));
+                return NULL;
+        }
+
+        mod = devm_kzalloc(dev, sizeof(*mod), GFP_KERNEL);
+        if (mod == NULL) {
+                return NULL;
+        }
+        mod->mod_id = desc->mod_id;
+        mod->mod_rev = le16_to_cpu(table->mod_rev);
+        mod->base = base;
+        if (base) {
+                mod->name = devm_kasprintf(dev, GFP_KERNEL, "%s (%s)", base->name, name);
+        } else {
+                mod->name = devm_kasprintf(dev, GFP_KERNEL, "%.*s (%s)", (int)sizeof(desc->sen_type),
+                        desc->sen_type, name);
+        }
+        if (mod->name == NULL) {
+                return NULL;
+        }
+
+        mod->exposure = vc_fw_control(&table->exposure);
+        mod->gain = vc_fw_control(&table->gain);
+        mod->gain_model.type = table->gain_model_type;
+        mod->gain_model.m0 = (__s32)le32_to_cpu(table->gain_model[0]);
+        mod->gain_model.c0 = (__s32)le32_to_cpu(table->gain_model[1]);
+        mod->gain_model.m1 = (__s32)le32_to_cpu(table->gain_model[2]);
+        mod->gain_model.c1 = (__s32)le32_to_cpu(table->gain_model[3]);
+
+        csr = &mod->csr;
+        vc_fw_csr2(&csr->mode, &table->csr[VC_FW_REG_MODE]);
+        csr->mode_standby = table->mode_standby;
+        csr->mode_operating = table->mode_operating;
+        vc_fw_csr4(&csr->vmax, &table->csr[VC_FW_REG_VMAX]);
+        vc_fw_csr4(&csr->hmax, &table->csr[VC_FW_REG_HMAX]);
+        vc_fw_csr4(&csr->shs, &table->csr[VC_FW_REG_SHS]);
+        vc_fw_csr2(&csr->gain, &table->csr[VC_FW_REG_GAIN]);
+        vc_fw_csr2(&csr->blacklevel, &table->csr[VC_FW_REG_BLACKLEVEL]);
+        vc_fw_csr2(&csr->h_start, &table->csr[VC_FW_REG_H_START]);
+        vc_fw_csr2(&csr->v_start, &table->csr[VC_FW_REG_V_START]);
+        vc_fw_csr2(&csr->h_end, &table->csr[VC_FW_REG_H_END]);
+        vc_fw_csr2(&csr->v_end, &table->csr[VC_FW_REG_V_END]);
+        vc_fw_csr2(&csr->o_width, &table->csr[VC_FW_REG_O_WIDTH]);
+        vc_fw_csr2(&csr->o_height, &table->csr[VC_FW_REG_O_HEIGHT]);
+        vc_fw_csr4(&csr->flash_duration, &table->csr[VC_FW_REG_FLASH_DURATION]);
+        vc_fw_csr4(&csr->flash_offset, &table->csr[VC_FW_REG_FLASH_OFFSET]);
+
+        mod->frame.left = le32_to_cpu(table->frame[0]);
+        mod->frame.top = le32_to_cpu(table->frame[1]);
+        mod->frame.width = le32_to_cpu(table->frame[2]);
+        mod->frame.height = le32_to_cpu(table->frame[3]);
+
+        for (index = 0; index < VC_MAX_MODES; index++) {
+                const struct vc_fw_mode *fw_mode = &table->mode[index];
+                struct vc_mode *mode = &mod->mode[index];
+
+                mode->num_lanes = fw_mode->num_lanes;
+                mode->format = fw_mode->format;
+                mode->hmax = le32_to_cpu(fw_mode->hmax);
+                mode->vmax = vc_fw_control(&fw_mode->vmax);
+                mode->blacklevel = vc_fw_control(&fw_mode->blacklevel);
+                mode->retrigger_min = le32_to_cpu(fw_mode->retrigger_min);
+                if (mode->num_lanes == 0) {
+                        continue;
+                }
+                // The line period is computed from hmax
+                if (mode->hmax == 0) {
+                        vc_err(dev, "%s(): %s: mode %d has no hmax\n", __FUNCTION__, name, index);
+                        return NULL;
+                }
+                if (mode->vmax.min > mode->vmax.max ||
+                    mode->vmax.def < mode->vmax.min || mode->vmax.def > mode->vmax.max) {
+                        vc_err(dev, "%s(): %s: mode %d has vmax %u/%u/%u (min/max/def)\n", __FUNCTION__, name,
+                                index, mode->vmax.min, mode->vmax.max, mode->vmax.def);
+                        return NULL;
+                }
+        }
+
+        mod->clk_ext_trigger = le32_to_cpu(table->clk_ext_trigger);
+        mod->clk_pixel = le32_to_cpu(table->clk_pixel);
+        // The line period is computed with the pixel clock as well
+        if (mod->clk_pixel == 0 && base == NULL) {
+                vc_err(dev, "%s(): %s has no clk_pixel\n", __FUNCTION__, name);
+                return NULL;
+        }
+        mod->flash_factor = le32_to_cpu(table->flash_factor);
+        mod->flash_toffset = (__s32)le32_to_cpu(table->flash_toffset);
+        mod->flags = le32_to_cpu(table->flags) & ~FLAG_GENERIC;
+
+        return mod;
+}
+
+static const struct vc_module *vc_mod_load_table(struct vc_ctrl *ctrl, struct vc_desc *desc,
+        const struct vc_module *base)
+{
+        struct device *dev = &ctrl->client_sen->dev;
+        const struct firmware *fw;
+        const struct vc_module *mod;
+        char name[32];
+
+        if (!load_tables) {
+                return NULL;
+        }
+
+        snprintf(name, sizeof(name), "vc_mipi/mod_%04x_%u.bin", desc->mod_id, desc->mod_rev);
+        if (firmware_request_nowarn(&fw, name, dev)) {
+                snprintf(name, sizeof(name), "vc_mipi/mod_%04x.bin", desc->mod_id);
+                if (firmware_request_nowarn(&fw, name, dev)) {
+                        return NULL;
+                }
+        }
+
+        mod = vc_mod_parse_table(dev, fw, name, desc, base);
+        release_firmware(fw);
+        return mod;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Generic module
+//
+//  A module without a built-in entry and without a table is driven by its descriptor alone:
+//  streaming, ROI, gain and exposure use the registers of the descriptor. VMAX and HMAX of the
+//  sensor are unknown and never written, the sensor runs at its nominal frame rate. The line
+//  period is estimated from the image size and the MIPI data rate of the modes, the exposure is
+//  written in lines from the start of the frame and limited to the estimated frame time. Sony
+//  sensors count the exposure back from the end of the frame (SHS = VMAX - exposure), without the
+//  VMAX register they need a table.
+
+static bool generic = true;
+module_param(generic, bool, 0444);
+MODULE_PARM_DESC(generic, "Drive modules without entry or table by their descriptor (default: on)");
+
+#define VC_GENERIC_BLANKING             8       // Blanking in 1/8 of the line length / image height
+#define VC_GENERIC_SHS_MIN              10      // Largest SHS_MIN (vmax.min) of the built-in entries
+
+static int vc_mod_generic_mode(struct vc_mode *mode, struct vc_desc_mode *desc_mode, __u32 clk_pixel,
+        struct vc_frame *frame)
+{
+        __u64 data_rate = vc_core_get_mode_link_freq(desc_mode) * 2 * desc_mode->num_lanes;
+        __u8 bpp = vc_core_get_bits_per_pixel(desc_mode->format);
+        __u32 vmax;
+
+        if (data_rate == 0 || bpp == 0) {
+                return 1;
+        }
+
+        // Time to transfer a line at the data rate of the mode, in periods of the pixel clock
+        mode->num_lanes = desc_mode->num_lanes;
+        mode->format = desc_mode->format;
+        mode->hmax = DIV_ROUND_UP_ULL((__u64)frame->width * bpp * clk_pixel, data_rate);
+        mode->hmax += mode->hmax / VC_GENERIC_BLANKING;
+
+        vmax = frame->height + frame->height / VC_GENERIC_BLANKING;
+        mode->vmax = (vc_control) { .min = VC_GENERIC_SHS_MIN, .max = vmax, .def = vmax };
+        mode->blacklevel = (vc_control) { 0 };
+        mode->retrigger_min = 0;
+
+        return 0;
+}
+
+int vc_mod_generic_init(struct vc_ctrl *ctrl, struct vc_desc *desc)
 {
         struct device *dev = &ctrl->client_mod->dev;
+        struct vc_module *mod;
+        __u64 period_1H_ns;
+        int index, count = 0;
+
+        // The SHS of a Sony sensor depends on a VMAX which isn't known here.
+        if (strncmp(desc->sen_manuf, "SONY", sizeof(desc->sen_manuf)) == 0) {
+                vc_err(dev, "%s(): Sony sensor %.*s needs its VMAX register for the exposure, provide a "
+                        "module table!\n", __FUNCTION__, (int)sizeof(desc->sen_type), desc->sen_type);
+                return -EINVAL;
+        }
 
-        vc_init_ctrl(ctrl, desc);
+        mod = devm_kzalloc(dev, sizeof(*mod), GFP_KERNEL);
+        if (mod == NULL) {
+                return -ENOMEM;
+        }
+        mod->mod_id = desc->mod_id;
+        mod->mod_rev = desc->mod_rev;
+        mod->name = devm_kasprintf(dev, GFP_KERNEL, "%.*s (generic)", (int)sizeof(desc->sen_type),
+                desc->sen_type);
+        if (mod->name == NULL) {
+                return -ENOMEM;
+        }
+
+        // Without a pixel clock in the descriptor the line period is counted at the pixel rate of
+        // the first mode.
+        mod->clk_pixel = ctrl->clk_pixel;
+        if (mod->clk_pixel == 0) {
+                mod->clk_pixel = vc_core_get_mode_link_freq(&desc->modes[0]) * 2 *
+                        desc->modes[0].num_lanes / max_t(__u8, 1, vc_core_get_bits_per_pixel(desc->modes[0].format));
+        }
 
-        switch(desc->mod_id) {
-        case MOD_ID_IMX178: vc_init_ctrl_imx178(ctrl, desc); break;
-        case MOD_ID_IMX183: vc_init_ctrl_imx183(ctrl, desc); break;
-        case MOD_ID_IMX226: vc_init_ctrl_imx226(ctrl, desc); break;
-        case MOD_ID_IMX250: vc_init_ctrl_imx250(ctrl, desc); break;
-        case MOD_ID_IMX252: vc_init_ctrl_imx252(ctrl, desc); break;
-        case MOD_ID_IMX264: vc_init_ctrl_imx264(ctrl, desc); break;
-        case MOD_ID_IMX265: vc_init_ctrl_imx265(ctrl, desc); break;
-        case MOD_ID_IMX273: vc_init_ctrl_imx273(ctrl, desc); break;
-        case MOD_ID_IMX290: vc_init_ctrl_imx290(ctrl, desc); break;
-        case MOD_ID_IMX296: vc_init_ctrl_imx296(ctrl, desc); break;
-        case MOD_ID_IMX297: vc_init_ctrl_imx297(ctrl, desc); break;
-        case MOD_ID_IMX327: vc_init_ctrl_imx327(ctrl, desc); break;
-        case MOD_ID_IMX335: vc_init_ctrl_imx335(ctrl, desc); break;
-        case MOD_ID_IMX392: vc_init_ctrl_imx392(ctrl, desc); break;
-        case MOD_ID_IMX412: vc_init_ctrl_imx412(ctrl, desc); break;
-        case MOD_ID_IMX415: vc_init_ctrl_imx415(ctrl, desc); break;
-        case MOD_ID_IMX462: vc_init_ctrl_imx462(ctrl, desc); break;
-        case MOD_ID_IMX565: vc_init_ctrl_imx565(ctrl, desc); break;
-        case MOD_ID_IMX566: vc_init_ctrl_imx566(ctrl, desc); break;
-        case MOD_ID_IMX567: vc_init_ctrl_imx567(ctrl, desc); break;
-        case MOD_ID_IMX568: vc_init_ctrl_imx568(ctrl, desc); break;
-        case MOD_ID_OV7251: vc_init_ctrl_ov7251(ctrl, desc); break;
-        case MOD_ID_OV9281: vc_init_ctrl_ov9281(ctrl, desc); break;
-        default:
+        // One mode per combination of lanes and format, the timing doesn't depend on the type.
+        for (index = 0; index < desc->num_modes && index < ARRAY_SIZE(desc->modes); index++) {
+                struct vc_desc_mode *desc_mode = &desc->modes[index];
+                int known;
+
+                for (known = 0; known < count; known++) {
+                        if (mod->mode[known].num_lanes == desc_mode->num_lanes &&
+                            mod->mode[known].format == desc_mode->format) {
+                                break;
+                        }
+                }
+                if (known < count || count == VC_MAX_MODES) {
+                        continue;
+                }
+                if (vc_mod_generic_mode(&mod->mode[count], desc_mode, mod->clk_pixel, &ctrl->frame)) {
+                        vc_err(dev, "%s(): Mode %d has no data rate or an unknown format\n", __FUNCTION__, index);
+                        continue;
+                }
+                count++;
+        }
+        if (count == 0 || mod->clk_pixel == 0) {
+                vc_err(dev, "%s(): No usable modes for module 0x%04x!\n", __FUNCTION__, desc->mod_id);
+                return -EINVAL;
+        }
+
+        mod->flags = FLAG_EXPOSURE_NORMAL | FLAG_GENERIC;
+
+        vc_mod_apply(ctrl, mod);
+        ctrl->mod = mod;
+
+        // The exposure has to fit into the nominal frame of every mode.
+        for (index = 0; index < count; index++) {
+                const struct vc_mode *mode = &mod->mode[index];
+                __u64 frame_us;
+
+                period_1H_ns = ((__u64)mode->hmax * 1000000000) / ctrl->clk_pixel;
+                frame_us = (period_1H_ns * (mode->vmax.max - mode->vmax.min)) / 1000;
+                if (frame_us < ctrl->exposure.max) {
+                        ctrl->exposure.max = frame_us;
+                }
+        }
+        ctrl->exposure.def = min(ctrl->exposure.def, ctrl->exposure.max);
+
+        vc_warn(dev, "%s(): Module 0x%04x rev %u is driven by its descriptor (%d modes, exposure max %u us). "
+                "Timing is estimated, provide a module table for full support.\n", __FUNCTION__,
+                desc->mod_id, desc->mod_rev, count, ctrl->exposure.max);
+
+        return 0;
+}
+
+// Initialises the module control from the entry of the module. A module without entry is left
+// without modes (ctrl->mod == NULL) when it can be driven generically, vc_mod_generic_init() has
+// to be called as soon as the image size is known.
+int vc_mod_ctrl_init(struct vc_ctrl* ctrl, struct vc_desc* desc)
+{
+        struct device *dev = &ctrl->client_mod->dev;
+        const struct vc_module *base, *mod;
+
+        base = vc_mod_find(desc->mod_id, desc->mod_rev);
+        mod = vc_mod_load_table(ctrl, desc, base);
+        if (mod == NULL) {
+                mod = base;
+        }
+        if (mod == NULL && generic) {
+                vc_notice(dev, "%s(): Initialising generic module control for %.*s\n", __FUNCTION__,
+                        (int)sizeof(desc->sen_type), desc->sen_type);
+                vc_init_ctrl(ctrl, desc);
+                ctrl->frame.width = 0;
+                ctrl->frame.height = 0;
+                ctrl->mod = NULL;
+                ctrl->mode = NULL;
+                return 0;
+        }
+        if (mod == NULL) {
                 vc_err(dev, "%s(): Detected module not supported!\n", __FUNCTION__);
                 return 1;
         }
 
+        vc_notice(dev, "%s(): Initialising module control for %s\n", __FUNCTION__, mod->name);
+
+        vc_init_ctrl(ctrl, desc);
+        ctrl->mode = NULL;
+        vc_mod_apply(ctrl, mod);
+        if (ctrl->mode == NULL) {
+                vc_err(dev, "%s(): No modes for module 0x%04x!\n", __FUNCTION__, desc->mod_id);
+                return 1;
+        }
+        ctrl->mod = mod;
+
         return 0;
-}
\ No newline at end of file
+}
@@ -27,7 +27,102 @@
 #define MOD_ID_OV7251           0x7251
 #define MOD_ID_OV9281           0x9281
 
+#define VC_CSR_NONE                     0xffffffff      // Removes a register given by the descriptor
+
+// Entry of the module database. The entries are const, a camera references its entry and only
+// keeps the settings resolved against the module descriptor in struct vc_ctrl. Settings which are
+// 0 are inherited from the base entry or taken from the descriptor.
+struct vc_module {
+        __u16 mod_id;
+        __u16 mod_rev;                  // 0: All revisions
+        const char *name;
+        const struct vc_module *base;   // Sensor family the entry inherits from
+        struct vc_control exposure;
+        struct vc_control gain;
+        struct vc_gain_model gain_model;
+        struct vc_sen_csr csr;
+        struct vc_frame frame;
+        struct vc_mode mode[VC_MAX_MODES];
+        __u32 clk_ext_trigger;
+        __u32 clk_pixel;
+        __u32 flash_factor;
+        __s32 flash_toffset;
+        __u32 flags;                    // Added to the flags of the base entry
+};
+
+// Module table loaded with request_firmware() (little endian). The table overrides the built-in
+// entry of the module like an entry overrides its base: settings which are 0 are inherited.
+#define VC_FW_MAGIC                     0x544d4356      // "VCMT"
+#define VC_FW_VERSION                   1
+#define VC_FW_CSR_NONE                  0xffff          // VC_CSR_NONE
+
+enum vc_fw_reg {
+        VC_FW_REG_MODE,
+        VC_FW_REG_VMAX,
+        VC_FW_REG_HMAX,
+        VC_FW_REG_SHS,
+        VC_FW_REG_GAIN,
+        VC_FW_REG_BLACKLEVEL,
+        VC_FW_REG_H_START,
+        VC_FW_REG_V_START,
+        VC_FW_REG_H_END,
+        VC_FW_REG_V_END,
+        VC_FW_REG_O_WIDTH,
+        VC_FW_REG_O_HEIGHT,
+        VC_FW_REG_FLASH_DURATION,
+        VC_FW_REG_FLASH_OFFSET,
+        VC_FW_REG_NUM
+};
+
+struct vc_fw_control {
+        __le32 min;
+        __le32 max;
+        __le32 def;
+} __packed;
+
+struct vc_fw_csr {
+        __le16 l;
+        __le16 m;
+        __le16 h;
+        __le16 u;
+} __packed;
+
+struct vc_fw_mode {
+        __u8 num_lanes;                 // 0: Unused
+        __u8 format;
+        __le16 reserved;
+        __le32 hmax;
+        struct vc_fw_control vmax;
+        struct vc_fw_control blacklevel;
+        __le32 retrigger_min;
+} __packed;
+
+struct vc_fw_table {
+        __le32 magic;
+        __le16 version;
+        __le16 size;                    // sizeof(struct vc_fw_table)
+        __le16 mod_id;
+        __le16 mod_rev;                 // 0: All revisions
+        __le32 flags;
+        struct vc_fw_control exposure;
+        struct vc_fw_control gain;
+        __u8 gain_model_type;
+        __u8 mode_standby;
+        __u8 mode_operating;
+        __u8 reserved[5];
+        __le32 gain_model[4];           // m0, c0, m1, c1
+        __le32 frame[4];                // left, top, width, height
+        __le32 clk_ext_trigger;
+        __le32 clk_pixel;
+        __le32 flash_factor;
+        __le32 flash_toffset;
+        struct vc_fw_csr csr[VC_FW_REG_NUM];
+        struct vc_fw_mode mode[VC_MAX_MODES];    // Replace all modes of the entry if mode[0] is used
+} __packed;
+
 int vc_mod_is_color_sensor(struct vc_desc *desc);
+const struct vc_module *vc_mod_find(__u16 mod_id, __u16 mod_rev);
 int vc_mod_ctrl_init(struct vc_ctrl* ctrl, struct vc_desc* desc);
+int vc_mod_generic_init(struct vc_ctrl *ctrl, struct vc_desc *desc);
 
 #endif // _VC_MIPI_MODULES_H
@@ -0,0 +1,443 @@
+// KUnit tests of the core and the module database against a stub register backend.
+//
+// Every emulated module is probed on a virtual I2C adapter which implements the module controller
+// (status, registers 0x0100 - 0x0110, descriptor at 0x1000) and the register file of the sensor.
+// The descriptor is the one of the module emulator (vc_mipi_emu_desc.c). The tests set lanes,
+// format, frame, IO mode, trigger mode and exposure through the core and check the state and the
+// register values written to the backend.
+//
+//   ./tools/testing/kunit/kunit.py run --arch=x86_64 --kunitconfig=drivers/media/i2c/vc_mipi
+
+#include "vc_mipi_core.h"
+#include "vc_mipi_emu.h"
+#include "vc_mipi_modules.h"
+
+#include <kunit/test.h>
+#include <linux/i2c.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#define MOD_ADDR                0x10
+#define SEN_ADDR                0x1a
+#define MOD_REG_BASE            0x0100
+#define MOD_REG_STATUS          0x0101
+#define MOD_REG_EXPO_L          0x0109
+#define MOD_REG_NUM             17      // 0x0100 - 0x0110
+#define MOD_DESC_BASE           0x1000
+
+#define REG_STATUS_READY        0x80
+
+static const __u16 vc_test_mod_ids[] = {
+        MOD_ID_IMX178, MOD_ID_IMX183, MOD_ID_IMX226, MOD_ID_IMX250, MOD_ID_IMX252, MOD_ID_IMX264,
+        MOD_ID_IMX265, MOD_ID_IMX273, MOD_ID_IMX290, MOD_ID_IMX296, MOD_ID_IMX297, MOD_ID_IMX327,
+        MOD_ID_IMX335, MOD_ID_IMX392, MOD_ID_IMX412, MOD_ID_IMX415, MOD_ID_IMX462, MOD_ID_IMX565,
+        MOD_ID_IMX566, MOD_ID_IMX567, MOD_ID_IMX568, MOD_ID_OV7251, MOD_ID_OV9281,
+};
+
+static void vc_test_mod_id_desc(const __u16 *mod_id, char *desc)
+{
+        snprintf(desc, KUNIT_PARAM_DESC_SIZE, "0x%04x", *mod_id);
+}
+
+KUNIT_ARRAY_PARAM(vc_test_mod_id, vc_test_mod_ids, vc_test_mod_id_desc);
+
+struct vc_test {
+        struct i2c_adapter adapter;
+        struct i2c_client *client_sen;
+        struct vc_desc desc;
+        __u8 mod_regs[MOD_REG_NUM];
+        __u8 sen_regs[0x10000];
+        int sen_fail;                   // Fail all transfers to the sensor
+        struct vc_cam cam;
+};
+
+// ------------------------------------------------------------------------------------------------
+//  Stub register backend
+
+static __u8 vc_test_read(struct vc_test *t, __u16 client, __u16 addr)
+{
+        if (client == SEN_ADDR)
+                return t->sen_regs[addr];
+
+        if (addr == MOD_REG_STATUS)
+                return REG_STATUS_READY;
+        if (addr >= MOD_REG_BASE && addr < MOD_REG_BASE + MOD_REG_NUM)
+                return t->mod_regs[addr - MOD_REG_BASE];
+        if (addr >= MOD_DESC_BASE && addr < MOD_DESC_BASE + sizeof(t->desc))
+                return ((__u8 *)&t->desc)[addr - MOD_DESC_BASE];
+
+        return 0;
+}
+
+static void vc_test_write(struct vc_test *t, __u16 client, __u16 addr, __u8 value)
+{
+        if (client == SEN_ADDR)
+                t->sen_regs[addr] = value;
+        else if (addr >= MOD_REG_BASE && addr < MOD_REG_BASE + MOD_REG_NUM && addr != MOD_REG_STATUS)
+                t->mod_regs[addr - MOD_REG_BASE] = value;
+}
+
+static int vc_test_xfer(struct i2c_adapter *adapter, struct i2c_msg *msgs, int num)
+{
+        struct vc_test *t = i2c_get_adapdata(adapter);
+        __u16 addr = 0;
+        int index, byte;
+
+        for (index = 0; index < num; index++) {
+                struct i2c_msg *msg = &msgs[index];
+
+                if (msg->addr != MOD_ADDR && msg->addr != SEN_ADDR)
+                        return -ENXIO;
+                if (msg->addr == SEN_ADDR && t->sen_fail)
+                        return -EREMOTEIO;
+
+                if (msg->flags & I2C_M_RD) {
+                        for (byte = 0; byte < msg->len; byte++)
+                                msg->buf[byte] = vc_test_read(t, msg->addr, addr++);
+                } else if (msg->len >= 2) {
+                        addr = (msg->buf[0] << 8) | msg->buf[1];
+                        for (byte = 2; byte < msg->len; byte++)
+                                vc_test_write(t, msg->addr, addr++, msg->buf[byte]);
+                }
+        }
+
+        return num;
+}
+
+static u32 vc_test_functionality(struct i2c_adapter *adapter)
+{
+        return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm vc_test_algo = {
+        .master_xfer = vc_test_xfer,
+        .functionality = vc_test_functionality,
+};
+
+// Reads a register of the sensor as written by i2c_write_reg4(). Returns the mask of the bytes
+// the sensor has registers for in *mask.
+static __u32 vc_test_read_csr4(struct vc_test *t, struct vc_csr4 *csr, __u32 *mask)
+{
+        __u32 addrs[4] = { csr->l, csr->m, csr->h, csr->u };
+        __u32 value = 0;
+        int index;
+
+        *mask = 0;
+        for (index = 0; index < 4; index++) {
+                if (addrs[index]) {
+                        value |= (__u32)t->sen_regs[addrs[index]] << (8 * index);
+                        *mask |= 0xff << (8 * index);
+                }
+        }
+
+        return value;
+}
+
+static __u32 vc_test_read_mod4(struct vc_test *t, __u16 addr)
+{
+        __u8 *regs = &t->mod_regs[addr - MOD_REG_BASE];
+
+        return regs[0] | (regs[1] << 8) | (regs[2] << 16) | ((__u32)regs[3] << 24);
+}
+
+static int vc_test_init(struct kunit *test)
+{
+        const __u16 *mod_id = test->param_value;
+        struct vc_test *t;
+        int ret;
+
+        t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+        KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t);
+        KUNIT_ASSERT_EQ(test, vc_emu_init_desc(&t->desc, *mod_id, 0), 0);
+
+        t->adapter.owner = THIS_MODULE;
+        t->adapter.algo = &vc_test_algo;
+        strscpy(t->adapter.name, "vc_mipi_test", sizeof(t->adapter.name));
+        i2c_set_adapdata(&t->adapter, t);
+        ret = i2c_add_adapter(&t->adapter);
+        KUNIT_ASSERT_EQ(test, ret, 0);
+
+        t->client_sen = i2c_new_dummy_device(&t->adapter, SEN_ADDR);
+        if (IS_ERR(t->client_sen)) {
+                i2c_del_adapter(&t->adapter);
+                KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->client_sen);
+        }
+
+        ret = vc_core_init(&t->cam, t->client_sen);
+        test->priv = t;
+        KUNIT_ASSERT_EQ(test, ret, 0);
+        KUNIT_ASSERT_EQ(test, t->cam.ctrl.mod, vc_mod_find(*mod_id, 1));
+
+        return 0;
+}
+
+static void vc_test_exit(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+
+        if (t == NULL)
+                return;
+
+        vc_core_free_capture(&t->cam);
+        vc_core_free(&t->cam);
+        i2c_unregister_device(t->client_sen);
+        i2c_del_adapter(&t->adapter);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Tests
+
+static __u32 vc_test_get_code(struct vc_cam *cam, struct vc_desc_mode *mode)
+{
+        return vc_core_format_to_v4l2_code(mode->format, vc_mod_is_color_sensor(&cam->desc),
+                cam->ctrl.flags & FLAG_FORMAT_GBRG);
+}
+
+static void vc_test_probe(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+
+        KUNIT_EXPECT_EQ(test, vc_core_try_format(cam, state->format_code), 0);
+        KUNIT_EXPECT_GT(test, ctrl->frame.width, 0U);
+        KUNIT_EXPECT_GT(test, ctrl->frame.height, 0U);
+        KUNIT_EXPECT_LE(test, state->frame.left + state->frame.width, ctrl->frame.width);
+        KUNIT_EXPECT_LE(test, state->frame.top + state->frame.height, ctrl->frame.height);
+        KUNIT_EXPECT_GE(test, state->exposure, ctrl->exposure.min);
+        KUNIT_EXPECT_LE(test, state->exposure, ctrl->exposure.max);
+        KUNIT_EXPECT_GT(test, ctrl->pixel_rate, 0ULL);
+        KUNIT_EXPECT_EQ(test, state->stream_state, VC_STREAM_OFF);
+}
+
+static void vc_test_set_format(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        struct vc_desc *desc = &cam->desc;
+        struct vc_state *state = &cam->state;
+        int index;
+
+        for (index = 0; index < desc->num_modes; index++) {
+                struct vc_desc_mode *mode = &desc->modes[index];
+                __u32 code = vc_test_get_code(cam, mode);
+
+                KUNIT_EXPECT_EQ(test, vc_core_set_num_lanes(cam, mode->num_lanes), 0);
+                KUNIT_EXPECT_EQ(test, state->num_lanes, mode->num_lanes);
+                KUNIT_EXPECT_EQ(test, vc_core_set_format(cam, code), 0);
+                KUNIT_EXPECT_EQ(test, state->format_code, code);
+                KUNIT_EXPECT_GT(test, cam->ctrl.link_freq, 0ULL);
+                KUNIT_EXPECT_GT(test, cam->ctrl.framerate.max, 0U);
+        }
+
+        // Unsupported settings are rejected, an unsupported format falls back to the default.
+        KUNIT_EXPECT_EQ(test, vc_core_set_num_lanes(cam, 3), -EINVAL);
+        KUNIT_EXPECT_EQ(test, vc_core_set_format(cam, MEDIA_BUS_FMT_JPEG_1X8), -EINVAL);
+        KUNIT_EXPECT_EQ(test, vc_core_try_format(cam, state->format_code), 0);
+}
+
+static void vc_test_set_frame(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        struct vc_frame *max = &cam->ctrl.frame;
+        struct vc_frame *frame;
+
+        KUNIT_EXPECT_EQ(test, vc_core_set_frame(cam, 0, 0, max->width, max->height), 0);
+        frame = vc_core_get_frame(cam);
+        KUNIT_EXPECT_EQ(test, frame->width, max->width);
+        KUNIT_EXPECT_EQ(test, frame->height, max->height);
+
+        KUNIT_EXPECT_EQ(test, vc_core_set_frame(cam, 8, 4, max->width / 2, max->height / 2), 0);
+        frame = vc_core_get_frame(cam);
+        KUNIT_EXPECT_EQ(test, frame->left, 8U);
+        KUNIT_EXPECT_EQ(test, frame->top, 4U);
+        KUNIT_EXPECT_EQ(test, frame->width, max->width / 2);
+        KUNIT_EXPECT_EQ(test, frame->height, max->height / 2);
+
+        // Frames beyond the sensor are clamped.
+        KUNIT_EXPECT_EQ(test, vc_core_set_frame(cam, max->width, max->height, max->width + 16, max->height + 16), 0);
+        frame = vc_core_get_frame(cam);
+        KUNIT_EXPECT_EQ(test, frame->width, max->width);
+        KUNIT_EXPECT_EQ(test, frame->height, max->height);
+        KUNIT_EXPECT_EQ(test, frame->left, 0U);
+        KUNIT_EXPECT_EQ(test, frame->top, 0U);
+}
+
+static void vc_test_set_io_mode(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        int io_enabled = cam->ctrl.flags & FLAG_IO_ENABLED;
+        int mode;
+
+        for (mode = 0; mode <= 6; mode++) {
+                int supported = mode == 0 || (io_enabled && mode <= 5);
+
+                KUNIT_EXPECT_EQ_MSG(test, vc_mod_set_io_mode(cam, mode), supported ? 0 : -EINVAL,
+                        "io mode %d", mode);
+                if (supported)
+                        KUNIT_EXPECT_EQ(test, cam->state.io_mode != 0, mode != 0);
+        }
+}
+
+// Sets exposure times from the minimum in steps of factor 4 up to the maximum for all lanes,
+// formats and trigger modes and checks the timing and the registers written for it.
+static void vc_test_set_exposure(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        struct vc_desc *desc = &cam->desc;
+        struct vc_ctrl *ctrl = &cam->ctrl;
+        struct vc_state *state = &cam->state;
+        int trigger_timing = ctrl->flags & (FLAG_EXPOSURE_SONY | FLAG_EXPOSURE_NORMAL);
+        const char *violation;
+        __u32 exposure, value, mask;
+        int index, trigger;
+
+        for (index = 0; index < desc->num_modes; index++) {
+                struct vc_desc_mode *mode = &desc->modes[index];
+
+                if (mode->type != MODE_TYPE_STREAM)
+                        continue;
+                KUNIT_ASSERT_EQ(test, vc_core_set_num_lanes(cam, mode->num_lanes), 0);
+                KUNIT_ASSERT_EQ(test, vc_core_set_format(cam, vc_test_get_code(cam, mode)), 0);
+
+                for (trigger = 0; trigger <= 7; trigger++) {
+                        if (!vc_mod_is_trigger_mode_supported(cam, trigger))
+                                continue;
+                        KUNIT_ASSERT_EQ(test, vc_mod_set_trigger_mode(cam, trigger), 0);
+
+                        exposure = ctrl->exposure.min;
+                        while (1) {
+                                KUNIT_EXPECT_EQ(test, vc_sen_set_exposure(cam, exposure), 0);
+                                KUNIT_EXPECT_EQ(test, state->exposure, exposure);
+
+                                violation = vc_core_check_state(cam);
+                                if (violation)
+                                        KUNIT_FAIL(test, "lanes %u, code 0x%04x, trigger %d, exposure %u us: %s",
+                                                state->num_lanes, state->format_code, trigger, exposure, violation);
+
+                                if (trigger_timing && (trigger == 1 || trigger == 3 || trigger == 4)) {
+                                        // External, self and single trigger: exposure count of the module
+                                        KUNIT_EXPECT_EQ(test, vc_test_read_mod4(t, MOD_REG_EXPO_L), state->exposure_cnt);
+                                } else if (!trigger_timing || trigger != 2) {
+                                        // Free running, sync and stream trigger: sensor timing
+                                        value = vc_test_read_csr4(t, &ctrl->csr.sen.vmax, &mask);
+                                        KUNIT_EXPECT_EQ(test, value, state->vmax & mask);
+                                        value = vc_test_read_csr4(t, &ctrl->csr.sen.shs, &mask);
+                                        KUNIT_EXPECT_EQ(test, value, state->shs & mask);
+                                }
+
+                                if (exposure >= ctrl->exposure.max)
+                                        break;
+                                exposure = min_t(__u64, (__u64)max(exposure, 1U) * 4, ctrl->exposure.max);
+                        }
+                }
+        }
+}
+
+static void vc_check_report_kunit(void *priv, struct vc_cam *cam, const char *violation)
+{
+        struct kunit *test = priv;
+        struct vc_state *state = &cam->state;
+
+        KUNIT_FAIL(test, "lanes %u, code 0x%04x, trigger %d, framerate %u mHz, exposure %u us: %s",
+                state->num_lanes, state->format_code, vc_mod_get_trigger_mode(cam), state->framerate,
+                state->exposure, violation);
+}
+
+static void vc_test_check_timing(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+
+        KUNIT_EXPECT_GT(test, vc_core_check_timing(&t->cam, vc_check_report_kunit, test), 0U);
+}
+
+static void vc_test_stream(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        struct vc_sen_csr *csr = &cam->ctrl.csr.sen;
+        struct vc_state *state = &cam->state;
+        struct vc_stream_event event = { 0 };
+        int reset;
+
+        KUNIT_ASSERT_EQ(test, vc_core_prepare_stream(cam, &event, &reset), 0);
+        KUNIT_EXPECT_EQ(test, reset, 1);
+        KUNIT_EXPECT_EQ(test, state->stream_state, VC_STREAM_STANDBY);
+
+        KUNIT_ASSERT_EQ(test, vc_sen_start_stream(cam), 0);
+        KUNIT_EXPECT_EQ(test, state->stream_state, VC_STREAM_STREAMING);
+        KUNIT_EXPECT_TRUE(test, state->streaming);
+        KUNIT_EXPECT_TRUE(test, vc_core_is_stream_current(cam));
+        if (csr->mode.l)
+                KUNIT_EXPECT_EQ(test, t->sen_regs[csr->mode.l], csr->mode_operating);
+
+        // A repeated start with the same settings keeps streaming without a reset.
+        KUNIT_ASSERT_EQ(test, vc_core_prepare_stream(cam, &event, &reset), 0);
+        KUNIT_EXPECT_EQ(test, reset, 0);
+
+        KUNIT_ASSERT_EQ(test, vc_sen_stop_stream(cam), 0);
+        KUNIT_EXPECT_FALSE(test, state->streaming);
+        if (csr->mode.l)
+                KUNIT_EXPECT_EQ(test, t->sen_regs[csr->mode.l], csr->mode_standby);
+}
+
+static void vc_test_stream_error(struct kunit *test)
+{
+        struct vc_test *t = test->priv;
+        struct vc_cam *cam = &t->cam;
+        struct vc_sen_csr *csr = &cam->ctrl.csr.sen;
+        struct vc_state *state = &cam->state;
+        struct vc_stream_event event = { 0 };
+        int reset;
+
+        if (csr->mode.l == 0)
+                kunit_skip(test, "no sensor mode register");
+
+        KUNIT_ASSERT_EQ(test, vc_core_prepare_stream(cam, &event, &reset), 0);
+
+        // A failed start leaves the camera off, the next start programs it again.
+        t->sen_fail = 1;
+        KUNIT_EXPECT_NE(test, vc_sen_start_stream(cam), 0);
+        KUNIT_EXPECT_EQ(test, state->stream_state, VC_STREAM_OFF);
+        KUNIT_EXPECT_FALSE(test, state->streaming);
+        KUNIT_EXPECT_TRUE(test, state->stream_changed);
+        KUNIT_EXPECT_FALSE(test, vc_core_is_stream_current(cam));
+
+        t->sen_fail = 0;
+        KUNIT_ASSERT_EQ(test, vc_core_prepare_stream(cam, &event, &reset), 0);
+        KUNIT_ASSERT_EQ(test, vc_sen_start_stream(cam), 0);
+        KUNIT_EXPECT_TRUE(test, state->streaming);
+        KUNIT_EXPECT_EQ(test, t->sen_regs[csr->mode.l], csr->mode_operating);
+
+        // A failed stop of the running stream fails the preparation of the next start.
+        KUNIT_ASSERT_EQ(test, vc_core_set_frame(cam, 0, 0, cam->ctrl.frame.width / 2, cam->ctrl.frame.height / 2), 0);
+        t->sen_fail = 1;
+        KUNIT_EXPECT_NE(test, vc_core_prepare_stream(cam, &event, &reset), 0);
+        KUNIT_EXPECT_EQ(test, state->stream_state, VC_STREAM_OFF);
+        t->sen_fail = 0;
+}
+
+static struct kunit_case vc_test_cases[] = {
+        KUNIT_CASE_PARAM(vc_test_probe, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_set_format, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_set_frame, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_set_io_mode, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_set_exposure, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_check_timing, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_stream, vc_test_mod_id_gen_params),
+        KUNIT_CASE_PARAM(vc_test_stream_error, vc_test_mod_id_gen_params),
+        {}
+};
+
+static struct kunit_suite vc_test_suite = {
+        .name = "vc_mipi",
+        .init = vc_test_init,
+        .exit = vc_test_exit,
+        .test_cases = vc_test_cases,
+};
+
+kunit_test_suite(vc_test_suite);
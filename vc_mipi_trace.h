@@ -0,0 +1,106 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vc_mipi
+
+#if !defined(_VC_MIPI_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _VC_MIPI_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(vc_reg,
+        TP_PROTO(__u8 client, __u16 addr, __u8 value, int ret, __u64 duration_ns),
+        TP_ARGS(client, addr, value, ret, duration_ns),
+        TP_STRUCT__entry(
+                __field(__u8, client)
+                __field(__u16, addr)
+                __field(__u8, value)
+                __field(int, ret)
+                __field(__u64, duration_ns)
+        ),
+        TP_fast_assign(
+                __entry->client = client;
+                __entry->addr = addr;
+                __entry->value = value;
+                __entry->ret = ret;
+                __entry->duration_ns = duration_ns;
+        ),
+        TP_printk("client=0x%02x addr=0x%04x value=0x%02x ret=%d duration=%llu ns",
+                __entry->client, __entry->addr, __entry->value, __entry->ret, __entry->duration_ns)
+);
+
+DEFINE_EVENT(vc_reg, vc_reg_read,
+        TP_PROTO(__u8 client, __u16 addr, __u8 value, int ret, __u64 duration_ns),
+        TP_ARGS(client, addr, value, ret, duration_ns)
+);
+
+DEFINE_EVENT(vc_reg, vc_reg_write,
+        TP_PROTO(__u8 client, __u16 addr, __u8 value, int ret, __u64 duration_ns),
+        TP_ARGS(client, addr, value, ret, duration_ns)
+);
+
+TRACE_EVENT(vc_mode_reset,
+        TP_PROTO(__u8 client, __u8 mode, int ret, __u64 duration_ns),
+        TP_ARGS(client, mode, ret, duration_ns),
+        TP_STRUCT__entry(
+                __field(__u8, client)
+                __field(__u8, mode)
+                __field(int, ret)
+                __field(__u64, duration_ns)
+        ),
+        TP_fast_assign(
+                __entry->client = client;
+                __entry->mode = mode;
+                __entry->ret = ret;
+                __entry->duration_ns = duration_ns;
+        ),
+        TP_printk("client=0x%02x mode=%u ret=%d duration=%llu ns",
+                __entry->client, __entry->mode, __entry->ret, __entry->duration_ns)
+);
+
+TRACE_EVENT(vc_stream,
+        TP_PROTO(__u8 client, int enable, int ret, __u64 duration_ns),
+        TP_ARGS(client, enable, ret, duration_ns),
+        TP_STRUCT__entry(
+                __field(__u8, client)
+                __field(int, enable)
+                __field(int, ret)
+                __field(__u64, duration_ns)
+        ),
+        TP_fast_assign(
+                __entry->client = client;
+                __entry->enable = enable;
+                __entry->ret = ret;
+                __entry->duration_ns = duration_ns;
+        ),
+        TP_printk("client=0x%02x %s ret=%d duration=%llu ns",
+                __entry->client, __entry->enable == 2 ? "prepare" : __entry->enable ? "on" : "off",
+                __entry->ret, __entry->duration_ns)
+);
+
+TRACE_EVENT(vc_ctrl,
+        TP_PROTO(__u8 client, __u32 id, __s32 value, int ret, __u64 duration_ns),
+        TP_ARGS(client, id, value, ret, duration_ns),
+        TP_STRUCT__entry(
+                __field(__u8, client)
+                __field(__u32, id)
+                __field(__s32, value)
+                __field(int, ret)
+                __field(__u64, duration_ns)
+        ),
+        TP_fast_assign(
+                __entry->client = client;
+                __entry->id = id;
+                __entry->value = value;
+                __entry->ret = ret;
+                __entry->duration_ns = duration_ns;
+        ),
+        TP_printk("client=0x%02x id=0x%08x value=%d ret=%d duration=%llu ns",
+                __entry->client, __entry->id, __entry->value, __entry->ret, __entry->duration_ns)
+);
+
+#endif // _VC_MIPI_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE vc_mipi_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,265 @@
+#include "vc_mipi_trigger.h"
+
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+// Software trigger generator for the single trigger mode. An hrtimer fires at the trigger period
+// and queues the trigger write to a SCHED_FIFO kthread worker (I2C transfers may sleep). The period
+// is never shorter than vc_core_calculate_min_trigger_period(), also when the exposure grows while
+// the generator runs. If a trigger is still pending when the timer fires again, the period is
+// skipped instead of queueing triggers back to back.
+//
+// The trigger write takes the camera lock like every other operation on the camera. The generator is
+// stopped with the lock held (trigger period control), so the stop doesn't wait for the worker: it
+// withdraws the pending trigger, and a worker that gets the lock afterwards finds nothing to write.
+
+static enum hrtimer_restart vc_trigger_timer(struct hrtimer *timer)
+{
+        struct vc_trigger *trigger = container_of(timer, struct vc_trigger, timer);
+        enum hrtimer_restart restart = HRTIMER_RESTART;
+        unsigned long flags;
+        u64 overruns;
+
+        spin_lock_irqsave(&trigger->lock, flags);
+        if (!trigger->pending) {
+                // The work may still be queued from before a stop, it takes this trigger then.
+                kthread_queue_work(trigger->worker, &trigger->work);
+                trigger->pending = 1;
+                trigger->scheduled = hrtimer_get_expires(timer);
+                if (trigger->count && --trigger->remaining == 0) {
+                        restart = HRTIMER_NORESTART;
+                }
+        } else {
+                trigger->stats.skipped++;
+        }
+
+        if (restart == HRTIMER_RESTART) {
+                // Periods missed by a late timer are skipped as well.
+                overruns = hrtimer_forward_now(timer, ns_to_ktime((u64)trigger->period_us * NSEC_PER_USEC));
+                if (overruns > 1) {
+                        trigger->stats.skipped += overruns - 1;
+                }
+        }
+        spin_unlock_irqrestore(&trigger->lock, flags);
+
+        return restart;
+}
+
+static int vc_trigger_is_running(struct vc_trigger *trigger)
+{
+        int running;
+
+        spin_lock_irq(&trigger->lock);
+        running = trigger->running;
+        spin_unlock_irq(&trigger->lock);
+
+        return running;
+}
+
+static void vc_trigger_work(struct kthread_work *work)
+{
+        struct vc_trigger *trigger = container_of(work, struct vc_trigger, work);
+        struct vc_trigger_stats *stats = &trigger->stats;
+        ktime_t scheduled, end;
+        __u64 latency, interval;
+        int ret;
+
+        mutex_lock(trigger->cam->lock);
+        spin_lock_irq(&trigger->lock);
+        if (!trigger->running || !trigger->pending) {
+                // Withdrawn by a stop while waiting for the lock
+                spin_unlock_irq(&trigger->lock);
+                mutex_unlock(trigger->cam->lock);
+                return;
+        }
+        trigger->pending = 0;
+        scheduled = trigger->scheduled;
+        spin_unlock_irq(&trigger->lock);
+
+        ret = vc_mod_set_single_trigger(trigger->cam);
+        end = ktime_get();
+        mutex_unlock(trigger->cam->lock);
+
+        spin_lock_irq(&trigger->lock);
+        if (ret) {
+                stats->errors++;
+        } else {
+                latency = ktime_to_ns(ktime_sub(end, scheduled));
+                stats->triggers++;
+                stats->latency_min_ns = min(stats->latency_min_ns, latency);
+                stats->latency_max_ns = max(stats->latency_max_ns, latency);
+                stats->latency_sum_ns += latency;
+                if (trigger->last) {
+                        interval = ktime_to_ns(ktime_sub(end, trigger->last));
+                        stats->interval_min_ns = min(stats->interval_min_ns, interval);
+                        stats->interval_max_ns = max(stats->interval_max_ns, interval);
+                }
+                trigger->last = end;
+        }
+        if (trigger->count && trigger->remaining == 0) {
+                trigger->running = 0;
+        }
+        spin_unlock_irq(&trigger->lock);
+}
+
+// Writes count triggers (0: continuous) every period_us, starting immediately. A running burst is
+// stopped first.
+int vc_trigger_start(struct vc_cam *cam, __u32 period_us, __u32 count)
+{
+        struct vc_trigger *trigger = cam->trigger;
+        struct device *dev = vc_core_get_mod_device(cam);
+        __u32 period_min;
+
+        if (trigger == NULL) {
+                return -EINVAL;
+        }
+
+        if (!cam->state.streaming || !vc_mod_is_single_trigger(cam)) {
+                vc_err(dev, "%s(): Trigger generator requires streaming in trigger mode SINGLE!\n", __FUNCTION__);
+                return -EINVAL;
+        }
+
+        vc_trigger_stop(cam);
+
+        period_min = vc_core_calculate_min_trigger_period(cam);
+        if (period_us < period_min) {
+                vc_warn(dev, "%s(): Trigger period %u us raised to the minimum of %u us\n", __FUNCTION__,
+                        period_us, period_min);
+                period_us = period_min;
+        }
+
+        spin_lock_irq(&trigger->lock);
+        memset(&trigger->stats, 0, sizeof(trigger->stats));
+        trigger->stats.latency_min_ns = U64_MAX;
+        trigger->stats.interval_min_ns = U64_MAX;
+        trigger->period_us = period_us;
+        trigger->count = count;
+        trigger->remaining = count;
+        trigger->last = 0;
+        trigger->running = 1;
+        spin_unlock_irq(&trigger->lock);
+
+        vc_notice(dev, "%s(): Start trigger generator (period: %u us, count: %u)\n", __FUNCTION__,
+                period_us, count);
+        hrtimer_start(&trigger->timer, 0, HRTIMER_MODE_REL);
+
+        return 0;
+}
+
+// Raises the period of a running generator to the minimum trigger period of the current exposure.
+// The next trigger is due one new period after the last one. Has to be called with the camera lock
+// held.
+void vc_trigger_update(struct vc_cam *cam)
+{
+        struct vc_trigger *trigger = cam->trigger;
+        struct device *dev = vc_core_get_mod_device(cam);
+        __u32 period_min, period_us;
+        ktime_t next;
+        int raise;
+
+        if (trigger == NULL || !vc_trigger_is_running(trigger)) {
+                return;
+        }
+
+        period_min = vc_core_calculate_min_trigger_period(cam);
+
+        // The timer isn't running while its expiry is moved.
+        hrtimer_cancel(&trigger->timer);
+
+        spin_lock_irq(&trigger->lock);
+        period_us = trigger->period_us;
+        raise = trigger->running && period_us < period_min;
+        if (raise) {
+                trigger->period_us = period_min;
+        }
+        next = ktime_add_us(trigger->scheduled, trigger->period_us);
+        // A burst whose last trigger is queued already needs no further timer.
+        if (trigger->running && (trigger->count == 0 || trigger->remaining)) {
+                hrtimer_start(&trigger->timer, next, HRTIMER_MODE_ABS);
+        }
+        spin_unlock_irq(&trigger->lock);
+
+        if (raise) {
+                vc_notice(dev, "%s(): Trigger period %u us raised to the minimum of %u us\n", __FUNCTION__,
+                        period_us, period_min);
+        }
+}
+
+void vc_trigger_stop(struct vc_cam *cam)
+{
+        struct vc_trigger *trigger = cam->trigger;
+
+        if (trigger == NULL) {
+                return;
+        }
+
+        // Not flushed, the caller may hold the camera lock the worker waits for. A trigger write in
+        // progress completes, a pending one is dropped.
+        spin_lock_irq(&trigger->lock);
+        trigger->running = 0;
+        trigger->pending = 0;
+        spin_unlock_irq(&trigger->lock);
+
+        hrtimer_cancel(&trigger->timer);
+}
+
+void vc_trigger_get_stats(struct vc_cam *cam, struct vc_trigger_stats *stats, int *running, __u32 *period_us,
+        __u32 *count)
+{
+        struct vc_trigger *trigger = cam->trigger;
+
+        spin_lock_irq(&trigger->lock);
+        *stats = trigger->stats;
+        *running = trigger->running;
+        *period_us = trigger->period_us;
+        *count = trigger->count;
+        spin_unlock_irq(&trigger->lock);
+}
+
+int vc_trigger_init(struct vc_cam *cam)
+{
+        struct device *dev = vc_core_get_mod_device(cam);
+        struct vc_trigger *trigger;
+        int ret;
+
+        trigger = kzalloc(sizeof(*trigger), GFP_KERNEL);
+        if (trigger == NULL) {
+                return -ENOMEM;
+        }
+
+        trigger->worker = kthread_create_worker(0, "vc_trigger/%s", dev_name(dev));
+        if (IS_ERR(trigger->worker)) {
+                ret = PTR_ERR(trigger->worker);
+                vc_err(dev, "%s(): Unable to create the trigger worker (error: %d)\n", __FUNCTION__, ret);
+                kfree(trigger);
+                return ret;
+        }
+        // Keeps the latency of the trigger writes low under load.
+        sched_set_fifo(trigger->worker->task);
+
+        trigger->cam = cam;
+        spin_lock_init(&trigger->lock);
+        kthread_init_work(&trigger->work, vc_trigger_work);
+        hrtimer_init(&trigger->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        trigger->timer.function = vc_trigger_timer;
+        cam->trigger = trigger;
+
+        return 0;
+}
+
+void vc_trigger_free(struct vc_cam *cam)
+{
+        struct vc_trigger *trigger = cam->trigger;
+
+        if (trigger == NULL) {
+                return;
+        }
+
+        // Called without the camera lock, the worker finishes the last trigger.
+        vc_trigger_stop(cam);
+        kthread_destroy_worker(trigger->worker);
+        cam->trigger = NULL;
+        kfree(trigger);
+}
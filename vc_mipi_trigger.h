@@ -0,0 +1,47 @@
+#ifndef _VC_MIPI_TRIGGER_H
+#define _VC_MIPI_TRIGGER_H
+
+#include "vc_mipi_core.h"
+
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+
+struct vc_trigger_stats {
+        __u32 triggers;                 // Triggers written
+        __u32 skipped;                  // Periods without trigger, the previous one was still pending
+        __u32 errors;
+        // Latency from the scheduled time to the end of the trigger write
+        __u64 latency_min_ns;
+        __u64 latency_max_ns;
+        __u64 latency_sum_ns;
+        // Interval between two trigger writes
+        __u64 interval_min_ns;
+        __u64 interval_max_ns;
+};
+
+struct vc_trigger {
+        struct vc_cam *cam;
+        struct hrtimer timer;
+        struct kthread_worker *worker;
+        struct kthread_work work;
+        spinlock_t lock;                // Protects the fields below, shared with the timer
+        int running;
+        int pending;                    // A trigger is queued and not yet taken by the worker
+        __u32 period_us;                // Applied period (at least the minimum trigger period)
+        __u32 count;                    // Requested triggers, 0: continuous
+        __u32 remaining;                // Triggers still to be queued
+        ktime_t scheduled;              // Scheduled time of the pending trigger
+        ktime_t last;                   // End of the previous trigger write
+        struct vc_trigger_stats stats;
+};
+
+int vc_trigger_init(struct vc_cam *cam);
+void vc_trigger_free(struct vc_cam *cam);
+int vc_trigger_start(struct vc_cam *cam, __u32 period_us, __u32 count);
+void vc_trigger_stop(struct vc_cam *cam);
+void vc_trigger_update(struct vc_cam *cam);
+void vc_trigger_get_stats(struct vc_cam *cam, struct vc_trigger_stats *stats, int *running, __u32 *period_us,
+        __u32 *count);
+
+#endif // _VC_MIPI_TRIGGER_H